@@ -19,7 +19,7 @@ ArtworkController::~ArtworkController() = default;
 
 ResponsePtr ArtworkController::getCurrentArtwork()
 {
-    auto responseFuture = player_->fetchCurrentArtwork().then(
+    auto responseFuture = player_->fetchCurrentArtwork(request()->cancellation).then(
         boost::launch::sync, [this](boost::unique_future<ArtworkResult> resultFuture) {
             auto result = resultFuture.get();
             return getResponse(&result);
@@ -35,7 +35,7 @@ ResponsePtr ArtworkController::getArtwork()
     query.playlist = param<PlaylistRef>("plref");
     query.index = param<int32_t>("index");
 
-    auto responseFuture = player_->fetchArtwork(query).then(
+    auto responseFuture = player_->fetchArtwork(query, request()->cancellation).then(
         boost::launch::sync, [this](boost::unique_future<ArtworkResult> resultFuture) {
             auto result = resultFuture.get();
             return getResponse(&result);
@@ -92,6 +92,7 @@ void ArtworkController::defineRoutes(
     });
 
     routes.useWorkQueue(workQueue);
+    routes.setPriority(WorkPriority::BULK);
     routes.setPrefix("api/artwork");
     routes.get("current", &ArtworkController::getCurrentArtwork);
     routes.get(":plref/:index", &ArtworkController::getArtwork);
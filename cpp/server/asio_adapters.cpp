@@ -10,84 +10,50 @@ AsioWorkQueue::AsioWorkQueue(asio::io_context* context)
 
 AsioWorkQueue::~AsioWorkQueue() = default;
 
-void AsioWorkQueue::schedule(WorkCallback callback)
+void AsioWorkQueue::schedule(std::function<void()> callback)
 {
     asio::post(context_->get_executor(), std::move(callback));
 }
 
-AsioTimer::AsioTimer(asio::io_context* context)
-    : timer_(*context),
-      state_(TimerState::STOPPED)
-{
-}
-
-AsioTimer::~AsioTimer()
+AsioTimerFactory::AsioTimerFactory(asio::io_context* context)
+    : wheel_(&timeSource_),
+      timer_(*context),
+      executing_(false)
 {
-    stop();
+    wheel_.setArmCallback([this](TimePointMs time) { schedule(time); });
 }
 
-void AsioTimer::runOnce(DurationMs delay)
-{
-    schedule(delay);
-    state_ = TimerState::RUNNING;
-    period_ = DurationMs::zero();
-}
+AsioTimerFactory::~AsioTimerFactory() = default;
 
-void AsioTimer::runPeriodic(DurationMs period)
+TimerPtr AsioTimerFactory::createTimer()
 {
-    schedule(period);
-    state_ = TimerState::RUNNING;
-    period_ = period;
+    return wheel_.createTimer();
 }
 
-void AsioTimer::stop()
+void AsioTimerFactory::schedule(TimePointMs time)
 {
-    switch (state_)
-    {
-    case TimerState::STOPPED:
-        break;
-
-    case TimerState::WILL_RESTART:
-        state_ = TimerState::STOPPED;
-        break;
-
-    case TimerState::RUNNING:
-        state_ = TimerState::STOPPED;
-        timer_.cancel();
-        break;
-    }
-}
+    // Timers armed while executing are taken into account after execution
+    if (executing_ || (scheduledAt_ && *scheduledAt_ <= time))
+        return;
 
-void AsioTimer::schedule(DurationMs delay)
-{
-    timer_.expires_from_now(boost::posix_time::millisec(delay.count()));
+    scheduledAt_ = time;
+    timer_.expires_at(time);
     timer_.async_wait([this](const boost::system::error_code& error) { handleTimeout(error); });
 }
 
-void AsioTimer::handleTimeout(const boost::system::error_code& error)
+void AsioTimerFactory::handleTimeout(const boost::system::error_code& error)
 {
     if (error == asio::error::operation_aborted)
         return;
 
-    state_ = isPeriodic() ? TimerState::WILL_RESTART : TimerState::STOPPED;
-
-    if (callback_)
-        tryCatchLog([this] { callback_(this); });
-
-    if (state_ == TimerState::WILL_RESTART)
-        schedule(period_);
-}
-
-AsioTimerFactory::AsioTimerFactory(asio::io_context* context)
-    : context_(context)
-{
-}
+    scheduledAt_.reset();
 
-AsioTimerFactory::~AsioTimerFactory() = default;
+    executing_ = true;
+    wheel_.execute();
+    executing_ = false;
 
-TimerPtr AsioTimerFactory::createTimer()
-{
-    return std::make_unique<AsioTimer>(context_);
+    if (auto next = wheel_.nextTimeout())
+        schedule(*next);
 }
 
 }
@@ -13,47 +13,13 @@ public:
     virtual ~AsioWorkQueue();
 
 protected:
-    virtual void schedule(WorkCallback callback) override;
+    virtual void schedule(std::function<void()> callback) override;
 
 private:
     asio::io_context* context_;
 };
 
-class AsioTimer final : public Timer
-{
-public:
-    AsioTimer(asio::io_context* context);
-    virtual ~AsioTimer();
-
-    virtual TimerState state() const override
-    {
-        return state_;
-    }
-
-    virtual DurationMs period() const override
-    {
-        return period_;
-    }
-
-    virtual void setCallback(TimerCallback callback) override
-    {
-        callback_ = std::move(callback);
-    }
-
-    virtual void runOnce(DurationMs delay) override;
-    virtual void runPeriodic(DurationMs period) override;
-    virtual void stop() override;
-
-private:
-    void schedule(DurationMs delay);
-    void handleTimeout(const boost::system::error_code& error);
-
-    asio::deadline_timer timer_;
-    TimerState state_;
-    DurationMs period_;
-    TimerCallback callback_;
-};
-
+// Executes timers of a single timer wheel, asio timer is armed for the earliest wheel event
 class AsioTimerFactory final : public TimerFactory
 {
 public:
@@ -62,7 +28,14 @@ public:
     virtual TimerPtr createTimer() override;
 
 private:
-    asio::io_context* context_;
+    void schedule(TimePointMs time);
+    void handleTimeout(const boost::system::error_code& error);
+
+    SystemTimeSource timeSource_;
+    TimerWheel wheel_;
+    asio::steady_timer timer_;
+    boost::optional<TimePointMs> scheduledAt_;
+    bool executing_;
 };
 
 }
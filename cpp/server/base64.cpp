@@ -4,7 +4,7 @@
 
 namespace msrv {
 
-std::string base64Decode(const std::string& input)
+std::string base64Decode(StringView input)
 {
     std::string output;
 
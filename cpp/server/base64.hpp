@@ -1,10 +1,12 @@
 #pragma once
 
 #include "defines.hpp"
+#include "string_utils.hpp"
+
 #include <string>
 
 namespace msrv {
 
-std::string base64Decode(const std::string& input);
+std::string base64Decode(StringView input);
 
 }
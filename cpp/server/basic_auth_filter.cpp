@@ -38,7 +38,7 @@ void BasicAuthFilter::beginRequest(Request* request)
 
 bool BasicAuthFilter::verifyCredentials(Request* request)
 {
-    const auto& authValue = request->getHeader(HttpHeader::AUTHORIZATION);
+    const auto authValue = request->getHeader(HttpHeader::AUTHORIZATION);
     if (!boost::starts_with(authValue, BASIC_AUTH_PREFIX))
         return false;
 
@@ -4,4 +4,13 @@
 
 #include <boost/beast.hpp>
 
-namespace msrv { namespace beast = boost::beast; }
+namespace msrv {
+
+namespace beast = boost::beast;
+
+// Connections are served over generic stream sockets, these could be TCP or local (AF_UNIX) sockets
+using BeastSocket = asio::generic::stream_protocol::socket;
+using BeastEndpoint = asio::generic::stream_protocol::endpoint;
+using BeastAcceptor = asio::basic_socket_acceptor<asio::generic::stream_protocol>;
+
+}
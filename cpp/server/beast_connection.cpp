@@ -1,22 +1,60 @@
 #include "beast_connection.hpp"
+#include "beast_websocket.hpp"
 #include "log.hpp"
 
+#ifdef HAVE_SENDFILE
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif
+
 namespace msrv {
 
+BeastConnectionContext::~BeastConnectionContext()
+{
+    // Connections could outlive context in pending handlers of io_context,
+    // their deadline timers should be stopped before timer factory is destroyed
+    std::vector<std::shared_ptr<BeastConnection>> connections(
+        activeConnections.begin(), activeConnections.end());
+
+    for (auto& connection : connections)
+        connection->abort();
+}
+
 BeastConnection::BeastConnection(
     BeastConnectionContext* context,
-    asio::ip::tcp::socket socket)
+    BeastSocket socket)
     : context_(context),
       socket_(std::move(socket)),
+      arena_(nullptr),
+      requestId_(0),
       busy_(false)
 {
+    context_->connectionCount->fetch_add(1, std::memory_order_relaxed);
+}
+
+BeastConnection::~BeastConnection()
+{
+    context_->connectionCount->fetch_sub(1, std::memory_order_relaxed);
+
+    coreRequest_.reset();
+    parser_.reset();
+
+    if (arena_)
+        arena_->release();
 }
 
-BeastConnection::~BeastConnection() = default;
+size_t BeastConnection::shard() const
+{
+    return context_->shard;
+}
 
 void BeastConnection::run()
 {
     context_->activeConnections.emplace(shared_from_this());
+
+    deadlineTimer_ = context_->timerFactory.createTimer();
+    deadlineTimer_->setCallback([this](Timer*) { handleDeadline(); });
+
     readRequest();
 }
 
@@ -24,10 +62,33 @@ void BeastConnection::abort()
 {
     releaseCoreRequest();
     release();
+
+    boost::system::error_code error;
+    socket_.close(error);
+}
+
+bool BeastConnection::closeOldestIdle(BeastConnectionContext* context)
+{
+    std::shared_ptr<BeastConnection> oldest;
+
+    for (auto& connection : context->activeConnections)
+    {
+        if (connection->idleSince_ && (!oldest || *connection->idleSince_ < *oldest->idleSince_))
+            oldest = connection;
+    }
+
+    if (!oldest)
+        return false;
+
+    oldest->abort();
+    return true;
 }
 
 void BeastConnection::release()
 {
+    if (deadlineTimer_)
+        deadlineTimer_->stop();
+
     context_->activeConnections.erase(shared_from_this());
 }
 
@@ -35,31 +96,107 @@ void BeastConnection::closeSocket()
 {
     boost::system::error_code error;
 
-    socket_.shutdown(asio::ip::tcp::socket::shutdown_send, error);
+    socket_.shutdown(asio::socket_base::shutdown_send, error);
 
     if (error)
         logError("closeSocket: %s", error.message().c_str());
 }
 
+void BeastConnection::startDeadline(DurationMs timeout)
+{
+    if (timeout > DurationMs::zero())
+        deadlineTimer_->runOnce(timeout);
+    else
+        deadlineTimer_->stop();
+}
+
+void BeastConnection::handleDeadline()
+{
+    // Pending read operation is completed with operation_aborted error
+    boost::system::error_code error;
+    socket_.close(error);
+}
+
 void BeastConnection::readRequest()
 {
-    request_ = {};
+    // Parsed headers and objects of the next request are allocated from the same arena
+    if (arena_)
+        arena_->release();
+
+    arena_ = context_->arenaPool->acquire();
+    parser_.emplace(
+        std::piecewise_construct, std::make_tuple(), std::make_tuple(ArenaAllocator<char>(arena_)));
+
+    // Bytes of pipelined request are already received, there is nothing to wait for
+    if (buffer_.size() > 0)
+        readRequestHeader();
+    else
+        waitRequest();
+}
 
+void BeastConnection::waitRequest()
+{
     auto thisPtr = shared_from_this();
 
+    idleSince_ = steadyTime();
+    startDeadline(context_->limits.idleTimeout);
+
+    busy_ = true;
+    socket_.async_wait(
+        asio::socket_base::wait_read,
+        [thisPtr](const boost::system::error_code& error) {
+            thisPtr->busy_ = false;
+            thisPtr->idleSince_.reset();
+
+            if (error)
+                thisPtr->handleReadRequest(error);
+            else
+                thisPtr->readRequestHeader();
+        });
+}
+
+void BeastConnection::readRequestHeader()
+{
+    auto thisPtr = shared_from_this();
+
+    startDeadline(context_->limits.headerTimeout);
+
+    busy_ = true;
+    beast::http::async_read_header(
+        socket_,
+        buffer_,
+        *parser_,
+        bindArena(arena_, [thisPtr](const boost::system::error_code& error, size_t) {
+            thisPtr->busy_ = false;
+
+            if (error || thisPtr->parser_->is_done())
+                thisPtr->handleReadRequest(error);
+            else
+                thisPtr->readRequestBody();
+        }));
+}
+
+void BeastConnection::readRequestBody()
+{
+    auto thisPtr = shared_from_this();
+
+    startDeadline(context_->limits.bodyTimeout);
+
     busy_ = true;
     beast::http::async_read(
         socket_,
         buffer_,
-        request_,
-        [thisPtr](const boost::system::error_code& error, size_t) {
+        *parser_,
+        bindArena(arena_, [thisPtr](const boost::system::error_code& error, size_t) {
             thisPtr->busy_ = false;
             thisPtr->handleReadRequest(error);
-        });
+        }));
 }
 
 void BeastConnection::handleReadRequest(const boost::system::error_code& error)
 {
+    deadlineTimer_->stop();
+
     if (error == beast::http::error::end_of_stream)
     {
         closeSocket();
@@ -67,6 +204,13 @@ void BeastConnection::handleReadRequest(const boost::system::error_code& error)
         return;
     }
 
+    // Socket is closed by deadline or eviction, possibly after request has been read
+    if (error == asio::error::operation_aborted || !socket_.is_open())
+    {
+        release();
+        return;
+    }
+
     if (error)
     {
         logError("handleReadRequest: %s", error.message().c_str());
@@ -74,6 +218,15 @@ void BeastConnection::handleReadRequest(const boost::system::error_code& error)
         return;
     }
 
+    request_ = parser_->release();
+    parser_.reset();
+
+    if (BeastWebSocketSession::isWebSocketRequest(request_))
+    {
+        startWebSocketSession();
+        return;
+    }
+
     initCoreRequest();
 }
 
@@ -83,7 +236,9 @@ void BeastConnection::handleWriteResponse(const boost::system::error_code& error
 
     if (error)
     {
-        logError("handleWriteResponse: %s", error.message().c_str());
+        if (error != asio::error::operation_aborted)
+            logError("handleWriteResponse: %s", error.message().c_str());
+
         release();
         return;
     }
@@ -102,20 +257,24 @@ void BeastConnection::handleWriteResponseHeader(const boost::system::error_code&
 {
     if (error)
     {
-        logError("handleWriteResponseHeader: %s", error.message().c_str());
+        if (error != asio::error::operation_aborted)
+            logError("handleWriteResponseHeader: %s", error.message().c_str());
+
         releaseCoreRequest();
         release();
         return;
     }
 
-    coreRequest_->requestBodyData();
+    continueResponseBody();
 }
 
 void BeastConnection::handleWriteResponseBody(const boost::system::error_code& error, bool close)
 {
     if (error && error != beast::http::error::need_buffer)
     {
-        logError("handleWriteResponseBody: %s", error.message().c_str());
+        if (error != asio::error::operation_aborted)
+            logError("handleWriteResponseBody: %s", error.message().c_str());
+
         releaseCoreRequest();
         release();
         return;
@@ -129,21 +288,218 @@ void BeastConnection::handleWriteResponseBody(const boost::system::error_code& e
         return;
     }
 
-    coreRequest_->requestBodyData();
+    continueResponseBody();
 }
 
 void BeastConnection::initCoreRequest()
 {
-    coreRequest_ = std::make_unique<BeastRequest>(this, &request_);
+    coreRequest_ = arenaNew<BeastRequest>(arena_, this, &request_, arena_);
+    requestId_++;
 
     tryCatchLog([this] { context_->eventListener->onRequestReady(coreRequest_.get()); });
+
+    if (coreRequest_)
+        watchDisconnect();
+}
+
+void BeastConnection::watchDisconnect()
+{
+    // Socket is not read while request is processed,
+    // wait for readability to find out that client has closed connection
+    auto thisPtr = shared_from_this();
+    auto requestId = requestId_;
+
+    socket_.async_wait(
+        asio::socket_base::wait_read,
+        [thisPtr, requestId](const boost::system::error_code& error) {
+            thisPtr->handleDisconnectWait(error, requestId);
+        });
+}
+
+void BeastConnection::handleDisconnectWait(const boost::system::error_code& error, uint64_t requestId)
+{
+    // Request is completed, socket is read as usual
+    if (!coreRequest_ || requestId != requestId_ || error == asio::error::operation_aborted)
+        return;
+
+    if (!error)
+    {
+        // Client has sent the next request before receiving response.
+        // Its data is moved to the read buffer, so that the socket could be watched further.
+        if (buffer_.size() >= MAX_PIPELINED_SIZE)
+            return;
+
+        boost::system::error_code readError;
+        auto size = socket_.read_some(buffer_.prepare(PIPELINED_READ_SIZE), readError);
+        buffer_.commit(size);
+
+        if (!readError || readError == asio::error::would_block)
+        {
+            watchDisconnect();
+            return;
+        }
+
+        // Client has shut down its sending side, but still waits for response.
+        // If it has closed connection completely, writing response fails.
+        if (readError == asio::error::eof)
+            return;
+    }
+
+    abort();
+}
+
+void BeastConnection::startWebSocketSession()
+{
+    auto session = std::make_shared<BeastWebSocketSession>(
+        context_,
+        std::move(socket_),
+        std::make_shared<BeastRequestMessage>(std::move(request_)));
+
+    session->run();
+    release();
+}
+
+void BeastConnection::continueResponseBody()
+{
+    coreRequest_->requestBodyData();
+
+    if (coreRequest_->pendingBodySize() == 0)
+        tryCatchLog([this] { context_->eventListener->onRequestBodyDrained(coreRequest_.get()); });
 }
 
 void BeastConnection::releaseCoreRequest()
 {
+    if (!coreRequest_)
+        return;
+
     tryCatchLog([this] { context_->eventListener->onRequestDone(coreRequest_.get()); });
 
     coreRequest_.reset();
+    arena_->release();
+    arena_ = nullptr;
+}
+
+#ifdef HAVE_SENDFILE
+
+void BeastConnection::startFileTransfer()
+{
+    boost::system::error_code error;
+    socket_.native_non_blocking(true, error);
+
+    if (error)
+        copyFileData();
+    else
+        sendFileData();
+}
+
+void BeastConnection::sendFileData()
+{
+    auto transfer = fileTransfer_.get();
+
+    while (transfer->offset < transfer->size)
+    {
+        off_t offset = static_cast<off_t>(transfer->offset);
+        auto remaining = static_cast<size_t>(transfer->size - transfer->offset);
+
+        auto result = ::sendfile(socket_.native_handle(), transfer->file.get(), &offset, remaining);
+
+        if (result > 0)
+        {
+            transfer->offset = static_cast<int64_t>(offset);
+            continue;
+        }
+
+        if (result == 0)
+        {
+            completeFileTransfer(asio::error::eof);
+            return;
+        }
+
+        auto error = errno;
+
+        if (error == EINTR)
+            continue;
+
+        if (error == EAGAIN || error == EWOULDBLOCK)
+        {
+            auto thisPtr = shared_from_this();
+
+            socket_.async_wait(
+                asio::socket_base::wait_write,
+                [thisPtr](const boost::system::error_code& waitError) {
+                    if (waitError)
+                        thisPtr->completeFileTransfer(waitError);
+                    else
+                        thisPtr->sendFileData();
+                });
+            return;
+        }
+
+        if (error == EINVAL || error == ENOSYS)
+        {
+            copyFileData();
+            return;
+        }
+
+        completeFileTransfer(boost::system::error_code(error, boost::system::system_category()));
+        return;
+    }
+
+    completeFileTransfer(boost::system::error_code());
 }
 
+void BeastConnection::copyFileData()
+{
+    auto transfer = fileTransfer_.get();
+
+    if (transfer->offset >= transfer->size)
+    {
+        completeFileTransfer(boost::system::error_code());
+        return;
+    }
+
+    const int64_t chunkSize = 64 * 1024;
+
+    transfer->buffer.resize(static_cast<size_t>(std::min(chunkSize, transfer->size - transfer->offset)));
+
+    auto result = ::pread(
+        transfer->file.get(),
+        transfer->buffer.data(),
+        transfer->buffer.size(),
+        static_cast<off_t>(transfer->offset));
+
+    if (result <= 0)
+    {
+        completeFileTransfer(result == 0
+            ? boost::system::error_code(asio::error::eof)
+            : boost::system::error_code(errno, boost::system::system_category()));
+        return;
+    }
+
+    transfer->offset += result;
+
+    auto thisPtr = shared_from_this();
+
+    asio::async_write(
+        socket_,
+        asio::buffer(transfer->buffer.data(), static_cast<size_t>(result)),
+        [thisPtr](const boost::system::error_code& error, size_t) {
+            if (error)
+                thisPtr->completeFileTransfer(error);
+            else
+                thisPtr->copyFileData();
+        });
+}
+
+void BeastConnection::completeFileTransfer(const boost::system::error_code& error)
+{
+    auto close = error || fileTransfer_->close;
+
+    fileTransfer_.reset();
+    busy_ = false;
+    handleWriteResponse(error, close);
+}
+
+#endif
+
 }
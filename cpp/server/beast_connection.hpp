@@ -3,12 +3,19 @@
 #include "beast.hpp"
 #include "server_core.hpp"
 #include "beast_request.hpp"
+#include "asio_adapters.hpp"
+
+#include <atomic>
 #include <unordered_set>
 
+#include <boost/optional.hpp>
+
 namespace msrv {
 
 class BeastConnection;
 
+class BeastWebSocketSession;
+
 struct BeastConnectionContext;
 
 class BeastConnection : public std::enable_shared_from_this<BeastConnection>
@@ -16,7 +23,7 @@ class BeastConnection : public std::enable_shared_from_this<BeastConnection>
 public:
     BeastConnection(
         BeastConnectionContext* context,
-        asio::ip::tcp::socket socket);
+        BeastSocket socket);
 
     ~BeastConnection();
 
@@ -25,9 +32,14 @@ public:
         return busy_;
     }
 
+    size_t shard() const;
+
     void run();
     void abort();
 
+    // Closes connection which is waiting for the next request for the longest time
+    static bool closeOldestIdle(BeastConnectionContext* context);
+
     template<typename Response>
     void writeResponse(Response* response)
     {
@@ -38,10 +50,10 @@ public:
         beast::http::async_write(
             socket_,
             *response,
-            [thisPtr, close](const boost::system::error_code& error, size_t) {
+            bindArena(arena_, [thisPtr, close](const boost::system::error_code& error, size_t) {
                 thisPtr->busy_ = false;
                 thisPtr->handleWriteResponse(error, close);
-            });
+            }));
     }
 
     template<typename Serializer>
@@ -59,25 +71,58 @@ public:
             });
     }
 
-    template<typename Serializer>
-    void writeResponseBody(Serializer* serializer, bool close)
+    template<typename ConstBufferSequence>
+    void writeResponseBuffers(const ConstBufferSequence& buffers, bool close)
     {
         auto thisPtr = shared_from_this();
 
         busy_ = true;
-        beast::http::async_write(
+        asio::async_write(
             socket_,
-            *serializer,
+            buffers,
             [thisPtr, close](const boost::system::error_code& error, size_t) {
                 thisPtr->busy_ = false;
                 thisPtr->handleWriteResponseBody(error, close);
             });
     }
 
+#ifdef HAVE_SENDFILE
+    template<typename Serializer>
+    void writeFileResponse(Serializer* serializer, FileHandle file, int64_t size, bool close)
+    {
+        auto thisPtr = shared_from_this();
+
+        fileTransfer_ = std::make_unique<FileTransfer>(std::move(file), size, close);
+
+        busy_ = true;
+        beast::http::async_write_header(
+            socket_,
+            *serializer,
+            [thisPtr](const boost::system::error_code& error, size_t) {
+                if (error)
+                    thisPtr->completeFileTransfer(error);
+                else
+                    thisPtr->startFileTransfer();
+            });
+    }
+#endif
+
 private:
+    using RequestParser = beast::http::request_parser<BeastHttpRequest::body_type, ArenaAllocator<char>>;
+
+    // Pipelined requests received while processing the current one are buffered up to this size,
+    // after that disconnect is not detected until response is written
+    static constexpr size_t MAX_PIPELINED_SIZE = 64 * 1024;
+    static constexpr size_t PIPELINED_READ_SIZE = 4096;
+
     void release();
     void closeSocket();
+    void startDeadline(DurationMs timeout);
+    void handleDeadline();
     void readRequest();
+    void waitRequest();
+    void readRequestHeader();
+    void readRequestBody();
     void handleReadRequest(const boost::system::error_code& error);
     void handleWriteResponse(const boost::system::error_code& error, bool close);
     void handleWriteResponseHeader(const boost::system::error_code& error);
@@ -85,27 +130,84 @@ private:
 
     void initCoreRequest();
     void releaseCoreRequest();
+    void watchDisconnect();
+    void handleDisconnectWait(const boost::system::error_code& error, uint64_t requestId);
+    void continueResponseBody();
+    void startWebSocketSession();
+
+#ifdef HAVE_SENDFILE
+    struct FileTransfer
+    {
+        FileTransfer(FileHandle fileVal, int64_t sizeVal, bool closeVal)
+            : file(std::move(fileVal)), offset(0), size(sizeVal), close(closeVal)
+        {
+        }
+
+        FileHandle file;
+        int64_t offset;
+        int64_t size;
+        bool close;
+        std::vector<uint8_t> buffer;
+    };
+
+    void startFileTransfer();
+    void sendFileData();
+    void copyFileData();
+    void completeFileTransfer(const boost::system::error_code& error);
+
+    std::unique_ptr<FileTransfer> fileTransfer_;
+#endif
 
     BeastConnectionContext* context_;
-    asio::ip::tcp::socket socket_;
+    BeastSocket socket_;
 
     beast::flat_buffer buffer_;
-    beast::http::request<beast::http::string_body> request_;
+    boost::optional<RequestParser> parser_;
+    BeastHttpRequest request_;
+
+    TimerPtr deadlineTimer_;
+    boost::optional<TimePointMs> idleSince_;
 
-    std::unique_ptr<BeastRequest> coreRequest_;
+    RequestArena* arena_;
+    ArenaPtr<BeastRequest> coreRequest_;
+    uint64_t requestId_;
     bool busy_;
 };
 
 struct BeastConnectionContext
 {
-    BeastConnectionContext()
-        : activeConnections(),
-          eventListener(nullptr)
+    BeastConnectionContext(
+        asio::io_context* ioContextVal,
+        size_t shardVal,
+        std::atomic<size_t>* connectionCountVal)
+        : ioContext(ioContextVal),
+          shard(shardVal),
+          connectionCount(connectionCountVal),
+          timerFactory(ioContextVal),
+          limits(),
+          activeConnections(),
+          activeWebSockets(),
+          eventListener(nullptr),
+          arenaPool(std::make_shared<RequestArenaPool>())
     {
     }
 
+    ~BeastConnectionContext();
+
+    asio::io_context* const ioContext;
+    const size_t shard;
+
+    // Connections and web socket sessions of all shards
+    std::atomic<size_t>* const connectionCount;
+
+    // Runs connection deadlines and other timers of this shard
+    AsioTimerFactory timerFactory;
+
+    ConnectionLimits limits;
     std::unordered_set<std::shared_ptr<BeastConnection>> activeConnections;
+    std::unordered_set<std::shared_ptr<BeastWebSocketSession>> activeWebSockets;
     RequestEventListener* eventListener;
+    const RequestArenaPoolPtr arenaPool;
 
     MSRV_NO_COPY_AND_ASSIGN(BeastConnectionContext);
 };
@@ -5,19 +5,26 @@
 namespace msrv {
 
 BeastListener::BeastListener(
-    asio::io_context* ioContext,
-    BeastConnectionContext* connectionContext,
-    const asio::ip::tcp::endpoint& endpoint)
-    : ioContext_(ioContext),
-      connectionContext_(connectionContext),
-      acceptor_(*ioContext),
-      peerSocket_(*ioContext)
+    std::vector<BeastConnectionContext*> connectionContexts,
+    const BeastEndpoint& endpoint)
+    : connectionContexts_(std::move(connectionContexts)),
+      nextContextIndex_(0),
+      nextEvictIndex_(0),
+      ioContext_(connectionContexts_.front()->ioContext),
+      acceptor_(*ioContext_),
+      throttleTimer_(*ioContext_),
+      isTcp_(false)
 {
     acceptor_.open(endpoint.protocol());
 
-    acceptor_.set_option(asio::socket_base::reuse_address(true));
+    auto family = endpoint.protocol().family();
+
+    isTcp_ = family == asio::ip::tcp::v4().family() || family == asio::ip::tcp::v6().family();
+
+    if (isTcp_)
+        acceptor_.set_option(asio::socket_base::reuse_address(true));
 
-    if (endpoint.protocol() == asio::ip::tcp::v6())
+    if (family == asio::ip::tcp::v6().family())
         acceptor_.set_option(asio::ip::v6_only(true));
 
     acceptor_.bind(endpoint);
@@ -31,31 +38,126 @@ void BeastListener::run()
     accept();
 }
 
+BeastConnectionContext* BeastListener::nextConnectionContext()
+{
+    auto context = connectionContexts_[nextContextIndex_];
+    nextContextIndex_ = (nextContextIndex_ + 1) % connectionContexts_.size();
+    return context;
+}
+
 void BeastListener::accept()
 {
     auto thisPtr = shared_from_this();
+    auto connectionContext = nextConnectionContext();
 
+    // Accepted socket is bound to io_context of the shard which is going to serve the connection
     acceptor_.async_accept(
-        peerSocket_,
-        [thisPtr](const boost::system::error_code& error) {
-            thisPtr->handleAccept(error);
+        *connectionContext->ioContext,
+        [thisPtr, connectionContext](const boost::system::error_code& error, BeastSocket peerSocket) {
+            thisPtr->handleAccept(connectionContext, error, std::move(peerSocket));
         });
 }
 
-void BeastListener::handleAccept(const boost::system::error_code& error)
+void BeastListener::handleAccept(
+    BeastConnectionContext* connectionContext,
+    const boost::system::error_code& error,
+    BeastSocket peerSocket)
 {
+    if (!error && isTcp_)
+    {
+        // Responses are written in several chunks, don't let the last one wait for delayed ACK
+        boost::system::error_code optionError;
+        peerSocket.set_option(asio::ip::tcp::no_delay(true), optionError);
+    }
+
     if (error)
     {
         logError("handleAccept: %s", error.message().c_str());
     }
+    else if (isConnectionLimitReached())
+    {
+        throttle(connectionContext, std::move(peerSocket));
+        return;
+    }
     else
     {
-        auto connection = std::make_shared<BeastConnection>(connectionContext_, std::move(peerSocket_));
-        connection->run();
+        dispatchConnection(connectionContext, std::move(peerSocket));
     }
 
     if (!ioContext_->stopped())
         accept();
 }
 
+bool BeastListener::isConnectionLimitReached() const
+{
+    // Limits of all shards are the same, listener is running on the first one
+    auto context = connectionContexts_.front();
+    auto maxConnections = context->limits.maxConnections;
+
+    return maxConnections > 0 && context->connectionCount->load(std::memory_order_relaxed) >= maxConnections;
+}
+
+void BeastListener::throttle(BeastConnectionContext* connectionContext, BeastSocket peerSocket)
+{
+    // Accepted connection waits for a free slot, other clients wait in listen backlog.
+    // Idle connections are closed one at a time, search starts from the next shard each time.
+    closeIdleConnection(nextEvictIndex_, connectionContexts_.size());
+    nextEvictIndex_ = (nextEvictIndex_ + 1) % connectionContexts_.size();
+
+    auto thisPtr = shared_from_this();
+
+    throttleTimer_.expires_after(THROTTLE_DELAY);
+    throttleTimer_.async_wait(
+        [thisPtr, connectionContext, socket = std::move(peerSocket)](const boost::system::error_code& error) mutable {
+            if (error)
+                return;
+
+            if (thisPtr->isConnectionLimitReached())
+            {
+                thisPtr->throttle(connectionContext, std::move(socket));
+                return;
+            }
+
+            thisPtr->dispatchConnection(connectionContext, std::move(socket));
+            thisPtr->accept();
+        });
+}
+
+void BeastListener::closeIdleConnection(size_t contextIndex, size_t contextsLeft)
+{
+    auto thisPtr = shared_from_this();
+    auto context = connectionContexts_[contextIndex];
+
+    // Shards are visited one by one on their own threads until idle connection is found
+    asio::post(*context->ioContext, [thisPtr, context, contextIndex, contextsLeft] {
+        if (BeastConnection::closeOldestIdle(context) || contextsLeft <= 1)
+            return;
+
+        thisPtr->closeIdleConnection((contextIndex + 1) % thisPtr->connectionContexts_.size(), contextsLeft - 1);
+    });
+}
+
+void BeastListener::dispatchConnection(BeastConnectionContext* connectionContext, BeastSocket peerSocket)
+{
+    if (connectionContext->ioContext == ioContext_)
+    {
+        startConnection(connectionContext, std::move(peerSocket));
+        return;
+    }
+
+    asio::post(
+        *connectionContext->ioContext,
+        [connectionContext, socket = std::move(peerSocket)]() mutable {
+            startConnection(connectionContext, std::move(socket));
+        });
+}
+
+void BeastListener::startConnection(
+    BeastConnectionContext* connectionContext,
+    BeastSocket peerSocket)
+{
+    auto connection = std::make_shared<BeastConnection>(connectionContext, std::move(peerSocket));
+    connection->run();
+}
+
 }
@@ -3,6 +3,8 @@
 #include "beast.hpp"
 #include "server_core.hpp"
 
+#include <vector>
+
 namespace msrv {
 
 struct BeastConnectionContext;
@@ -11,24 +13,44 @@ class BeastListener : public std::enable_shared_from_this<BeastListener>
 {
 public:
     BeastListener(
-        asio::io_context* ioContext,
-        BeastConnectionContext* connectionContext,
-        const asio::ip::tcp::endpoint& endpoint);
+        std::vector<BeastConnectionContext*> connectionContexts,
+        const BeastEndpoint& endpoint);
 
     ~BeastListener();
 
     void run();
 
+    // Interval of checking connection count when connection limit is reached
+    static constexpr DurationMs THROTTLE_DELAY = DurationMs(50);
+
 private:
     void accept();
-    void handleAccept(const boost::system::error_code& error);
+    void handleAccept(
+        BeastConnectionContext* connectionContext,
+        const boost::system::error_code& error,
+        BeastSocket peerSocket);
 
-    asio::io_context* ioContext_;
-    BeastConnectionContext* connectionContext_;
+    bool isConnectionLimitReached() const;
+    void throttle(BeastConnectionContext* connectionContext, BeastSocket peerSocket);
+    void closeIdleConnection(size_t contextIndex, size_t contextsLeft);
+    void dispatchConnection(BeastConnectionContext* connectionContext, BeastSocket peerSocket);
 
-    asio::ip::tcp::acceptor acceptor_;
-    asio::ip::tcp::socket peerSocket_;
-    asio::ip::tcp::endpoint peerEndpoint_;
+    static void startConnection(
+        BeastConnectionContext* connectionContext,
+        BeastSocket peerSocket);
+
+    BeastConnectionContext* nextConnectionContext();
+
+    std::vector<BeastConnectionContext*> connectionContexts_;
+    size_t nextContextIndex_;
+
+    // Eviction has its own cursor, so that throttling does not affect distribution of connections
+    size_t nextEvictIndex_;
+
+    asio::io_context* ioContext_;
+    BeastAcceptor acceptor_;
+    asio::steady_timer throttleTimer_;
+    bool isTcp_;
 };
 
 }
@@ -6,6 +6,16 @@ namespace msrv {
 
 namespace {
 
+#ifdef HAVE_SENDFILE
+constexpr int64_t SEND_FILE_THRESHOLD = 64 * 1024;
+
+struct FileResponseHeader
+{
+    beast::http::response<beast::http::empty_body> response;
+    beast::http::response_serializer<beast::http::empty_body> serializer{response};
+};
+#endif
+
 inline beast::http::status convertStatusCode(HttpStatus status)
 {
     return beast::http::int_to_status(static_cast<unsigned>(status));
@@ -23,11 +33,13 @@ class ResponseCoreSender : public boost::static_visitor<std::shared_ptr<void>>
 public:
     ResponseCoreSender(
         BeastConnection* connection,
-        beast::http::request<beast::http::string_body>* request,
-        ResponseCore* coreResponse)
+        const BeastHttpRequest* request,
+        ResponseCore* coreResponse,
+        RequestArena* arena)
         : connection_(connection),
           request_(request),
-          coreResponse_(coreResponse)
+          coreResponse_(coreResponse),
+          arena_(arena)
     {
     }
 
@@ -66,6 +78,11 @@ public:
         if (fileResponse.size == 0)
             return sendEmpty();
 
+#ifdef HAVE_SENDFILE
+        if (fileResponse.size >= SEND_FILE_THRESHOLD)
+            return sendFile(fileResponse);
+#endif
+
         auto resp = createResponse<beast::http::file_body>();
 
         beast::file file;
@@ -78,17 +95,44 @@ public:
     }
 
 private:
+#ifdef HAVE_SENDFILE
+    std::shared_ptr<void> sendFile(ResponseCore::FileBody& fileResponse) const
+    {
+        auto header = std::allocate_shared<FileResponseHeader>(ArenaAllocator<FileResponseHeader>(arena_));
+        auto& resp = header->response;
+
+        resp.result(convertStatusCode(coreResponse_->status));
+        resp.version(request_->version());
+        resp.keep_alive(request_->keep_alive());
+        convertHeaders(coreResponse_, &resp);
+        resp.content_length(static_cast<uint64_t>(fileResponse.size));
+
+        connection_->writeFileResponse(
+            &header->serializer,
+            std::move(fileResponse.handle),
+            fileResponse.size,
+            resp.need_eof());
+
+        return header;
+    }
+#endif
+
     std::shared_ptr<void> sendEmpty() const
     {
         return doSend(createResponse<beast::http::empty_body>());
     }
 
     template<typename Body>
-    std::shared_ptr<beast::http::response<Body>> createResponse() const
+    std::shared_ptr<BeastHttpResponse<Body>> createResponse() const
     {
-        auto resp = std::make_shared<beast::http::response<Body>>(
-            convertStatusCode(coreResponse_->status), request_->version());
-
+        auto resp = std::allocate_shared<BeastHttpResponse<Body>>(
+            ArenaAllocator<BeastHttpResponse<Body>>(arena_),
+            std::piecewise_construct,
+            std::make_tuple(),
+            std::make_tuple(ArenaAllocator<char>(arena_)));
+
+        resp->result(convertStatusCode(coreResponse_->status));
+        resp->version(request_->version());
         resp->keep_alive(request_->keep_alive());
         convertHeaders(coreResponse_, resp.get());
 
@@ -104,85 +148,94 @@ private:
     }
 
     BeastConnection* connection_;
-    beast::http::request<beast::http::string_body>* request_;
+    const BeastHttpRequest* request_;
     ResponseCore* coreResponse_;
+    RequestArena* arena_;
 };
 
-class ResponseBodyFormatter : public boost::static_visitor<bool>
+class ResponseBodyBuffer : public boost::static_visitor<asio::const_buffer>
 {
 public:
-    ResponseBodyFormatter(
-        ResponseCore::Body* source,
-        beast::http::buffer_body::value_type* target)
-        : source_(source),
-          target_(target)
+    asio::const_buffer operator()(bool) const
     {
+        return asio::const_buffer();
     }
 
-    bool format() const
+    asio::const_buffer operator()(const std::string& str) const
     {
-        return boost::apply_visitor(*this, *source_);
+        return asio::buffer(str);
     }
 
-    bool operator()(bool) const
+    asio::const_buffer operator()(const std::vector<uint8_t>& buffer) const
     {
-        return false;
+        return asio::buffer(buffer);
     }
 
-    bool operator()(std::string& str) const
+    asio::const_buffer operator()(const ResponseCore::FileBody&) const
     {
-        if (str.empty())
-            return false;
-
-        target_->data = &str[0];
-        target_->size = str.length();
-        return true;
+        return asio::const_buffer();
     }
-
-    bool operator()(std::vector<uint8_t>& buffer) const
-    {
-        if (buffer.empty())
-            return false;
-
-        target_->data = buffer.data();
-        target_->size = buffer.size();
-        return true;
-    }
-
-    bool operator()(ResponseCore::FileBody&) const
-    {
-        return false;
-    }
-
-private:
-    ResponseCore::Body* source_;
-    beast::http::buffer_body::value_type* target_;
 };
 
 }
 
-BeastRequest::BeastRequest(
-    BeastConnection* connection,
-    beast::http::request<beast::http::string_body>* request)
-    : connection_(connection),
-      request_(request)
+BeastRequestMessage::BeastRequestMessage(BeastHttpRequest request)
+    : request_(std::move(request))
 {
-    auto target = request_->target();
+    auto target = request_.target();
     auto pos = target.find('?');
 
     if (pos != boost::string_view::npos)
     {
-        path_ = target.substr(0, pos);
-        queryParams_ = target.substr(pos + 1);
+        path_ = StringView(target.data(), pos);
+        queryString_ = StringView(target.data() + pos + 1, target.size() - pos - 1);
     }
     else
     {
-        path_ = target;
+        path_ = StringView(target.data(), target.size());
+    }
+}
+
+BeastRequestMessage::~BeastRequestMessage() = default;
+
+bool BeastRequestMessage::findHeader(StringView name, StringView* value) const
+{
+    auto it = request_.find(beast::string_view(name.data(), name.size()));
+    if (it == request_.end())
+        return false;
+
+    auto headerValue = it->value();
+    *value = StringView(headerValue.data(), headerValue.size());
+    return true;
+}
+
+void BeastRequestMessage::visitHeaders(const HttpHeaderVisitor& visitor) const
+{
+    for (auto& header : request_)
+    {
+        auto name = header.name_string();
+        auto value = header.value();
+
+        visitor(StringView(name.data(), name.size()), StringView(value.data(), value.size()));
     }
 }
 
+BeastRequest::BeastRequest(BeastConnection* connection, BeastHttpRequest* request, RequestArena* arena)
+    : connection_(connection),
+      arena_(arena),
+      message_(std::allocate_shared<BeastRequestMessage>(
+          ArenaAllocator<BeastRequestMessage>(arena), std::move(*request))),
+      request_(&message_->request())
+{
+}
+
 BeastRequest::~BeastRequest() = default;
 
+size_t BeastRequest::shard()
+{
+    return connection_->shard();
+}
+
 HttpMethod BeastRequest::method()
 {
     switch (request_->method())
@@ -201,33 +254,9 @@ HttpMethod BeastRequest::method()
     }
 }
 
-std::string BeastRequest::path()
-{
-    return urlDecode(path_);
-}
-
-HttpKeyValueMap BeastRequest::headers()
-{
-    HttpKeyValueMap headers;
-
-    for (auto& header : *request_)
-    {
-        headers.emplace(
-            static_cast<std::string>(header.name_string()),
-            static_cast<std::string>(header.value()));
-    }
-
-    return headers;
-}
-
-HttpKeyValueMap BeastRequest::queryParams()
-{
-    return parseQueryString(queryParams_);
-}
-
-StringView BeastRequest::body()
+RequestMessagePtr BeastRequest::message()
 {
-    return StringView(request_->body());
+    return message_;
 }
 
 void BeastRequest::abort()
@@ -237,7 +266,7 @@ void BeastRequest::abort()
 
 void BeastRequest::sendResponse(ResponseCorePtr response)
 {
-    ResponseCoreSender sender(connection_, request_, response.get());
+    ResponseCoreSender sender(connection_, request_, response.get(), arena_);
     response_ = sender.send();
 }
 
@@ -257,6 +286,11 @@ void BeastRequest::sendResponseEnd()
     responseStream_->setEndOfStream();
 }
 
+size_t BeastRequest::pendingBodySize()
+{
+    return responseStream_ ? responseStream_->pendingSize() : 0;
+}
+
 void BeastRequest::requestBodyData()
 {
     responseStream_->releaseBuffer();
@@ -265,25 +299,32 @@ void BeastRequest::requestBodyData()
 
 BeastResponseStream::BeastResponseStream(
     BeastConnection* connection,
-    beast::http::request<beast::http::string_body>* request,
+    const BeastHttpRequest* request,
     ResponseCore* coreResponse)
     : connection_(connection),
       response_(),
       serializer_(response_),
+      pendingSize_(0),
       endOfStream_(false)
 {
     response_.result(convertStatusCode(coreResponse->status));
     response_.version(request->version());
     response_.keep_alive(false);
     convertHeaders(coreResponse, &response_);
-    pendingChunks_.emplace(std::move(coreResponse->body));
+    addPendingChunk(std::move(coreResponse->body));
 }
 
 BeastResponseStream::~BeastResponseStream() = default;
 
-void BeastResponseStream::addChunk(ResponseCore::Body chunk)
+void BeastResponseStream::addPendingChunk(ResponseCore::Body chunk)
 {
+    pendingSize_ += boost::apply_visitor(ResponseBodyBuffer(), chunk).size();
     pendingChunks_.emplace(std::move(chunk));
+}
+
+void BeastResponseStream::addChunk(ResponseCore::Body chunk)
+{
+    addPendingChunk(std::move(chunk));
 
     if (!connection_->busy())
         writeNextChunk();
@@ -312,21 +353,39 @@ void BeastResponseStream::writeNextChunk()
     if (pendingChunks_.empty())
         return;
 
-    currentChunk_ = std::move(pendingChunks_.front());
-    pendingChunks_.pop();
+    // Body is delimited by connection close, so pending chunks
+    // are written as is with a single gather write
+    size_t batchSize = 0;
+
+    while (!pendingChunks_.empty())
+    {
+        auto size = boost::apply_visitor(ResponseBodyBuffer(), pendingChunks_.front()).size();
 
-    ResponseBodyFormatter formatter(&currentChunk_, &response_.body());
-    formatter.format();
+        if (!currentChunks_.empty() && batchSize + size > MAX_WRITE_BATCH_SIZE)
+            break;
+
+        currentChunks_.emplace_back(std::move(pendingChunks_.front()));
+        pendingChunks_.pop();
+        batchSize += size;
+    }
+
+    for (auto& chunk : currentChunks_)
+    {
+        auto buffer = boost::apply_visitor(ResponseBodyBuffer(), chunk);
+
+        if (buffer.size() > 0)
+            currentBuffers_.emplace_back(buffer);
+    }
 
     auto close = pendingChunks_.empty() && endOfStream_;
-    response_.body().more = !close;
-    connection_->writeResponseBody(&serializer_, close);
+    connection_->writeResponseBuffers(currentBuffers_, close);
 }
 
 void BeastResponseStream::releaseBuffer()
 {
-    std::string temp;
-    currentChunk_ = std::move(temp);
+    pendingSize_ -= asio::buffer_size(currentBuffers_);
+    currentBuffers_.clear();
+    currentChunks_.clear();
 }
 
 }
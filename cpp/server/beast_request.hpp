@@ -2,6 +2,7 @@
 
 #include "server_core.hpp"
 #include "beast.hpp"
+#include "request_arena.hpp"
 #include <queue>
 
 namespace msrv {
@@ -10,39 +11,81 @@ class BeastConnection;
 
 class BeastResponseStream;
 
-class BeastRequest final : public RequestCore
+using BeastHttpFields = beast::http::basic_fields<ArenaAllocator<char>>;
+using BeastHttpRequest = beast::http::request<beast::http::string_body, BeastHttpFields>;
+
+template<typename Body>
+using BeastHttpResponse = beast::http::response<Body, BeastHttpFields>;
+
+class BeastRequestMessage final : public RequestMessage
 {
 public:
-    BeastRequest(
-        BeastConnection* connection,
-        beast::http::request<beast::http::string_body>* request);
+    explicit BeastRequestMessage(BeastHttpRequest request);
+    ~BeastRequestMessage();
+
+    const BeastHttpRequest& request() const
+    {
+        return request_;
+    }
+
+    virtual StringView path() const override
+    {
+        return path_;
+    }
+
+    virtual StringView queryString() const override
+    {
+        return queryString_;
+    }
+
+    virtual StringView body() const override
+    {
+        return StringView(request_.body());
+    }
 
+    virtual bool findHeader(StringView name, StringView* value) const override;
+    virtual void visitHeaders(const HttpHeaderVisitor& visitor) const override;
+
+private:
+    BeastHttpRequest request_;
+    StringView path_;
+    StringView queryString_;
+};
+
+class BeastRequest final : public RequestCore
+{
+public:
+    BeastRequest(BeastConnection* connection, BeastHttpRequest* request, RequestArena* arena);
     ~BeastRequest();
 
+    virtual size_t shard() override;
     virtual HttpMethod method() override;
-    virtual std::string path() override;
-    virtual HttpKeyValueMap headers() override;
-    virtual HttpKeyValueMap queryParams() override;
-    virtual StringView body() override;
+    virtual RequestMessagePtr message() override;
 
     virtual void releaseResources() override
     {
     }
 
+    virtual RequestArena* arena() override
+    {
+        return arena_;
+    }
+
     virtual void abort() override;
 
     virtual void sendResponse(ResponseCorePtr response) override;
     virtual void sendResponseBegin(ResponseCorePtr response) override;
     virtual void sendResponseBody(ResponseCore::Body body) override;
     virtual void sendResponseEnd() override;
+    virtual size_t pendingBodySize() override;
 
     void requestBodyData();
 
 private:
     BeastConnection* connection_;
-    beast::http::request<beast::http::string_body>* request_;
-    boost::string_view path_;
-    boost::string_view queryParams_;
+    RequestArena* arena_;
+    std::shared_ptr<BeastRequestMessage> message_;
+    const BeastHttpRequest* request_;
 
     std::shared_ptr<void> response_;
     std::unique_ptr<BeastResponseStream> responseStream_;
@@ -53,7 +96,7 @@ class BeastResponseStream
 public:
     BeastResponseStream(
         BeastConnection* connection,
-        beast::http::request<beast::http::string_body>* request,
+        const BeastHttpRequest* request,
         ResponseCore* coreResponse);
 
     ~BeastResponseStream();
@@ -65,14 +108,25 @@ public:
     void addChunk(ResponseCore::Body chunk);
     void setEndOfStream();
 
+    size_t pendingSize() const
+    {
+        return pendingSize_;
+    }
+
 private:
+    static constexpr size_t MAX_WRITE_BATCH_SIZE = 256 * 1024;
+
+    void addPendingChunk(ResponseCore::Body chunk);
+
     BeastConnection* connection_;
 
-    beast::http::response<beast::http::buffer_body> response_;
-    beast::http::response_serializer<beast::http::buffer_body, beast::http::fields> serializer_;
+    beast::http::response<beast::http::empty_body> response_;
+    beast::http::response_serializer<beast::http::empty_body, beast::http::fields> serializer_;
 
-    ResponseCore::Body currentChunk_;
+    std::vector<ResponseCore::Body> currentChunks_;
+    std::vector<asio::const_buffer> currentBuffers_;
     std::queue<ResponseCore::Body> pendingChunks_;
+    size_t pendingSize_;
     bool endOfStream_;
 };
 
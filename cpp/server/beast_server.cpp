@@ -1,6 +1,9 @@
 #include "beast_server.hpp"
 #include "beast_listener.hpp"
+#include "beast_websocket.hpp"
 #include "log.hpp"
+#include "project_info.hpp"
+#include "file_system.hpp"
 
 namespace msrv {
 
@@ -14,50 +17,138 @@ asio::ip::tcp::endpoint makeEndpoint(int port, bool allowRemote)
         static_cast<unsigned short>(port));
 }
 
+std::string formatEndpoint(const asio::ip::tcp::endpoint& endpoint)
+{
+    return "[" + endpoint.address().to_string() + "]:" + toString(endpoint.port());
+}
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+bool isSocketFile(const std::string& path)
+{
+    boost::system::error_code error;
+    return fs::status(path, error).type() == fs::socket_file;
+}
+
+void removeStaleSocket(const std::string& path)
+{
+    boost::system::error_code error;
+
+    if (!fs::exists(path, error))
+        return;
+
+    // Mistyped path should never cause removal of user files
+    if (!isSocketFile(path))
+        throw std::runtime_error("path exists and is not a socket");
+
+    asio::io_context ioContext;
+    asio::local::stream_protocol::socket socket(ioContext);
+    socket.connect(asio::local::stream_protocol::endpoint(path), error);
+
+    if (!error)
+        throw std::runtime_error("socket is in use by another process");
+
+    fs::remove(path);
 }
 
-ServerCorePtr ServerCore::create()
+#endif
+
+}
+
+ServerCorePtr ServerCore::create(size_t ioThreads)
 {
-    return std::make_unique<BeastServer>();
+    return std::make_unique<BeastServer>(ioThreads);
 }
 
-BeastServer::BeastServer()
-    : ioContext_(),
-      connectionContext_(),
-      workQueue_(&ioContext_),
-      timerFactory_(&ioContext_)
+BeastServer::BeastServer(size_t shardCount)
+    : connectionCount_(0),
+      shards_(createShards(shardCount)),
+      shardThreads_(),
+      timerFactory_(&shards_.front()->ioContext)
 {
 }
 
-BeastServer::~BeastServer() = default;
+BeastServer::~BeastServer()
+{
+    stopShardThreads();
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    for (auto& path : localSocketPaths_)
+    {
+        // Socket could have been replaced by something else while server was running
+        if (!isSocketFile(path))
+            continue;
+
+        boost::system::error_code error;
+        fs::remove(path, error);
+    }
+#endif
+}
+
+std::vector<std::unique_ptr<BeastServer::Shard>> BeastServer::createShards(size_t count)
+{
+    assert(count > 0);
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    shards.reserve(count);
+
+    for (size_t i = 0; i < count; i++)
+        shards.emplace_back(std::make_unique<Shard>(i, &connectionCount_));
+
+    return shards;
+}
 
 void BeastServer::setEventListener(RequestEventListener* listener)
 {
-    connectionContext_.eventListener = listener;
+    for (auto& shard : shards_)
+        shard->connectionContext.eventListener = listener;
 };
 
-bool BeastServer::startListener(const asio::ip::tcp::endpoint& endpoint)
+void BeastServer::setConnectionLimits(const ConnectionLimits& limits)
+{
+    for (auto& shard : shards_)
+    {
+        auto context = &shard->connectionContext;
+        asio::post(shard->ioContext, [context, limits] { context->limits = limits; });
+    }
+}
+
+void BeastServer::closeWebSockets()
+{
+    for (auto& shard : shards_)
+    {
+        auto context = &shard->connectionContext;
+
+        asio::post(shard->ioContext, [context] {
+            // Sessions remove themselves from the set when closed
+            auto sessions = context->activeWebSockets;
+
+            for (auto& session : sessions)
+                session->close();
+        });
+    }
+}
+
+bool BeastServer::startListener(const BeastEndpoint& endpoint, const std::string& name)
 {
     try
     {
-        auto listener = std::make_shared<BeastListener>(
-            &ioContext_, &connectionContext_, endpoint);
+        std::vector<BeastConnectionContext*> connectionContexts;
+        connectionContexts.reserve(shards_.size());
 
-        logInfo(
-            "listening on [%s]:%d",
-            endpoint.address().to_string().c_str(),
-            static_cast<int>(endpoint.port()));
+        for (auto& shard : shards_)
+            connectionContexts.push_back(&shard->connectionContext);
+
+        auto listener = std::make_shared<BeastListener>(std::move(connectionContexts), endpoint);
+
+        logInfo("listening on %s", name.c_str());
 
         listener->run();
         return true;
     }
     catch (std::exception& ex)
     {
-        logError(
-            "failed to bind to address [%s]:%d: %s",
-            endpoint.address().to_string().c_str(),
-            static_cast<int>(endpoint.port()),
-            ex.what());
+        logError("failed to bind to %s: %s", name.c_str(), ex.what());
 
         return false;
     }
@@ -65,21 +156,80 @@ bool BeastServer::startListener(const asio::ip::tcp::endpoint& endpoint)
 
 void BeastServer::bind(int port, bool allowRemote)
 {
-    bool runningV4 = startListener(makeEndpoint<asio::ip::address_v4>(port, allowRemote));
-    bool runningV6 = startListener(makeEndpoint<asio::ip::address_v6>(port, allowRemote));
+    auto endpointV4 = makeEndpoint<asio::ip::address_v4>(port, allowRemote);
+    auto endpointV6 = makeEndpoint<asio::ip::address_v6>(port, allowRemote);
+
+    bool runningV4 = startListener(endpointV4, formatEndpoint(endpointV4));
+    bool runningV6 = startListener(endpointV6, formatEndpoint(endpointV6));
 
     if (!runningV4 && !runningV6)
         throw std::runtime_error("failed to bind to any address");
 }
 
+void BeastServer::bindLocal(const std::string& path)
+{
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    try
+    {
+        removeStaleSocket(path);
+    }
+    catch (std::exception& ex)
+    {
+        logError("failed to bind to %s: %s", path.c_str(), ex.what());
+        return;
+    }
+
+    if (startListener(asio::local::stream_protocol::endpoint(path), path))
+        localSocketPaths_.push_back(path);
+#else
+    logError("failed to bind to %s: local sockets are not supported", path.c_str());
+#endif
+}
+
 void BeastServer::run()
 {
-    ioContext_.run();
+    for (size_t i = 1; i < shards_.size(); i++)
+    {
+        auto shard = shards_[i].get();
+
+        shardThreads_.emplace_back([shard] {
+            setThreadName(MSRV_THREAD_NAME("server"));
+
+            auto workGuard = asio::make_work_guard(shard->ioContext);
+            tryCatchLog([shard] { shard->ioContext.run(); });
+        });
+    }
+
+    try
+    {
+        shards_.front()->ioContext.run();
+    }
+    catch (...)
+    {
+        stopShardThreads();
+        throw;
+    }
+
+    stopShardThreads();
 }
 
 void BeastServer::exit()
 {
-    ioContext_.stop();
+    for (auto& shard : shards_)
+        shard->ioContext.stop();
+}
+
+void BeastServer::stopShardThreads()
+{
+    if (shardThreads_.empty())
+        return;
+
+    exit();
+
+    for (auto& thread : shardThreads_)
+        thread.join();
+
+    shardThreads_.clear();
 }
 
 }
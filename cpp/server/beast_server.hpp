@@ -6,17 +6,20 @@
 #include "beast_connection.hpp"
 #include "beast_listener.hpp"
 
+#include <thread>
+#include <vector>
+
 namespace msrv {
 
 class BeastServer : public ServerCore
 {
 public:
-    BeastServer();
+    explicit BeastServer(size_t shardCount);
     virtual ~BeastServer();
 
     virtual WorkQueue* workQueue() override
     {
-        return &workQueue_;
+        return &shards_.front()->workQueue;
     }
 
     virtual TimerFactory* timerFactory() override
@@ -24,18 +27,56 @@ public:
         return &timerFactory_;
     }
 
+    virtual size_t shardCount() override
+    {
+        return shards_.size();
+    }
+
+    virtual WorkQueue* shardWorkQueue(size_t shard) override
+    {
+        return &shards_[shard]->workQueue;
+    }
+
+    virtual TimerFactory* shardTimerFactory(size_t shard) override
+    {
+        return &shards_[shard]->connectionContext.timerFactory;
+    }
+
     virtual void setEventListener(RequestEventListener* listener) override;
+    virtual void setConnectionLimits(const ConnectionLimits& limits) override;
+    virtual void closeWebSockets() override;
 
     virtual void bind(int port, bool allowRemote) override;
+    virtual void bindLocal(const std::string& path) override;
     virtual void run() override;
     virtual void exit() override;
 
 private:
-    bool startListener(const asio::ip::tcp::endpoint& endpoint);
+    struct Shard
+    {
+        Shard(size_t index, std::atomic<size_t>* connectionCount)
+            : ioContext(),
+              connectionContext(&ioContext, index, connectionCount),
+              workQueue(&ioContext)
+        {
+        }
+
+        asio::io_context ioContext;
+        BeastConnectionContext connectionContext;
+        AsioWorkQueue workQueue;
+
+        MSRV_NO_COPY_AND_ASSIGN(Shard);
+    };
+
+    std::vector<std::unique_ptr<Shard>> createShards(size_t count);
+
+    bool startListener(const BeastEndpoint& endpoint, const std::string& name);
+    void stopShardThreads();
 
-    asio::io_context ioContext_;
-    BeastConnectionContext connectionContext_;
-    AsioWorkQueue workQueue_;
+    std::atomic<size_t> connectionCount_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::vector<std::thread> shardThreads_;
+    std::vector<std::string> localSocketPaths_;
     AsioTimerFactory timerFactory_;
 };
 
@@ -0,0 +1,609 @@
+#include "beast_websocket.hpp"
+#include "beast_connection.hpp"
+#include "file_system.hpp"
+#include "log.hpp"
+
+#include <boost/algorithm/string/predicate.hpp>
+
+namespace msrv {
+
+namespace {
+
+constexpr char WEBSOCKET_PATH[] = "/api/ws";
+constexpr char EVENT_PREFIX[] = "data: ";
+constexpr char EVENT_ID_PREFIX[] = "\nid: ";
+
+inline StringView targetPath(StringView target)
+{
+    auto pos = target.find('?');
+    return pos != StringView::npos ? target.substr(0, pos) : target;
+}
+
+inline StringView headerValue(const BeastHttpRequest& request, beast::http::field field)
+{
+    auto it = request.find(field);
+    if (it == request.end())
+        return StringView();
+
+    return StringView(it->value().data(), it->value().size());
+}
+
+// Browsers do not apply CORS to WebSocket handshakes, so pages of other sites should be rejected here.
+// Origin is sent only by browsers, other clients are not affected.
+bool isAllowedOrigin(const BeastHttpRequest& request)
+{
+    auto origin = headerValue(request, beast::http::field::origin);
+    if (origin.empty())
+        return true;
+
+    auto schemeEnd = origin.find("://");
+    if (schemeEnd == StringView::npos)
+        return false;
+
+    auto originHost = origin.substr(schemeEnd + 3);
+    auto host = headerValue(request, beast::http::field::host);
+
+    return !host.empty() && boost::algorithm::iequals(originHost, host);
+}
+
+inline bool isJsonContentType(StringView contentType)
+{
+    return contentType.starts_with(ContentType::APPLICATION_JSON);
+}
+
+inline bool isTextContentType(StringView contentType)
+{
+    return contentType.starts_with("text/");
+}
+
+class FrameBodyFormatter : public boost::static_visitor<std::string>
+{
+public:
+    explicit FrameBodyFormatter(StringView contentType)
+        : contentType_(contentType)
+    {
+    }
+
+    std::string operator()(bool) const
+    {
+        return std::string();
+    }
+
+    std::string operator()(const std::string& str) const
+    {
+        return format(StringView(str));
+    }
+
+    std::string operator()(const std::vector<uint8_t>& buffer) const
+    {
+        return format(StringView(reinterpret_cast<const char*>(buffer.data()), buffer.size()));
+    }
+
+    std::string operator()(const ResponseCore::FileBody& file) const
+    {
+        if (!isJsonContentType(contentType_) && !isTextContentType(contentType_))
+            return std::string();
+
+        file_io::setPosition(file.handle.get(), 0);
+        return operator()(file_io::readToEnd(file.handle.get(), file.size));
+    }
+
+private:
+    std::string format(StringView data) const
+    {
+        if (data.empty())
+            return std::string();
+
+        // JSON bodies are produced by the server itself and embedded as is
+        if (isJsonContentType(contentType_))
+            return data.to_string();
+
+        if (isTextContentType(contentType_))
+            return jsonDumpSafe(Json(data.to_string()));
+
+        return std::string();
+    }
+
+    StringView contentType_;
+};
+
+}
+
+WebSocketRequestMessage::WebSocketRequestMessage(
+    std::shared_ptr<const BeastRequestMessage> upgradeMessage,
+    std::string target,
+    std::string body)
+    : upgradeMessage_(std::move(upgradeMessage)),
+      target_(std::move(target)),
+      body_(std::move(body))
+{
+    StringView targetView(target_);
+    auto pos = targetView.find('?');
+
+    if (pos != StringView::npos)
+    {
+        path_ = targetView.substr(0, pos);
+        queryString_ = targetView.substr(pos + 1);
+    }
+    else
+    {
+        path_ = targetView;
+    }
+}
+
+WebSocketRequestMessage::~WebSocketRequestMessage() = default;
+
+bool WebSocketRequestMessage::findHeader(StringView name, StringView* value) const
+{
+    // Frames are never compressed, response body is embedded into frame as is
+    if (asciiEqualsIgnoreCase(name, HttpHeader::ACCEPT_ENCODING))
+        return false;
+
+    return upgradeMessage_->findHeader(name, value);
+}
+
+void WebSocketRequestMessage::visitHeaders(const HttpHeaderVisitor& visitor) const
+{
+    upgradeMessage_->visitHeaders([&](StringView name, StringView value) {
+        if (!asciiEqualsIgnoreCase(name, HttpHeader::ACCEPT_ENCODING))
+            visitor(name, value);
+    });
+}
+
+BeastWebSocketRequest::BeastWebSocketRequest(
+    BeastWebSocketSession* session,
+    Json id,
+    HttpMethod method,
+    RequestMessagePtr message)
+    : session_(session),
+      id_(std::move(id)),
+      method_(method),
+      message_(std::move(message)),
+      pendingSize_(0)
+{
+}
+
+BeastWebSocketRequest::~BeastWebSocketRequest() = default;
+
+size_t BeastWebSocketRequest::shard()
+{
+    return session_->shard();
+}
+
+void BeastWebSocketRequest::abort()
+{
+    session_->abortRequest(this);
+}
+
+void BeastWebSocketRequest::sendResponse(ResponseCorePtr response)
+{
+    session_->sendResponse(this, std::move(response));
+}
+
+void BeastWebSocketRequest::sendResponseBegin(ResponseCorePtr response)
+{
+    session_->sendResponseBegin(this, std::move(response));
+}
+
+void BeastWebSocketRequest::sendResponseBody(ResponseCore::Body body)
+{
+    session_->sendEvent(this, std::move(body));
+}
+
+void BeastWebSocketRequest::sendResponseEnd()
+{
+    session_->endEventStream(this);
+}
+
+bool BeastWebSocketSession::isWebSocketRequest(const BeastHttpRequest& request)
+{
+    if (!beast::websocket::is_upgrade(request))
+        return false;
+
+    auto target = request.target();
+    return targetPath(StringView(target.data(), target.size())) == WEBSOCKET_PATH;
+}
+
+BeastWebSocketSession::BeastWebSocketSession(
+    BeastConnectionContext* context,
+    BeastSocket socket,
+    std::shared_ptr<BeastRequestMessage> upgradeMessage)
+    : context_(context),
+      stream_(std::move(socket)),
+      upgradeMessage_(std::move(upgradeMessage)),
+      writing_(false),
+      closed_(false)
+{
+    context_->connectionCount->fetch_add(1, std::memory_order_relaxed);
+}
+
+BeastWebSocketSession::~BeastWebSocketSession()
+{
+    context_->connectionCount->fetch_sub(1, std::memory_order_relaxed);
+}
+
+size_t BeastWebSocketSession::shard() const
+{
+    return context_->shard;
+}
+
+void BeastWebSocketSession::run()
+{
+    context_->activeWebSockets.emplace(shared_from_this());
+
+    if (!isAllowedOrigin(upgradeMessage_->request()))
+    {
+        rejectUpgrade(HttpStatus::S_403_FORBIDDEN);
+        return;
+    }
+
+    stream_.read_message_max(MAX_MESSAGE_SIZE);
+    stream_.text(true);
+
+    auto thisPtr = shared_from_this();
+
+    stream_.async_accept(
+        upgradeMessage_->request(),
+        [thisPtr](const boost::system::error_code& error) {
+            if (error)
+            {
+                logError("webSocketAccept: %s", error.message().c_str());
+                thisPtr->close();
+                return;
+            }
+
+            thisPtr->readFrame();
+        });
+}
+
+void BeastWebSocketSession::rejectUpgrade(HttpStatus status)
+{
+    auto response = std::make_shared<beast::http::response<beast::http::string_body>>(
+        static_cast<beast::http::status>(status), upgradeMessage_->request().version());
+
+    response->set(beast::http::field::content_type, ContentType::TEXT_PLAIN_UTF8);
+    response->body() = "cross-origin WebSocket connections are not allowed";
+    response->keep_alive(false);
+    response->prepare_payload();
+
+    auto thisPtr = shared_from_this();
+
+    beast::http::async_write(
+        stream_.next_layer(),
+        *response,
+        [thisPtr, response](const boost::system::error_code&, size_t) {
+            thisPtr->close();
+        });
+}
+
+void BeastWebSocketSession::readFrame()
+{
+    auto thisPtr = shared_from_this();
+
+    stream_.async_read(
+        readBuffer_,
+        [thisPtr](const boost::system::error_code& error, size_t) {
+            if (error)
+            {
+                if (error != beast::websocket::error::closed
+                    && error != asio::error::eof
+                    && error != asio::error::operation_aborted)
+                    logError("webSocketRead: %s", error.message().c_str());
+
+                thisPtr->close();
+                return;
+            }
+
+            thisPtr->handleFrame();
+            thisPtr->readFrame();
+        });
+}
+
+void BeastWebSocketSession::handleFrame()
+{
+    Json frame;
+
+    try
+    {
+        frame = Json::parse(beast::buffers_to_string(readBuffer_.data()));
+    }
+    catch (std::exception& ex)
+    {
+        readBuffer_.consume(readBuffer_.size());
+        sendError(Json(), HttpStatus::S_400_BAD_REQUEST, ex.what());
+        return;
+    }
+
+    readBuffer_.consume(readBuffer_.size());
+
+    if (!frame.is_object())
+    {
+        sendError(Json(), HttpStatus::S_400_BAD_REQUEST, "request frame should be an object");
+        return;
+    }
+
+    try
+    {
+        handleRequestFrame(frame);
+    }
+    catch (std::exception& ex)
+    {
+        auto id = frame.find("id");
+        sendError(id != frame.end() ? *id : Json(), HttpStatus::S_400_BAD_REQUEST, ex.what());
+    }
+}
+
+void BeastWebSocketSession::handleRequestFrame(const Json& frame)
+{
+    auto idIt = frame.find("id");
+    auto id = idIt != frame.end() ? *idIt : Json();
+    auto methodName = frame.value("method", std::string("GET"));
+
+    if (methodName == "CANCEL")
+    {
+        for (auto& pair : requests_)
+        {
+            if (pair.second->id() == id)
+            {
+                completeRequest(pair.first);
+                break;
+            }
+        }
+
+        return;
+    }
+
+    HttpMethod method;
+
+    if (methodName == "GET")
+        method = HttpMethod::GET;
+    else if (methodName == "POST")
+        method = HttpMethod::POST;
+    else
+    {
+        sendError(id, HttpStatus::S_405_METHOD_NOT_ALLOWED, "unsupported method: " + methodName);
+        return;
+    }
+
+    auto path = frame.at("path").get<std::string>();
+
+    std::string body;
+    auto bodyIt = frame.find("body");
+    if (bodyIt != frame.end() && !bodyIt->is_null())
+        body = bodyIt->dump();
+
+    auto message = std::make_shared<WebSocketRequestMessage>(
+        upgradeMessage_, std::move(path), std::move(body));
+
+    auto request = std::make_unique<BeastWebSocketRequest>(
+        this, std::move(id), method, std::move(message));
+
+    auto requestPtr = request.get();
+    requests_.emplace(requestPtr, std::move(request));
+
+    tryCatchLog([&] { context_->eventListener->onRequestReady(requestPtr); });
+}
+
+void BeastWebSocketSession::sendError(const Json& id, HttpStatus status, const std::string& message)
+{
+    Json frame = {
+        {"id", id},
+        {"status", static_cast<int>(status)},
+        {"body", {{"error", {{"message", message}}}}},
+    };
+
+    addFrame(jsonDumpSafe(frame), nullptr, false);
+}
+
+void BeastWebSocketSession::sendResponse(BeastWebSocketRequest* request, ResponseCorePtr response)
+{
+    StringView contentType;
+
+    auto contentTypeIt = response->headers.find(HttpHeader::CONTENT_TYPE);
+    if (contentTypeIt != response->headers.end())
+        contentType = contentTypeIt->second;
+
+    std::string body;
+
+    tryCatchLog([&] {
+        body = boost::apply_visitor(FrameBodyFormatter(contentType), response->body);
+    });
+
+    std::string frame = "{\"id\":";
+    frame.append(jsonDumpSafe(request->id()));
+    frame.append(",\"status\":");
+    frame.append(toString(static_cast<int>(response->status)));
+
+    if (!body.empty())
+    {
+        frame.append(",\"body\":");
+        frame.append(body);
+    }
+
+    frame.append("}");
+
+    addFrame(std::move(frame), request, true);
+}
+
+void BeastWebSocketSession::sendResponseBegin(BeastWebSocketRequest* request, ResponseCorePtr response)
+{
+    std::string frame = "{\"id\":";
+    frame.append(jsonDumpSafe(request->id()));
+    frame.append(",\"status\":");
+    frame.append(toString(static_cast<int>(response->status)));
+    frame.append("}");
+
+    addFrame(std::move(frame), request, false);
+    sendEvent(request, std::move(response->body));
+}
+
+void BeastWebSocketSession::sendEvent(BeastWebSocketRequest* request, ResponseCore::Body body)
+{
+    auto event = boost::get<std::string>(&body);
+
+    // Event stream data is formatted for SSE, pings are not needed for WebSocket
+    if (!event || event->compare(0, sizeof(EVENT_PREFIX) - 1, EVENT_PREFIX) != 0)
+    {
+        if (request->pendingSize_ == 0)
+        {
+            auto thisPtr = shared_from_this();
+
+            asio::post(stream_.get_executor(), [thisPtr, request] {
+                if (thisPtr->requests_.find(request) != thisPtr->requests_.end())
+                    thisPtr->notifyBodyDrained(request);
+            });
+        }
+
+        return;
+    }
+
+    auto payload = StringView(*event).substr(sizeof(EVENT_PREFIX) - 1);
+    StringView eventId;
+
+    auto eventIdPos = payload.find(EVENT_ID_PREFIX);
+    if (eventIdPos != StringView::npos)
+    {
+        eventId = trimWhitespace(payload.substr(eventIdPos + sizeof(EVENT_ID_PREFIX) - 1));
+        payload = payload.substr(0, eventIdPos);
+    }
+
+    payload = trimWhitespace(payload);
+
+    std::string frame = "{\"id\":";
+    frame.append(jsonDumpSafe(request->id()));
+    frame.append(",\"event\":");
+    frame.append(payload.data(), payload.size());
+
+    if (!eventId.empty())
+    {
+        frame.append(",\"eventId\":");
+        frame.append(jsonDumpSafe(Json(eventId.to_string())));
+    }
+
+    frame.append("}");
+
+    addFrame(std::move(frame), request, false);
+}
+
+void BeastWebSocketSession::endEventStream(BeastWebSocketRequest* request)
+{
+    std::string frame = "{\"id\":";
+    frame.append(jsonDumpSafe(request->id()));
+    frame.append(",\"end\":true}");
+
+    addFrame(std::move(frame), request, true);
+}
+
+void BeastWebSocketSession::abortRequest(BeastWebSocketRequest* request)
+{
+    completeRequest(request);
+}
+
+void BeastWebSocketSession::addFrame(
+    std::string data, BeastWebSocketRequest* request, bool completesRequest)
+{
+    if (closed_)
+        return;
+
+    if (request)
+        request->pendingSize_ += data.size();
+
+    frames_.push_back(Frame{std::move(data), request, completesRequest});
+    writeNextFrame();
+}
+
+void BeastWebSocketSession::writeNextFrame()
+{
+    if (writing_ || closed_ || frames_.empty())
+        return;
+
+    auto thisPtr = shared_from_this();
+
+    writing_ = true;
+    stream_.async_write(
+        asio::buffer(frames_.front().data),
+        [thisPtr](const boost::system::error_code& error, size_t) {
+            thisPtr->handleWriteFrame(error);
+        });
+}
+
+void BeastWebSocketSession::handleWriteFrame(const boost::system::error_code& error)
+{
+    writing_ = false;
+
+    if (closed_)
+        return;
+
+    if (error)
+    {
+        if (error != asio::error::operation_aborted)
+            logError("webSocketWrite: %s", error.message().c_str());
+
+        close();
+        return;
+    }
+
+    auto frame = std::move(frames_.front());
+    frames_.pop_front();
+
+    if (auto request = frame.request)
+    {
+        request->pendingSize_ -= frame.data.size();
+
+        if (frame.completesRequest)
+            completeRequest(request);
+        else if (request->pendingSize_ == 0)
+            notifyBodyDrained(request);
+    }
+
+    writeNextFrame();
+}
+
+void BeastWebSocketSession::notifyBodyDrained(BeastWebSocketRequest* request)
+{
+    tryCatchLog([&] { context_->eventListener->onRequestBodyDrained(request); });
+}
+
+void BeastWebSocketSession::completeRequest(BeastWebSocketRequest* request)
+{
+    auto it = requests_.find(request);
+    if (it == requests_.end())
+        return;
+
+    tryCatchLog([&] { context_->eventListener->onRequestDone(request); });
+
+    for (auto& frame : frames_)
+    {
+        if (frame.request == request)
+        {
+            frame.request = nullptr;
+            frame.completesRequest = false;
+        }
+    }
+
+    requests_.erase(it);
+}
+
+void BeastWebSocketSession::close()
+{
+    if (closed_)
+        return;
+
+    closed_ = true;
+
+    auto requests = std::move(requests_);
+    requests_.clear();
+
+    for (auto& pair : requests)
+        tryCatchLog([&] { context_->eventListener->onRequestDone(pair.first); });
+
+    if (!writing_)
+        frames_.clear();
+
+    boost::system::error_code error;
+    stream_.next_layer().close(error);
+
+    context_->activeWebSockets.erase(shared_from_this());
+}
+
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "beast.hpp"
+#include "json.hpp"
+#include "server_core.hpp"
+#include "beast_request.hpp"
+
+#include <deque>
+#include <unordered_map>
+
+namespace msrv {
+
+struct BeastConnectionContext;
+
+class BeastWebSocketSession;
+
+// Requests are sent by client as text frames:
+//   {"id": 1, "method": "POST", "path": "/api/player/volume", "body": {...}}
+//
+// Server replies with frames tagged with the same id:
+//   {"id": 1, "status": 200, "body": {...}}  - response status and JSON body (if any)
+//   {"id": 1, "event": {...}}                - event of event stream request (e.g. /api/query/updates)
+//   {"id": 1, "end": true}                   - event stream has ended
+//
+// Event streams last until the socket is closed or {"id": 1, "method": "CANCEL"} is sent.
+// All requests inherit headers of the upgrade request.
+
+class WebSocketRequestMessage final : public RequestMessage
+{
+public:
+    WebSocketRequestMessage(
+        std::shared_ptr<const BeastRequestMessage> upgradeMessage,
+        std::string target,
+        std::string body);
+
+    ~WebSocketRequestMessage();
+
+    virtual StringView path() const override
+    {
+        return path_;
+    }
+
+    virtual StringView queryString() const override
+    {
+        return queryString_;
+    }
+
+    virtual StringView body() const override
+    {
+        return StringView(body_);
+    }
+
+    virtual bool findHeader(StringView name, StringView* value) const override;
+    virtual void visitHeaders(const HttpHeaderVisitor& visitor) const override;
+
+private:
+    std::shared_ptr<const BeastRequestMessage> upgradeMessage_;
+    std::string target_;
+    std::string body_;
+    StringView path_;
+    StringView queryString_;
+};
+
+class BeastWebSocketRequest final : public RequestCore
+{
+public:
+    BeastWebSocketRequest(
+        BeastWebSocketSession* session,
+        Json id,
+        HttpMethod method,
+        RequestMessagePtr message);
+
+    ~BeastWebSocketRequest();
+
+    const Json& id() const
+    {
+        return id_;
+    }
+
+    virtual size_t shard() override;
+
+    virtual HttpMethod method() override
+    {
+        return method_;
+    }
+
+    virtual RequestMessagePtr message() override
+    {
+        return message_;
+    }
+
+    virtual void releaseResources() override
+    {
+    }
+
+    virtual RequestArena* arena() override
+    {
+        return nullptr;
+    }
+
+    virtual void abort() override;
+
+    virtual void sendResponse(ResponseCorePtr response) override;
+    virtual void sendResponseBegin(ResponseCorePtr response) override;
+    virtual void sendResponseBody(ResponseCore::Body body) override;
+    virtual void sendResponseEnd() override;
+
+    virtual size_t pendingBodySize() override
+    {
+        return pendingSize_;
+    }
+
+private:
+    friend class BeastWebSocketSession;
+
+    BeastWebSocketSession* session_;
+    Json id_;
+    HttpMethod method_;
+    RequestMessagePtr message_;
+    size_t pendingSize_;
+};
+
+class BeastWebSocketSession : public std::enable_shared_from_this<BeastWebSocketSession>
+{
+public:
+    static bool isWebSocketRequest(const BeastHttpRequest& request);
+
+    BeastWebSocketSession(
+        BeastConnectionContext* context,
+        BeastSocket socket,
+        std::shared_ptr<BeastRequestMessage> upgradeMessage);
+
+    ~BeastWebSocketSession();
+
+    size_t shard() const;
+
+    void run();
+
+    void sendResponse(BeastWebSocketRequest* request, ResponseCorePtr response);
+    void sendResponseBegin(BeastWebSocketRequest* request, ResponseCorePtr response);
+    void sendEvent(BeastWebSocketRequest* request, ResponseCore::Body body);
+    void endEventStream(BeastWebSocketRequest* request);
+    void abortRequest(BeastWebSocketRequest* request);
+    void close();
+
+private:
+    static constexpr size_t MAX_MESSAGE_SIZE = 1024 * 1024;
+
+    struct Frame
+    {
+        std::string data;
+        BeastWebSocketRequest* request;
+        bool completesRequest;
+    };
+
+    void rejectUpgrade(HttpStatus status);
+    void readFrame();
+    void handleFrame();
+    void handleRequestFrame(const Json& frame);
+    void sendError(const Json& id, HttpStatus status, const std::string& message);
+
+    void addFrame(std::string data, BeastWebSocketRequest* request, bool completesRequest);
+    void writeNextFrame();
+    void handleWriteFrame(const boost::system::error_code& error);
+
+    void notifyBodyDrained(BeastWebSocketRequest* request);
+    void completeRequest(BeastWebSocketRequest* request);
+
+    BeastConnectionContext* context_;
+    beast::websocket::stream<BeastSocket> stream_;
+    std::shared_ptr<BeastRequestMessage> upgradeMessage_;
+    beast::flat_buffer readBuffer_;
+
+    std::unordered_map<BeastWebSocketRequest*, std::unique_ptr<BeastWebSocketRequest>> requests_;
+    std::deque<Frame> frames_;
+    bool writing_;
+    bool closed_;
+
+    MSRV_NO_COPY_AND_ASSIGN(BeastWebSocketSession);
+};
+
+}
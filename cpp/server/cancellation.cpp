@@ -0,0 +1,57 @@
+#include "cancellation.hpp"
+#include "log.hpp"
+
+#include <assert.h>
+#include <algorithm>
+
+namespace msrv {
+
+CancellationToken::CancellationToken()
+    : cancelled_(false)
+{
+}
+
+CancellationToken::~CancellationToken()
+{
+    assert(callbacks_.empty());
+}
+
+void CancellationToken::cancel()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (cancelled_.exchange(true, std::memory_order_acq_rel))
+        return;
+
+    for (auto callback : callbacks_)
+        tryCatchLog([callback] { callback->function_(); });
+
+    callbacks_.clear();
+}
+
+CancellationCallback::CancellationCallback(CancellationTokenPtr token, std::function<void()> function)
+    : token_(std::move(token)), function_(std::move(function))
+{
+    if (!token_)
+        return;
+
+    std::lock_guard<std::mutex> lock(token_->mutex_);
+
+    if (token_->isCancelled())
+        tryCatchLog([this] { function_(); });
+    else
+        token_->callbacks_.push_back(this);
+}
+
+CancellationCallback::~CancellationCallback()
+{
+    if (!token_)
+        return;
+
+    std::lock_guard<std::mutex> lock(token_->mutex_);
+
+    auto& callbacks = token_->callbacks_;
+    callbacks.erase(std::remove(callbacks.begin(), callbacks.end(), this), callbacks.end());
+}
+
+}
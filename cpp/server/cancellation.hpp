@@ -0,0 +1,67 @@
+#pragma once
+
+#include "defines.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace msrv {
+
+class CancellationToken;
+
+class CancellationCallback;
+
+using CancellationTokenPtr = std::shared_ptr<CancellationToken>;
+
+// Signals that result of an operation is no longer needed (e.g. client has disconnected).
+// Could be checked and cancelled from any thread, null token is never cancelled.
+class CancellationToken
+{
+public:
+    CancellationToken();
+    ~CancellationToken();
+
+    static bool isCancelled(const CancellationToken* token)
+    {
+        return token && token->isCancelled();
+    }
+
+    bool isCancelled() const
+    {
+        return cancelled_.load(std::memory_order_acquire);
+    }
+
+    void cancel();
+
+private:
+    friend class CancellationCallback;
+
+    std::atomic_bool cancelled_;
+    std::mutex mutex_;
+    std::vector<CancellationCallback*> callbacks_;
+
+    MSRV_NO_COPY_AND_ASSIGN(CancellationToken);
+};
+
+// Calls function when token is cancelled while this object is alive,
+// or immediately if token is already cancelled.
+// Function is called with token lock held, it should be short and should not block.
+class CancellationCallback
+{
+public:
+    CancellationCallback(CancellationTokenPtr token, std::function<void()> function);
+    ~CancellationCallback();
+
+private:
+    friend class CancellationToken;
+
+    CancellationTokenPtr token_;
+    std::function<void()> function_;
+
+    MSRV_NO_COPY_AND_ASSIGN(CancellationCallback);
+};
+
+}
@@ -66,20 +66,21 @@ template<typename T>
 class DelegateRequestHandler : public RequestHandler
 {
 public:
+    // Action is owned by factory which outlives requests dispatched by its router
     DelegateRequestHandler(
-        std::unique_ptr<T> controller, ControllerAction<T> action)
-        : controller_(std::move(controller)), action_(std::move(action))
+        std::unique_ptr<T> controller, const ControllerAction<T>* action)
+        : controller_(std::move(controller)), action_(action)
     {
     }
 
     ResponsePtr execute() override
     {
-        return action_(controller_.get());
+        return (*action_)(controller_.get());
     }
 
 private:
     std::unique_ptr<T> controller_;
-    ControllerAction<T> action_;
+    const ControllerAction<T>* action_;
 };
 
 template<typename T>
@@ -87,8 +88,8 @@ class DelegateRequestHandlerFactory : public RequestHandlerFactory
 {
 public:
     DelegateRequestHandlerFactory(
-        ControllerFactory<T> factory, ControllerAction<T> action, WorkQueue* queue)
-        : factory_(std::move(factory)), action_(std::move(action)), workQueue_(queue)
+        ControllerFactory<T> factory, ControllerAction<T> action, WorkQueue* queue, WorkPriority priority)
+        : factory_(std::move(factory)), action_(std::move(action)), workQueue_(queue), priority_(priority)
     {
     }
 
@@ -97,16 +98,22 @@ public:
         return workQueue_;
     }
 
+    WorkPriority priority() override
+    {
+        return priority_;
+    }
+
     RequestHandlerPtr createHandler(Request* request) override
     {
-        return std::make_unique<DelegateRequestHandler<T>>(
-            std::unique_ptr<T>(factory_(request)), action_);
+        return arenaNew<DelegateRequestHandler<T>>(
+            request->arena, std::unique_ptr<T>(factory_(request)), &action_);
     }
 
 private:
     ControllerFactory<T> factory_;
     ControllerAction<T> action_;
     WorkQueue* workQueue_;
+    WorkPriority priority_;
 };
 
 }
@@ -6,8 +6,12 @@
 namespace msrv {
 namespace player_deadbeef {
 
-AddItemsScope::AddItemsScope(ddb_playlist_t* playlist, int visibility)
-    : playlist_(playlist), visibility_(visibility), created_(false), aborted_(0)
+AddItemsScope::AddItemsScope(ddb_playlist_t* playlist, int visibility, CancellationTokenPtr cancellation)
+    : playlist_(playlist),
+      visibility_(visibility),
+      created_(false),
+      aborted_(0),
+      abortOnCancel_(std::move(cancellation), [this] { aborted_ = 1; })
 {
     assert(playlist);
 
@@ -2,6 +2,7 @@
 
 #include "defines.hpp"
 #include "utils.hpp"
+#include "cancellation.hpp"
 
 namespace msrv {
 namespace player_deadbeef {
@@ -9,7 +10,7 @@ namespace player_deadbeef {
 class AddItemsScope
 {
 public:
-    AddItemsScope(ddb_playlist_t* playlist, int visibility);
+    AddItemsScope(ddb_playlist_t* playlist, int visibility, CancellationTokenPtr cancellation);
     ~AddItemsScope();
 
     void setLastItem(PlaylistItemPtr item)
@@ -31,6 +32,9 @@ private:
     int aborted_;
     PlaylistItemPtr lastItem_;
 
+    // Sets aborted_ flag which is polled by player while adding files
+    CancellationCallback abortOnCancel_;
+
     MSRV_NO_COPY_AND_ASSIGN(AddItemsScope);
 };
 
@@ -81,7 +81,8 @@ public:
         const PlaylistRef& playlist,
         const std::vector<std::string>& items,
         int32_t targetIndex,
-        AddItemsOptions options) override;
+        AddItemsOptions options,
+        CancellationTokenPtr cancellation) override;
 
     void copyPlaylistItems(
         const PlaylistRef& sourcePlaylist,
@@ -115,8 +116,9 @@ public:
     OutputsInfo getOutputs() override;
     void setOutputDevice(const std::string& typeId, const std::string& deviceId) override;
 
-    boost::unique_future<ArtworkResult> fetchCurrentArtwork() override;
-    boost::unique_future<ArtworkResult> fetchArtwork(const ArtworkQuery& query) override;
+    boost::unique_future<ArtworkResult> fetchCurrentArtwork(CancellationTokenPtr cancellation) override;
+    boost::unique_future<ArtworkResult> fetchArtwork(
+        const ArtworkQuery& query, CancellationTokenPtr cancellation) override;
 
     void connect();
     void disconnect();
@@ -126,6 +128,7 @@ private:
     using PlaylistItemSelector = DB_playItem_t* (*)(DB_playItem_t*, int);
 
     PlaybackState getPlaybackState(ddb_playItem_t* activeItem);
+    void refreshPlaybackPosition();
 
     void queryActiveItem(
         ActiveItemInfo* info,
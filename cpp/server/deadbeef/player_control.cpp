@@ -24,6 +24,17 @@ std::unique_ptr<PlayerState> PlayerImpl::queryPlayerState(ColumnsQuery* activeIt
     return state;
 }
 
+void PlayerImpl::refreshPlaybackPosition()
+{
+    // Only streamer state is read, playlist lock is not required
+    PlaylistItemPtr activeItem(ddbApi->streamer_get_playing_track());
+
+    updatePlaybackPosition(PlaybackPosition(
+        getPlaybackState(activeItem.get()),
+        activeItem ? ddbApi->streamer_get_playpos() : -1.0,
+        activeItem ? ddbApi->pl_get_item_duration(activeItem.get()) : -1.0));
+}
+
 void PlayerImpl::queryInfo(PlayerInfo* info)
 {
     info->name = MSRV_PLAYER_DEADBEEF;
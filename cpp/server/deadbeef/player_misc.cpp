@@ -79,6 +79,7 @@ void PlayerImpl::connect()
     }
 
     activeOutput_ = getActiveOutput();
+    refreshPlaybackPosition();
 
     artworkFetcher_ = ArtworkFetcher::createV2();
 
@@ -198,9 +199,10 @@ void PlayerImpl::clearPlayQueue()
     ddbApi->playqueue_clear();
 }
 
-boost::unique_future<ArtworkResult> PlayerImpl::fetchCurrentArtwork()
+boost::unique_future<ArtworkResult> PlayerImpl::fetchCurrentArtwork(CancellationTokenPtr cancellation)
 {
-    if (!artworkFetcher_)
+    // Artwork plugin can't cancel individual queries, skip query if client has already gone
+    if (!artworkFetcher_ || CancellationToken::isCancelled(cancellation.get()))
     {
         return boost::make_future(ArtworkResult());
     }
@@ -219,9 +221,10 @@ boost::unique_future<ArtworkResult> PlayerImpl::fetchCurrentArtwork()
     return artworkFetcher_->fetchArtwork(std::move(playlist), std::move(item));
 }
 
-boost::unique_future<ArtworkResult> PlayerImpl::fetchArtwork(const ArtworkQuery& query)
+boost::unique_future<ArtworkResult> PlayerImpl::fetchArtwork(
+    const ArtworkQuery& query, CancellationTokenPtr cancellation)
 {
-    if (!artworkFetcher_)
+    if (!artworkFetcher_ || CancellationToken::isCancelled(cancellation.get()))
     {
         return boost::make_future(ArtworkResult());
     }
@@ -330,6 +333,10 @@ void PlayerImpl::handleMessage(uint32_t id, uintptr_t, uint32_t p1, uint32_t)
     case DB_EV_SONGFINISHED:
     case DB_EV_PAUSED:
     case DB_EV_SEEKED:
+        refreshPlaybackPosition();
+        emitEvents(PlayerEvents::PLAYER_CHANGED);
+        break;
+
     case DB_EV_VOLUMECHANGED:
         emitEvents(PlayerEvents::PLAYER_CHANGED);
         break;
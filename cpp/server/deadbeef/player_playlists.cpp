@@ -12,7 +12,8 @@ public:
         const PlaylistRef& plref,
         const std::vector<std::string>& items,
         int32_t targetIndex,
-        AddItemsOptions options);
+        AddItemsOptions options,
+        CancellationTokenPtr cancellation);
 
     ~AddItemsTask();
 
@@ -31,6 +32,7 @@ private:
     std::vector<std::string> items_;
     int32_t targetIndex_;
     AddItemsOptions options_;
+    CancellationTokenPtr cancellation_;
     bool hasAddedItems_{false};
 
     MSRV_NO_COPY_AND_ASSIGN(AddItemsTask);
@@ -213,9 +215,11 @@ boost::unique_future<void> PlayerImpl::addPlaylistItems(
     const PlaylistRef& plref,
     const std::vector<std::string>& items,
     int32_t targetIndex,
-    AddItemsOptions options)
+    AddItemsOptions options,
+    CancellationTokenPtr cancellation)
 {
-    auto task = std::make_shared<AddItemsTask>(&playlists_, plref, items, targetIndex, options);
+    auto task = std::make_shared<AddItemsTask>(
+        &playlists_, plref, items, targetIndex, options, std::move(cancellation));
     return boost::async([task] { task->execute(); });
 }
 
@@ -316,12 +320,14 @@ AddItemsTask::AddItemsTask(
     const PlaylistRef& plref,
     const std::vector<std::string>& items,
     int32_t targetIndex,
-    AddItemsOptions options)
+    AddItemsOptions options,
+    CancellationTokenPtr cancellation)
     : playlists_(playlists),
       plref_(plref),
       items_(items),
       targetIndex_(targetIndex),
-      options_(options)
+      options_(options),
+      cancellation_(std::move(cancellation))
 {
 }
 
@@ -346,6 +352,10 @@ void AddItemsTask::initialize()
 
 void AddItemsTask::execute()
 {
+    // Task could wait for a thread while client has already gone
+    if (CancellationToken::isCancelled(cancellation_.get()))
+        throw InvalidRequestException("add operation aborted");
+
     initialize();
     addItems();
 
@@ -355,7 +365,7 @@ void AddItemsTask::execute()
 
 void AddItemsTask::addItems()
 {
-    AddItemsScope addScope(playlist_.get(), 47);
+    AddItemsScope addScope(playlist_.get(), 47, cancellation_);
 
     if (hasFlags(options_, AddItemsOptions::REPLACE))
         ddbApi->plt_clear(playlist_.get());
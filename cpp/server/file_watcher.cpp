@@ -0,0 +1,66 @@
+#include "file_watcher.hpp"
+#include "log.hpp"
+#include "project_info.hpp"
+#include "system.hpp"
+
+namespace msrv {
+
+FileWatcher::FileWatcher(Path path, FileChangedCallback callback, DurationMs period)
+    : path_(std::move(path)), callback_(std::move(callback)), period_(period)
+{
+    checkChanged();
+
+    thread_ = std::thread([this] {
+        setThreadName(MSRV_THREAD_NAME("watch"));
+        run();
+    });
+}
+
+FileWatcher::~FileWatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shutdown_ = true;
+        shutdownNotify_.notify_one();
+    }
+
+    thread_.join();
+}
+
+void FileWatcher::run()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            if (shutdownNotify_.wait_for(lock, period_, [this] { return shutdown_; }))
+                return;
+        }
+
+        if (checkChanged())
+        {
+            logInfo("file changed: %s", pathToUtf8(path_).c_str());
+            tryCatchLog([this] { callback_(); });
+        }
+    }
+}
+
+bool FileWatcher::checkChanged()
+{
+    auto info = file_io::tryQueryInfo(path_);
+
+    bool exists = info.has_value();
+    int64_t size = exists ? info->size : 0;
+    int64_t timestamp = exists ? info->timestamp : 0;
+
+    bool changed = exists != exists_ || size != size_ || timestamp != timestamp_;
+
+    exists_ = exists;
+    size_ = size;
+    timestamp_ = timestamp;
+
+    return changed;
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "defines.hpp"
+#include "chrono.hpp"
+#include "file_system.hpp"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace msrv {
+
+using FileChangedCallback = std::function<void()>;
+
+// Polls file size and modification time, callback is invoked on internal thread
+class FileWatcher
+{
+public:
+    FileWatcher(Path path, FileChangedCallback callback, DurationMs period = DurationMs(2000));
+    ~FileWatcher();
+
+    const Path& path() const
+    {
+        return path_;
+    }
+
+private:
+    void run();
+    bool checkChanged();
+
+    const Path path_;
+    const FileChangedCallback callback_;
+    const DurationMs period_;
+
+    bool exists_ = false;
+    int64_t size_ = 0;
+    int64_t timestamp_ = 0;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable shutdownNotify_;
+    bool shutdown_ = false;
+
+    MSRV_NO_COPY_AND_ASSIGN(FileWatcher);
+};
+
+}
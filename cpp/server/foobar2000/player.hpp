@@ -69,7 +69,8 @@ public:
         const PlaylistRef& playlist,
         const std::vector<std::string>& items,
         int32_t targetIndex,
-        AddItemsOptions options) override;
+        AddItemsOptions options,
+        CancellationTokenPtr cancellation) override;
 
     void copyPlaylistItems(
         const PlaylistRef& sourcePlaylist,
@@ -103,8 +104,9 @@ public:
     OutputsInfo getOutputs() override;
     void setOutputDevice(const std::string& typeId, const std::string& deviceId) override;
 
-    boost::unique_future<ArtworkResult> fetchCurrentArtwork() override;
-    boost::unique_future<ArtworkResult> fetchArtwork(const ArtworkQuery& query) override;
+    boost::unique_future<ArtworkResult> fetchCurrentArtwork(CancellationTokenPtr cancellation) override;
+    boost::unique_future<ArtworkResult> fetchArtwork(
+        const ArtworkQuery& query, CancellationTokenPtr cancellation) override;
 
 private:
     bool isValidItemIndex(t_size playlist, int32_t item)
@@ -114,6 +116,7 @@ private:
     }
 
     PlaybackState getPlaybackState();
+    void refreshPlaybackPosition();
     void queryInfo(PlayerInfo* info);
     void queryVolume(VolumeInfo* volume);
     void queryActiveItem(ActiveItemInfo* info, ColumnsQuery* query);
@@ -138,7 +141,8 @@ private:
 
     bool playNextBy(const std::string& expression, int increment);
 
-    boost::unique_future<ArtworkResult> fetchArtwork(const metadb_handle_ptr& itemHandle) const;
+    boost::unique_future<ArtworkResult> fetchArtwork(
+        const metadb_handle_ptr& itemHandle, CancellationTokenPtr cancellation) const;
 
     service_ptr_t<playback_control_v3> playbackControl_;
     service_ptr_t<playlist_manager_v4> playlistManager_;
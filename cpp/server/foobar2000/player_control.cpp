@@ -52,6 +52,14 @@ PlaybackState PlayerImpl::getPlaybackState()
     return PlaybackState::STOPPED;
 }
 
+void PlayerImpl::refreshPlaybackPosition()
+{
+    updatePlaybackPosition(PlaybackPosition(
+        getPlaybackState(),
+        playbackControl_->playback_get_position(),
+        playbackControl_->playback_get_length_ex()));
+}
+
 void PlayerImpl::queryInfo(PlayerInfo* info)
 {
     auto versionInfo = core_version_info_v2::get();
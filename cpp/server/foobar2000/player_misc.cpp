@@ -18,7 +18,9 @@ PlayerImpl::PlayerImpl()
     auto callback = [this](PlayerEvents ev) { emitEvents(ev); };
 
     playerEventAdapter_.setCallback(callback);
+    playerEventAdapter_.setPositionCallback([this] { refreshPlaybackPosition(); });
     playlistEventAdapter_.setCallback(callback);
+    playlistEventAdapter_.setItemsCallback([this](const PlaylistItemsChange& change) { emitPlaylistItemsChanged(change); });
     stopAfterCurrentTrackOption_.setCallback(callback);
     outputEventAdapter_.setCallback(callback);
     playQueueEventAdapterFactory.get_static_instance().setCallback(callback);
@@ -28,6 +30,8 @@ PlayerImpl::PlayerImpl()
     setPlaybackModeOption(&playbackOrderOption_);
     addOption(&playbackOrderOption_);
     addOption(&stopAfterCurrentTrackOption_);
+
+    refreshPlaybackPosition();
 }
 
 PlayerImpl::~PlayerImpl()
@@ -50,17 +54,18 @@ ColumnsQueryPtr PlayerImpl::createColumnsQuery(const std::vector<std::string>& c
     return std::make_unique<ColumnsQueryImpl>(compileColumns(columns));
 }
 
-boost::unique_future<ArtworkResult> PlayerImpl::fetchCurrentArtwork()
+boost::unique_future<ArtworkResult> PlayerImpl::fetchCurrentArtwork(CancellationTokenPtr cancellation)
 {
     metadb_handle_ptr itemHandle;
 
     if (playbackControl_->get_now_playing(itemHandle))
-        return fetchArtwork(itemHandle);
+        return fetchArtwork(itemHandle, std::move(cancellation));
 
     return boost::make_future(ArtworkResult());
 }
 
-boost::unique_future<ArtworkResult> PlayerImpl::fetchArtwork(const ArtworkQuery& query)
+boost::unique_future<ArtworkResult> PlayerImpl::fetchArtwork(
+    const ArtworkQuery& query, CancellationTokenPtr cancellation)
 {
     auto playlist = playlists_->getIndex(query.playlist);
 
@@ -69,7 +74,7 @@ boost::unique_future<ArtworkResult> PlayerImpl::fetchArtwork(const ArtworkQuery&
     if (!playlistManager_->playlist_get_item_handle(itemHandle, playlist, query.index))
         throw InvalidRequestException("playlist item index is out of range");
 
-    return fetchArtwork(itemHandle);
+    return fetchArtwork(itemHandle, std::move(cancellation));
 }
 
 std::vector<PlayQueueItemInfo> PlayerImpl::getPlayQueue(ColumnsQuery* query)
@@ -174,20 +179,22 @@ void PlayerImpl::setOutputDevice(const std::string& typeId, const std::string& d
     outputManager_->setCoreConfigDevice(deviceRef->first, deviceRef->second);
 }
 
-boost::unique_future<ArtworkResult> PlayerImpl::fetchArtwork(const metadb_handle_ptr& itemHandle) const
+boost::unique_future<ArtworkResult> PlayerImpl::fetchArtwork(
+    const metadb_handle_ptr& itemHandle, CancellationTokenPtr cancellation) const
 {
-    abort_callback_dummy dummyCallback;
+    abort_callback_impl abortCallback;
+    CancellationCallback abortOnCancel(std::move(cancellation), [&abortCallback] { abortCallback.abort(); });
 
     auto extractor = albumArtManager_->open(
         pfc::list_single_ref_t(itemHandle),
         pfc::list_single_ref_t(album_art_ids::cover_front),
-        dummyCallback);
+        abortCallback);
 
     if (extractor.is_empty())
         return boost::make_future<ArtworkResult>(ArtworkResult());
 
     service_ptr_t<album_art_data> artData;
-    if (!extractor->query(album_art_ids::cover_front, artData, dummyCallback))
+    if (!extractor->query(album_art_ids::cover_front, artData, abortCallback))
         return boost::make_future<ArtworkResult>(ArtworkResult());
 
     return boost::make_future<ArtworkResult>(ArtworkResult(artData->get_ptr(), artData->get_size()));
@@ -16,13 +16,15 @@ public:
         std::shared_ptr<PlaylistMappingImpl> playlists,
         const PlaylistRef& plref,
         int32_t index,
-        AddItemsOptions options)
+        AddItemsOptions options,
+        CancellationTokenPtr cancellation)
         : playlistManager_(playlistManager),
           playbackControl_(playbackControl),
           playlists_(playlists),
           plref_(plref),
           index_(index),
-          options_(options)
+          options_(options),
+          cancellation_(std::move(cancellation))
     {
     }
 
@@ -54,6 +56,10 @@ public:
 private:
     void complete(const pfc::list_base_const_t<metadb_handle_ptr>& items)
     {
+        // Locations are processed by player in background, only the result could be discarded
+        if (CancellationToken::isCancelled(cancellation_.get()))
+            throw InvalidRequestException("Operation aborted");
+
         auto playlist = playlists_->getIndex(plref_);
         auto hasAddedItems = items.get_count() > 0;
         t_size itemIndex;
@@ -92,6 +98,7 @@ private:
     PlaylistRef plref_;
     int32_t index_;
     AddItemsOptions options_;
+    CancellationTokenPtr cancellation_;
     boost::promise<void> result_;
 };
 
@@ -292,7 +299,8 @@ boost::unique_future<void> PlayerImpl::addPlaylistItems(
     const PlaylistRef& plref,
     const std::vector<std::string>& items,
     int32_t targetIndex,
-    AddItemsOptions options)
+    AddItemsOptions options,
+    CancellationTokenPtr cancellation)
 {
     pfc::list_t<const char*> itemsList;
 
@@ -303,7 +311,7 @@ boost::unique_future<void> PlayerImpl::addPlaylistItems(
 
     service_ptr_t<AsyncAddCompleter> completer(
         new service_impl_t<AsyncAddCompleter>(
-            playlistManager_, playbackControl_, playlists_, plref, targetIndex, options));
+            playlistManager_, playbackControl_, playlists_, plref, targetIndex, options, std::move(cancellation)));
 
     incomingItemFilter_->process_locations_async(
         itemsList,
@@ -74,7 +74,7 @@ void Fb2kLogger::log(LogLevel, const char* fmt, va_list va)
     console::printfv((prefix_ + fmt).c_str(), va);
 }
 
-void Fb2kWorkQueue::schedule(WorkCallback callback)
+void Fb2kWorkQueue::schedule(std::function<void()> callback)
 {
     fb2k::inMainThread(std::move(callback));
 }
@@ -33,7 +33,7 @@ private:
 class Fb2kWorkQueue : public ExternalWorkQueue
 {
 protected:
-    void schedule(WorkCallback callback) override;
+    void schedule(std::function<void()> callback) override;
 };
 
 class PlayerEventAdapter final : play_callback
@@ -41,7 +41,7 @@ class PlayerEventAdapter final : play_callback
 public:
     PlayerEventAdapter()
     {
-        constexpr auto flags = flag_on_playback_all & ~(flag_on_playback_dynamic_info | flag_on_playback_time) | flag_on_volume_change;
+        constexpr auto flags = flag_on_playback_all & ~flag_on_playback_dynamic_info | flag_on_volume_change;
         play_callback_manager::get()->register_callback(this, flags, false);
     }
 
@@ -55,29 +55,39 @@ public:
         callback_ = std::move(callback);
     }
 
+    void setPositionCallback(std::function<void()> callback)
+    {
+        positionCallback_ = std::move(callback);
+    }
+
 private:
     void on_playback_starting(play_control::t_track_command p_command, bool p_paused) override
     {
+        notifyPosition();
         notify();
     }
 
     void on_playback_new_track(metadb_handle_ptr p_track) override
     {
+        notifyPosition();
         notify();
     }
 
     void on_playback_stop(play_control::t_stop_reason p_reason) override
     {
+        notifyPosition();
         notify();
     }
 
     void on_playback_seek(double p_time) override
     {
+        notifyPosition();
         notify();
     }
 
     void on_playback_pause(bool p_state) override
     {
+        notifyPosition();
         notify();
     }
 
@@ -98,7 +108,8 @@ private:
 
     void on_playback_time(double p_time) override
     {
-        /* ignore */
+        // Corrects interpolated position, clients are not notified
+        notifyPosition();
     }
 
     void on_volume_change(float p_new_val) override
@@ -112,7 +123,14 @@ private:
             callback_(PlayerEvents::PLAYER_CHANGED);
     }
 
+    void notifyPosition()
+    {
+        if (positionCallback_)
+            positionCallback_();
+    }
+
     PlayerEventsCallback callback_;
+    std::function<void()> positionCallback_;
 
     MSRV_NO_COPY_AND_ASSIGN(PlayerEventAdapter);
 };
@@ -147,6 +165,11 @@ public:
         callback_ = std::move(callback);
     }
 
+    void setItemsCallback(PlaylistItemsChangeCallback callback)
+    {
+        itemsCallback_ = std::move(callback);
+    }
+
     void setPlaylistMapping(std::shared_ptr<PlaylistMappingImpl> playlists)
     {
         playlists_ = std::move(playlists);
@@ -164,7 +187,7 @@ private:
         const pfc::list_base_const_t<metadb_handle_ptr>& p_data,
         const bit_array& p_selection) override
     {
-        notifyPlaylistItems();
+        notifyItemsShifted(p_playlist, p_start);
     }
 
     void on_items_reordered(
@@ -172,7 +195,18 @@ private:
         const t_size* p_order,
         t_size p_count) override
     {
-        notifyPlaylistItems();
+        t_size first = 0;
+        while (first < p_count && p_order[first] == first)
+            first++;
+
+        if (first == p_count)
+            return;
+
+        t_size last = p_count - 1;
+        while (p_order[last] == last)
+            last--;
+
+        notifyItemsModified(p_playlist, first, last);
     }
 
     void on_items_removing(
@@ -190,7 +224,7 @@ private:
         t_size p_old_count,
         t_size p_new_count) override
     {
-        notifyPlaylistItems();
+        notifyItemsShifted(p_playlist, p_mask.find_first(true, 0, p_old_count));
     }
 
     void on_items_selection_change(
@@ -208,7 +242,7 @@ private:
 
     void on_items_modified(t_size p_playlist, const bit_array& p_mask) override
     {
-        notifyPlaylistItems();
+        notifyItemsModified(p_playlist, p_mask);
     }
 
     void on_items_modified_fromplayback(
@@ -224,7 +258,7 @@ private:
         const bit_array& p_mask,
         const pfc::list_base_const_t<t_on_items_replaced_entry>& p_data) override
     {
-        notifyPlaylistItems();
+        notifyItemsModified(p_playlist, p_mask);
     }
 
     void on_item_ensure_visible(t_size p_playlist, t_size p_idx) override
@@ -286,12 +320,53 @@ private:
             callback_(PlayerEvents::PLAYER_CHANGED);
     }
 
-    void notifyPlaylistItems() const
+    void notifyItemsShifted(t_size playlist, t_size firstIndex) const
     {
-        if (callback_)
+        auto change = makeItemsChange(playlist);
+        change.setItemsShifted(static_cast<int32_t>(firstIndex));
+        notifyPlaylistItems(change);
+    }
+
+    void notifyItemsModified(t_size playlist, t_size firstIndex, t_size lastIndex) const
+    {
+        auto change = makeItemsChange(playlist);
+        change.setItemsModified(static_cast<int32_t>(firstIndex), static_cast<int32_t>(lastIndex));
+        notifyPlaylistItems(change);
+    }
+
+    void notifyItemsModified(t_size playlist, const bit_array& mask) const
+    {
+        auto count = playlist_manager::get()->playlist_get_item_count(playlist);
+        auto first = mask.find_first(true, 0, count);
+
+        if (first >= count)
+            return;
+
+        auto last = first;
+        for (auto i = first + 1; i < count; i++)
         {
-            callback_(PlayerEvents::PLAYER_CHANGED | PlayerEvents::PLAYLIST_ITEMS_CHANGED | PlayerEvents::PLAY_QUEUE_CHANGED);
+            if (mask.get(i))
+                last = i;
         }
+
+        notifyItemsModified(playlist, first, last);
+    }
+
+    PlaylistItemsChange makeItemsChange(t_size playlist) const
+    {
+        auto index = static_cast<int32_t>(playlist);
+        return PlaylistItemsChange(index, playlists_ ? playlists_->getId(index) : std::string());
+    }
+
+    void notifyPlaylistItems(const PlaylistItemsChange& change) const
+    {
+        if (callback_)
+            callback_(PlayerEvents::PLAYER_CHANGED | PlayerEvents::PLAY_QUEUE_CHANGED);
+
+        if (itemsCallback_)
+            itemsCallback_(change);
+        else if (callback_)
+            callback_(PlayerEvents::PLAYLIST_ITEMS_CHANGED);
     }
 
     void notifyPlaylistsWithIndexes() const
@@ -317,6 +392,7 @@ private:
     }
 
     PlayerEventsCallback callback_;
+    PlaylistItemsChangeCallback itemsCallback_;
     std::shared_ptr<PlaylistMappingImpl> playlists_;
     bool creatingPlaylist_ = false;
 
@@ -24,6 +24,10 @@ const char HttpHeader::CONTENT_ENCODING[] = "Content-Encoding";
 
 const char HttpHeader::LOCATION[] = "Location";
 
+const char HttpHeader::RETRY_AFTER[] = "Retry-After";
+
+const char HttpHeader::LAST_EVENT_ID[] = "Last-Event-ID";
+
 const char ContentType::APPLICATION_OCTET_STREAM[] = "application/octet-stream";
 
 const char ContentType::APPLICATION_JSON[] = "application/json";
@@ -103,6 +107,9 @@ std::string toString(HttpStatus status)
     case HttpStatus::S_501_NOT_IMPLEMENTED:
         return "501 Not implemented";
 
+    case HttpStatus::S_503_SERVICE_UNAVAILABLE:
+        return "503 Service unavailable";
+
     default:
         return toString(static_cast<int>(status)) + "Status code";
     }
@@ -119,6 +126,15 @@ std::string urlDecode(StringView str)
     return output;
 }
 
+namespace {
+
+inline bool needsUrlDecode(StringView str)
+{
+    return str.find_first_of("%+") != StringView::npos;
+}
+
+}
+
 HttpKeyValueMap parseQueryString(StringView str)
 {
     HttpKeyValueMap map;
@@ -144,4 +160,44 @@ HttpKeyValueMap parseQueryString(StringView str)
     return map;
 }
 
+bool findQueryParam(StringView str, StringView key, StringView* value, std::string* buffer)
+{
+    if (!str.empty() && str.front() == '?')
+        str = str.substr(1);
+
+    qsiter_t iter;
+    qsiter_reset(&iter, str.data(), str.length());
+
+    while (qsiter_next(&iter))
+    {
+        StringView rawKey(iter.key, iter.keylen);
+
+        if (needsUrlDecode(rawKey))
+        {
+            if (!asciiEqualsIgnoreCase(urlDecode(rawKey), key))
+                continue;
+        }
+        else if (!asciiEqualsIgnoreCase(rawKey, key))
+        {
+            continue;
+        }
+
+        StringView rawValue(iter.val, iter.vallen);
+
+        if (needsUrlDecode(rawValue))
+        {
+            *buffer = urlDecode(rawValue);
+            *value = StringView(*buffer);
+        }
+        else
+        {
+            *value = rawValue;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
 }
@@ -3,6 +3,9 @@
 #include "defines.hpp"
 #include "string_utils.hpp"
 
+#include <functional>
+#include <memory>
+
 namespace msrv {
 
 using HttpKeyValueMap = AsciiLowerCaseMap<std::string>;
@@ -32,6 +35,7 @@ enum class HttpStatus
     S_405_METHOD_NOT_ALLOWED = 405,
     S_500_SERVER_ERROR = 500,
     S_501_NOT_IMPLEMENTED = 501,
+    S_503_SERVICE_UNAVAILABLE = 503,
 };
 
 struct HttpHeader
@@ -46,6 +50,8 @@ struct HttpHeader
     static const char ACCEPT_ENCODING[];
     static const char CONTENT_ENCODING[];
     static const char LOCATION[];
+    static const char RETRY_AFTER[];
+    static const char LAST_EVENT_ID[];
 };
 
 struct ContentType
@@ -77,4 +83,29 @@ std::string urlDecode(StringView str);
 
 HttpKeyValueMap parseQueryString(StringView str);
 
+// Looks up query string parameter without decoding the whole query string.
+// If decoding is not required value points into the query string, otherwise into the buffer.
+bool findQueryParam(StringView str, StringView key, StringView* value, std::string* buffer);
+
+using HttpHeaderVisitor = std::function<void(StringView name, StringView value)>;
+
+// Raw request data owned by the transport, values are decoded on demand
+class RequestMessage
+{
+public:
+    RequestMessage() = default;
+    virtual ~RequestMessage() = default;
+
+    virtual StringView path() const = 0;
+    virtual StringView queryString() const = 0;
+    virtual StringView body() const = 0;
+    virtual bool findHeader(StringView name, StringView* value) const = 0;
+    virtual void visitHeaders(const HttpHeaderVisitor& visitor) const = 0;
+
+private:
+    MSRV_NO_COPY_AND_ASSIGN(RequestMessage);
+};
+
+using RequestMessagePtr = std::shared_ptr<const RequestMessage>;
+
 }
@@ -0,0 +1,234 @@
+#include "metrics.hpp"
+#include "string_utils.hpp"
+
+#include <math.h>
+
+namespace msrv {
+
+namespace {
+
+constexpr int EXPORTED_MIN_OCTAVE = 2;
+constexpr int EXPORTED_MAX_OCTAVE = 25;
+
+const char* const PHASE_NAMES[] = {
+    "parse",
+    "route",
+    "queue",
+    "handler",
+    "filters",
+    "serialize",
+    "write",
+};
+
+static_assert(
+    sizeof(PHASE_NAMES) / sizeof(PHASE_NAMES[0]) == ServerMetrics::PHASE_COUNT,
+    "Phase names are out of sync with RequestPhase");
+
+int log2Floor(uint64_t value)
+{
+    int result = 0;
+
+    for (int shift = 32; shift > 0; shift /= 2)
+    {
+        if (value >> shift)
+        {
+            value >>= shift;
+            result += shift;
+        }
+    }
+
+    return result;
+}
+
+double toSeconds(uint64_t micros)
+{
+    return static_cast<double>(micros) / 1000000.0;
+}
+
+unsigned long long toULL(uint64_t value)
+{
+    return static_cast<unsigned long long>(value);
+}
+
+void formatGauge(std::string& output, const char* name, const char* help, const Gauge& gauge)
+{
+    output += formatString("# HELP %s %s\n", name, help);
+    output += formatString("# TYPE %s gauge\n", name);
+    output += formatString("%s %lld\n", name, static_cast<long long>(gauge.value()));
+}
+
+}
+
+size_t HistogramSnapshot::bucketIndex(uint64_t value)
+{
+    if (value < SUB_BUCKET_COUNT)
+        return static_cast<size_t>(value);
+
+    auto octave = log2Floor(value);
+
+    if (octave >= MAX_OCTAVE)
+        return BUCKET_COUNT - 1;
+
+    auto subBucket = (value >> (octave - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+    auto group = static_cast<size_t>(octave - SUB_BUCKET_BITS + 1);
+
+    return group * SUB_BUCKET_COUNT + static_cast<size_t>(subBucket);
+}
+
+uint64_t HistogramSnapshot::bucketLowerBound(size_t index)
+{
+    if (index < SUB_BUCKET_COUNT)
+        return index;
+
+    auto group = index / SUB_BUCKET_COUNT;
+    auto subBucket = index % SUB_BUCKET_COUNT;
+
+    return (SUB_BUCKET_COUNT + subBucket) << (group - 1);
+}
+
+uint64_t HistogramSnapshot::bucketUpperBound(size_t index)
+{
+    return index + 1 < BUCKET_COUNT
+        ? bucketLowerBound(index + 1)
+        : uint64_t(1) << MAX_OCTAVE;
+}
+
+uint64_t HistogramSnapshot::countBelow(uint64_t limit) const
+{
+    uint64_t result = 0;
+
+    for (size_t i = 0; i < BUCKET_COUNT && bucketUpperBound(i) <= limit; i++)
+        result += buckets[i];
+
+    return result;
+}
+
+uint64_t HistogramSnapshot::percentile(double value) const
+{
+    if (count == 0)
+        return 0;
+
+    auto rank = static_cast<uint64_t>(::ceil(static_cast<double>(count) * value / 100.0));
+
+    if (rank == 0)
+        rank = 1;
+
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < BUCKET_COUNT; i++)
+    {
+        seen += buckets[i];
+
+        if (seen >= rank)
+            return bucketUpperBound(i);
+    }
+
+    return bucketUpperBound(BUCKET_COUNT - 1);
+}
+
+Histogram::Histogram()
+    : sum_(0)
+{
+    for (auto& bucket : buckets_)
+        bucket.store(0, std::memory_order_relaxed);
+}
+
+Histogram::~Histogram() = default;
+
+HistogramSnapshot Histogram::snapshot() const
+{
+    HistogramSnapshot result;
+    result.count = 0;
+    result.sum = sum_.load(std::memory_order_relaxed);
+
+    for (size_t i = 0; i < HistogramSnapshot::BUCKET_COUNT; i++)
+    {
+        result.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        result.count += result.buckets[i];
+    }
+
+    return result;
+}
+
+ServerMetrics::ServerMetrics() = default;
+ServerMetrics::~ServerMetrics() = default;
+
+std::string ServerMetrics::format() const
+{
+    const char* phaseMetric = "beefweb_request_phase_seconds";
+
+    std::string output;
+    output += formatString("# HELP %s Time spent in request processing phases\n", phaseMetric);
+    output += formatString("# TYPE %s histogram\n", phaseMetric);
+
+    for (size_t i = 0; i < PHASE_COUNT; i++)
+    {
+        auto name = PHASE_NAMES[i];
+        auto snapshot = phases_[i].snapshot();
+
+        for (int octave = EXPORTED_MIN_OCTAVE; octave <= EXPORTED_MAX_OCTAVE; octave++)
+        {
+            auto limit = uint64_t(1) << octave;
+
+            output += formatString(
+                "%s_bucket{phase=\"%s\",le=\"%.6f\"} %llu\n",
+                phaseMetric, name, toSeconds(limit), toULL(snapshot.countBelow(limit)));
+        }
+
+        output += formatString(
+            "%s_bucket{phase=\"%s\",le=\"+Inf\"} %llu\n", phaseMetric, name, toULL(snapshot.count));
+        output += formatString(
+            "%s_sum{phase=\"%s\"} %.6f\n", phaseMetric, name, toSeconds(snapshot.sum));
+        output += formatString(
+            "%s_count{phase=\"%s\"} %llu\n", phaseMetric, name, toULL(snapshot.count));
+    }
+
+    formatGauge(
+        output, "beefweb_active_requests",
+        "Requests being processed, including event streams", activeRequests);
+
+    formatGauge(
+        output, "beefweb_event_streams",
+        "Active event streams", eventStreams);
+
+    formatGauge(
+        output, "beefweb_queued_work",
+        "Request handlers and event producers waiting in work queues", queuedWork);
+
+    formatGauge(
+        output, "beefweb_pending_body_bytes",
+        "Event stream data not yet written to clients", pendingBodySize);
+
+    formatGauge(
+        output, "beefweb_utility_threads",
+        "Threads serving file system and client config requests", utilityThreads);
+
+    const char* rejectedMetric = "beefweb_rejected_requests_total";
+
+    output += formatString("# HELP %s Requests rejected because server is overloaded\n", rejectedMetric);
+    output += formatString("# TYPE %s counter\n", rejectedMetric);
+    output += formatString("%s{limit=\"route\"} %llu\n", rejectedMetric, toULL(rejectedByRoute.value()));
+    output += formatString("%s{limit=\"queue\"} %llu\n", rejectedMetric, toULL(rejectedByQueue.value()));
+
+    const char* coalescedMetric = "beefweb_coalesced_requests_total";
+
+    output += formatString("# HELP %s Requests served with response of identical concurrent request\n", coalescedMetric);
+    output += formatString("# TYPE %s counter\n", coalescedMetric);
+    output += formatString("%s %llu\n", coalescedMetric, toULL(coalescedRequests.value()));
+
+    const char* sharedEventsMetric = "beefweb_shared_events_total";
+
+    output += formatString("# HELP %s Events sent without producing them for this event stream\n", sharedEventsMetric);
+    output += formatString("# TYPE %s counter\n", sharedEventsMetric);
+    output += formatString("%s %llu\n", sharedEventsMetric, toULL(sharedEvents.value()));
+
+    const char* cancelledMetric = "beefweb_cancelled_requests_total";
+
+    output += formatString("# HELP %s Queued requests skipped because client has disconnected\n", cancelledMetric);
+    output += formatString("# TYPE %s counter\n", cancelledMetric);
+    output += formatString("%s %llu\n", cancelledMetric, toULL(cancelledRequests.value()));
+
+    return output;
+}
+
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "defines.hpp"
+
+#include <stdint.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace msrv {
+
+class ServerMetrics;
+
+using MetricsClock = std::chrono::steady_clock;
+using ServerMetricsPtr = std::shared_ptr<ServerMetrics>;
+
+struct HistogramSnapshot
+{
+    static constexpr int SUB_BUCKET_BITS = 2;
+    static constexpr uint64_t SUB_BUCKET_COUNT = uint64_t(1) << SUB_BUCKET_BITS;
+
+    // Values of 2^MAX_OCTAVE and larger go to the last bucket
+    static constexpr int MAX_OCTAVE = 31;
+    static constexpr size_t BUCKET_COUNT = SUB_BUCKET_COUNT * (MAX_OCTAVE - SUB_BUCKET_BITS + 1);
+
+    static size_t bucketIndex(uint64_t value);
+    static uint64_t bucketLowerBound(size_t index);
+    static uint64_t bucketUpperBound(size_t index);
+
+    // Number of recorded values less than limit, exact for powers of two
+    uint64_t countBelow(uint64_t limit) const;
+
+    // Upper bound of the bucket containing specified percentile
+    uint64_t percentile(double value) const;
+
+    std::array<uint64_t, BUCKET_COUNT> buckets;
+    uint64_t count;
+    uint64_t sum;
+};
+
+// Log-linear histogram (HdrHistogram-like, 2 significant bits) of durations in microseconds.
+// Values are recorded without locks and could be recorded from any thread.
+class Histogram
+{
+public:
+    Histogram();
+    ~Histogram();
+
+    void record(uint64_t value)
+    {
+        buckets_[HistogramSnapshot::bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    template<typename Rep, typename Period>
+    void record(std::chrono::duration<Rep, Period> duration)
+    {
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        record(micros > 0 ? static_cast<uint64_t>(micros) : 0);
+    }
+
+    HistogramSnapshot snapshot() const;
+
+private:
+    std::array<std::atomic<uint64_t>, HistogramSnapshot::BUCKET_COUNT> buckets_;
+    std::atomic<uint64_t> sum_;
+
+    MSRV_NO_COPY_AND_ASSIGN(Histogram);
+};
+
+class Counter
+{
+public:
+    Counter()
+        : value_(0)
+    {
+    }
+
+    void increment()
+    {
+        value_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const
+    {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> value_;
+
+    MSRV_NO_COPY_AND_ASSIGN(Counter);
+};
+
+class Gauge
+{
+public:
+    Gauge()
+        : value_(0)
+    {
+    }
+
+    void add(int64_t delta)
+    {
+        value_.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    int64_t value() const
+    {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<int64_t> value_;
+
+    MSRV_NO_COPY_AND_ASSIGN(Gauge);
+};
+
+enum class RequestPhase
+{
+    PARSE,
+    ROUTE,
+    QUEUE,
+    HANDLER,
+    FILTERS,
+    SERIALIZE,
+    WRITE,
+};
+
+class ServerMetrics
+{
+public:
+    static constexpr size_t PHASE_COUNT = static_cast<size_t>(RequestPhase::WRITE) + 1;
+
+    ServerMetrics();
+    ~ServerMetrics();
+
+    Histogram& phase(RequestPhase phase)
+    {
+        return phases_[static_cast<size_t>(phase)];
+    }
+
+    const Histogram& phase(RequestPhase phase) const
+    {
+        return phases_[static_cast<size_t>(phase)];
+    }
+
+    // Requests being processed, including event streams
+    Gauge activeRequests;
+
+    Gauge eventStreams;
+
+    // Request handlers and event producers waiting in work queues
+    Gauge queuedWork;
+
+    // Event stream data not yet written to clients
+    Gauge pendingBodySize;
+
+    // Threads of elastic pool serving file system and client config requests
+    Gauge utilityThreads;
+
+    // Requests rejected because of route admission limit or work queue capacity
+    Counter rejectedByRoute;
+    Counter rejectedByQueue;
+
+    // Requests which received response of identical concurrent request
+    Counter coalescedRequests;
+
+    // Events sent to event stream, which were produced for identical event stream
+    Counter sharedEvents;
+
+    // Requests whose handlers were skipped because client has disconnected while waiting in queue
+    Counter cancelledRequests;
+
+    // Prometheus text exposition format (version 0.0.4)
+    std::string format() const;
+
+private:
+    std::array<Histogram, PHASE_COUNT> phases_;
+
+    MSRV_NO_COPY_AND_ASSIGN(ServerMetrics);
+};
+
+}
@@ -0,0 +1,29 @@
+#include "metrics_controller.hpp"
+#include "router.hpp"
+
+namespace msrv {
+
+MetricsController::MetricsController(Request* request, ServerMetrics* metrics)
+    : ControllerBase(request), metrics_(metrics)
+{
+}
+
+ResponsePtr MetricsController::getMetrics()
+{
+    auto text = metrics_->format();
+    return Response::data(std::vector<uint8_t>(text.begin(), text.end()), ContentType::TEXT_PLAIN_UTF8);
+}
+
+void MetricsController::defineRoutes(Router* router, ServerMetricsPtr metrics)
+{
+    auto routes = router->defineRoutes<MetricsController>();
+
+    // Metrics are only read here, keep the route available when work queues are saturated
+    routes.createWith([=](Request* r) { return new MetricsController(r, metrics.get()); });
+    routes.useIoThread();
+    routes.setPrefix("api/metrics");
+
+    routes.get("", &MetricsController::getMetrics);
+}
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "controller.hpp"
+#include "metrics.hpp"
+
+namespace msrv {
+
+class Router;
+
+class MetricsController : public ControllerBase
+{
+public:
+    MetricsController(Request* request, ServerMetrics* metrics);
+
+    ResponsePtr getMetrics();
+
+    static void defineRoutes(Router* router, ServerMetricsPtr metrics);
+
+private:
+    ServerMetrics* metrics_;
+
+    MSRV_NO_COPY_AND_ASSIGN(MetricsController);
+};
+
+}
@@ -0,0 +1,75 @@
+#include "playback_position.hpp"
+
+#include <thread>
+
+namespace msrv {
+
+PlaybackPositionSnapshot::PlaybackPositionSnapshot()
+    : sequence_(0),
+      playbackState_(static_cast<int>(PlaybackState::STOPPED)),
+      position_(0.0),
+      duration_(0.0),
+      updatedAt_(0)
+{
+}
+
+PlaybackPositionSnapshot::~PlaybackPositionSnapshot() = default;
+
+void PlaybackPositionSnapshot::update(const PlaybackPosition& value, TimePointMs time)
+{
+    std::lock_guard<std::mutex> lock(updateMutex_);
+
+    auto sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    playbackState_.store(static_cast<int>(value.playbackState), std::memory_order_relaxed);
+    position_.store(value.position, std::memory_order_relaxed);
+    duration_.store(value.duration, std::memory_order_relaxed);
+    updatedAt_.store(time.time_since_epoch().count(), std::memory_order_relaxed);
+
+    sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+PlaybackPosition PlaybackPositionSnapshot::read(TimePointMs time) const
+{
+    PlaybackPosition value;
+    int64_t updatedAt;
+
+    while (true)
+    {
+        auto sequence = sequence_.load(std::memory_order_acquire);
+
+        if (sequence & 1)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        value.playbackState = static_cast<PlaybackState>(playbackState_.load(std::memory_order_relaxed));
+        value.position = position_.load(std::memory_order_relaxed);
+        value.duration = duration_.load(std::memory_order_relaxed);
+        updatedAt = updatedAt_.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (sequence_.load(std::memory_order_relaxed) == sequence)
+            break;
+    }
+
+    if (value.playbackState != PlaybackState::PLAYING)
+        return value;
+
+    auto elapsed = time.time_since_epoch().count() - updatedAt;
+
+    if (elapsed > 0)
+        value.position += static_cast<double>(elapsed) / 1000.0;
+
+    // Duration is unknown for some tracks (e.g. streams)
+    if (value.duration > 0.0 && value.position > value.duration)
+        value.position = value.duration;
+
+    return value;
+}
+
+}
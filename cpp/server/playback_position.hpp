@@ -0,0 +1,63 @@
+#pragma once
+
+#include "defines.hpp"
+#include "chrono.hpp"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+
+namespace msrv {
+
+enum class PlaybackState
+{
+    STOPPED,
+    PLAYING,
+    PAUSED,
+};
+
+struct PlaybackPosition
+{
+    PlaybackPosition()
+        : playbackState(PlaybackState::STOPPED), position(0.0), duration(0.0)
+    {
+    }
+
+    PlaybackPosition(PlaybackState playbackStateVal, double positionVal, double durationVal)
+        : playbackState(playbackStateVal), position(positionVal), duration(durationVal)
+    {
+    }
+
+    PlaybackState playbackState;
+    double position;
+    double duration;
+};
+
+// Last known playback position protected by sequence lock.
+// Player updates it on seek, pause and track change, readers never block
+// and interpolate position of playing track up to the current time.
+class PlaybackPositionSnapshot
+{
+public:
+    PlaybackPositionSnapshot();
+    ~PlaybackPositionSnapshot();
+
+    void update(const PlaybackPosition& value, TimePointMs time);
+    PlaybackPosition read(TimePointMs time) const;
+
+private:
+    std::mutex updateMutex_;
+
+    // Odd value means update is in progress
+    std::atomic<uint32_t> sequence_;
+
+    std::atomic<int> playbackState_;
+    std::atomic<double> position_;
+    std::atomic<double> duration_;
+    std::atomic<int64_t> updatedAt_;
+
+    MSRV_NO_COPY_AND_ASSIGN(PlaybackPositionSnapshot);
+};
+
+}
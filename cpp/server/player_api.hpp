@@ -2,11 +2,14 @@
 
 #include "defines.hpp"
 #include "core_types.hpp"
+#include "cancellation.hpp"
+#include "playback_position.hpp"
 
 #include <vector>
 #include <string>
 #include <memory>
 #include <functional>
+#include <limits>
 
 #include <boost/thread/future.hpp>
 
@@ -22,13 +25,6 @@ class BoolPlayerOption;
 
 class EnumPlayerOption;
 
-enum class PlaybackState
-{
-    STOPPED,
-    PLAYING,
-    PAUSED,
-};
-
 enum class PlayerEvents : int
 {
     NONE = 0,
@@ -231,6 +227,40 @@ private:
     std::string id_;
 };
 
+// Describes PLAYLIST_ITEMS_CHANGED event of a single playlist.
+// Events emitted without description are assumed to change items of all playlists.
+struct PlaylistItemsChange
+{
+    PlaylistItemsChange(int32_t playlistIndexVal, std::string playlistIdVal)
+        : playlistIndex(playlistIndexVal),
+          playlistId(std::move(playlistIdVal)),
+          items(0, std::numeric_limits<int32_t>::max()),
+          countChanged(true)
+    {
+    }
+
+    // Items after the first added or removed one are shifted, so they are changed too
+    void setItemsShifted(int32_t firstIndex)
+    {
+        items = Range(firstIndex, std::numeric_limits<int32_t>::max() - firstIndex);
+        countChanged = true;
+    }
+
+    void setItemsModified(int32_t firstIndex, int32_t lastIndex)
+    {
+        items = Range(firstIndex, lastIndex - firstIndex + 1);
+        countChanged = false;
+    }
+
+    // Returns true if result of getPlaylistItems(playlist, range) could be changed
+    bool affects(const PlaylistRef& playlist, const Range& range) const;
+
+    int32_t playlistIndex;
+    std::string playlistId;
+    Range items;
+    bool countChanged;
+};
+
 class ColumnsQuery
 {
 public:
@@ -441,6 +471,7 @@ struct OutputsInfo
 using PlayerStatePtr = std::unique_ptr<PlayerState>;
 using ColumnsQueryPtr = std::unique_ptr<ColumnsQuery>;
 using PlayerEventsCallback = std::function<void(PlayerEvents)>;
+using PlaylistItemsChangeCallback = std::function<void(const PlaylistItemsChange&)>;
 
 class Player
 {
@@ -513,11 +544,13 @@ public:
     virtual void setCurrentPlaylist(const PlaylistRef& playlist) = 0;
     virtual void setPlaylistTitle(const PlaylistRef& playlist, const std::string& title) = 0;
 
+    // Adding stops when cancellation token (if any) is cancelled
     virtual boost::unique_future<void> addPlaylistItems(
         const PlaylistRef& playlist,
         const std::vector<std::string>& items,
         int32_t targetIndex,
-        AddItemsOptions options) = 0;
+        AddItemsOptions options,
+        CancellationTokenPtr cancellation) = 0;
 
     virtual void copyPlaylistItems(
         const PlaylistRef& sourcePlaylist,
@@ -565,8 +598,10 @@ public:
 
     // Artwork API
 
-    virtual boost::unique_future<ArtworkResult> fetchCurrentArtwork() = 0;
-    virtual boost::unique_future<ArtworkResult> fetchArtwork(const ArtworkQuery& query) = 0;
+    // Cancelled requests are skipped or aborted if player supports that
+    virtual boost::unique_future<ArtworkResult> fetchCurrentArtwork(CancellationTokenPtr cancellation) = 0;
+    virtual boost::unique_future<ArtworkResult> fetchArtwork(
+        const ArtworkQuery& query, CancellationTokenPtr cancellation) = 0;
 
     // Events API
 
@@ -575,6 +610,18 @@ public:
         eventsCallback_ = std::move(callback);
     }
 
+    // Players which know changed playlist report PLAYLIST_ITEMS_CHANGED with this callback
+    void onPlaylistItemsChanged(PlaylistItemsChangeCallback callback)
+    {
+        playlistItemsCallback_ = std::move(callback);
+    }
+
+    // Could be called on any thread, player locks are not taken
+    PlaybackPosition playbackPosition() const
+    {
+        return playbackPosition_.read(steadyTime());
+    }
+
 protected:
     void addOption(PlayerOption* option)
     {
@@ -600,8 +647,22 @@ protected:
             eventsCallback_(events);
     }
 
+    void emitPlaylistItemsChanged(const PlaylistItemsChange& change)
+    {
+        if (playlistItemsCallback_)
+            playlistItemsCallback_(change);
+    }
+
+    // Should be called on seek, pause and track change, position is interpolated in between
+    void updatePlaybackPosition(const PlaybackPosition& position)
+    {
+        playbackPosition_.update(position, steadyTime());
+    }
+
 private:
     PlayerEventsCallback eventsCallback_;
+    PlaylistItemsChangeCallback playlistItemsCallback_;
+    PlaybackPositionSnapshot playbackPosition_;
     std::vector<PlayerOption*> options_;
     EnumPlayerOption* playbackModeOption_ = nullptr;
 
@@ -116,6 +116,13 @@ void to_json(Json& json, const ActiveItemInfo& value)
     json["columns"] = value.columns;
 }
 
+void to_json(Json& json, const PlaybackPosition& value)
+{
+    json["playbackState"] = value.playbackState;
+    json["position"] = value.position;
+    json["duration"] = value.duration;
+}
+
 void to_json(Json& json, const PlayerState& value)
 {
     json["info"] = value.info;
@@ -12,6 +12,7 @@ void to_json(Json& json, const PlaybackState& value);
 void to_json(Json& json, const PlayerInfo& value);
 void to_json(Json& json, const VolumeInfo& value);
 void to_json(Json& json, const ActiveItemInfo& value);
+void to_json(Json& json, const PlaybackPosition& value);
 void to_json(Json& json, const PlayerState& value);
 void to_json(Json& json, const PlaylistInfo& value);
 void to_json(Json& json, const PlaylistItemInfo& value);
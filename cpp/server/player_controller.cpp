@@ -8,6 +8,14 @@
 
 namespace msrv {
 
+namespace {
+
+constexpr DurationMs DEFAULT_POSITION_PERIOD(1000);
+constexpr DurationMs MIN_POSITION_PERIOD(100);
+constexpr DurationMs MAX_POSITION_PERIOD(60000);
+
+}
+
 struct SetOptionRequest
 {
     std::string id;
@@ -40,6 +48,23 @@ ResponsePtr PlayerController::getState()
     return Response::json({{"player", stateJson}});
 }
 
+ResponsePtr PlayerController::getPosition()
+{
+    auto period = DurationMs(optionalParam<int32_t>("period", DEFAULT_POSITION_PERIOD.count()));
+
+    if (period < MIN_POSITION_PERIOD || period > MAX_POSITION_PERIOD)
+    {
+        throw InvalidRequestException(
+            "period should be between " + toString(MIN_POSITION_PERIOD.count())
+            + " and " + toString(MAX_POSITION_PERIOD.count()) + " ms");
+    }
+
+    auto player = player_;
+    auto response = Response::eventStream([player] { return Json(player->playbackPosition()); });
+    response->period = period;
+    return response;
+}
+
 void PlayerController::setState()
 {
     if (auto volume = optionalParam<double>("volume"))
@@ -177,6 +202,10 @@ void PlayerController::defineRoutes(
     routes.post("pause/toggle", &PlayerController::togglePause);
     routes.post("volume/up", &PlayerController::volumeUp);
     routes.post("volume/down", &PlayerController::volumeDown);
+
+    // Position is read from a snapshot without player locks, the stream is served on I/O thread
+    routes.useIoThread();
+    routes.get("position", &PlayerController::getPosition);
 }
 
 }
@@ -19,6 +19,7 @@ public:
 
     ResponsePtr getState();
     void setState();
+    ResponsePtr getPosition();
 
     void playItem();
     void playCurrent();
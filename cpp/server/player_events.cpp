@@ -1,9 +1,62 @@
 #include "player_events.hpp"
 
+#include "parsing.hpp"
+
 #include <assert.h>
 
+#include <random>
+
 namespace msrv {
 
+namespace {
+
+constexpr char EVENT_ID_SEPARATOR = '-';
+
+uint64_t createSession()
+{
+    std::random_device device;
+    std::uniform_int_distribution<uint64_t> distribution;
+    return distribution(device);
+}
+
+}
+
+bool PlaylistItemsChange::affects(const PlaylistRef& playlist, const Range& range) const
+{
+    switch (playlist.type())
+    {
+    case PlaylistRefType::INDEX:
+        if (playlist.index() != playlistIndex)
+            return false;
+        break;
+
+    case PlaylistRefType::ID:
+        // Current playlist could be changed at any time
+        if (!playlist.isCurrent() && playlist.id() != playlistId)
+            return false;
+        break;
+
+    default:
+        break;
+    }
+
+    // Total item count is reported too
+    if (countChanged)
+        return true;
+
+    auto itemsEnd = static_cast<int64_t>(items.offset) + items.count;
+    auto rangeEnd = static_cast<int64_t>(range.offset) + range.count;
+
+    return items.offset < rangeEnd && range.offset < itemsEnd;
+}
+
+EventDispatcher::EventDispatcher()
+    : session_(createSession()),
+      sequence_(0),
+      changes_(MAX_TRACKED_CHANGES)
+{
+}
+
 std::unique_ptr<EventListener> EventDispatcher::createListener(PlayerEvents eventMask)
 {
     std::unique_ptr<EventListener> listener(new EventListener(eventMask));
@@ -18,22 +71,44 @@ std::unique_ptr<EventListener> EventDispatcher::createListener(PlayerEvents even
 }
 
 void EventDispatcher::dispatch(PlayerEvents events)
+{
+    recordChange(events, nullptr);
+}
+
+void EventDispatcher::dispatch(const PlaylistItemsChange& change)
+{
+    recordChange(PlayerEvents::PLAYLIST_ITEMS_CHANGED, &change);
+}
+
+void EventDispatcher::recordChange(PlayerEvents events, const PlaylistItemsChange* itemsChange)
 {
     std::lock_guard<std::mutex> lock(mutex_);
 
+    sequence_++;
+
+    auto& record = changes_[sequence_ % changes_.size()];
+    record.events = events;
+
+    if (itemsChange)
+        record.itemsChange = *itemsChange;
+    else
+        record.itemsChange.reset();
+
     for (auto listener : listeners_)
     {
-        auto maskedEvents = listener->eventMask_ & events;
+        auto matchedEvents = listener->matchChange(events, itemsChange);
 
-        if (maskedEvents != PlayerEvents::NONE)
-        {
-            listener->pendingEvents_.fetch_or(static_cast<int>(maskedEvents));
-        }
+        if (matchedEvents != PlayerEvents::NONE)
+            listener->pendingEvents_.fetch_or(static_cast<int>(matchedEvents));
     }
 }
 
 EventListener::EventListener(PlayerEvents eventMask)
-    : owner_(nullptr), eventMask_(eventMask), pendingEvents_(static_cast<int>(eventMask))
+    : owner_(nullptr),
+      eventMask_(eventMask),
+      pendingEvents_(static_cast<int>(eventMask)),
+      watchingPlaylistItems_(false),
+      lastSequence_(0)
 {
 }
 
@@ -49,9 +124,83 @@ EventListener::~EventListener()
     owner_->listeners_.erase(it);
 }
 
+void EventListener::watchPlaylistItems(const PlaylistRef& playlist, const Range& range)
+{
+    assert(owner_);
+
+    std::lock_guard<std::mutex> lock(owner_->mutex_);
+
+    watchingPlaylistItems_ = true;
+    watchedPlaylist_ = playlist;
+    watchedRange_ = range;
+}
+
+bool EventListener::resumeAfter(uint64_t sequence)
+{
+    assert(owner_);
+
+    std::lock_guard<std::mutex> lock(owner_->mutex_);
+
+    if (sequence > owner_->sequence_ || owner_->sequence_ - sequence > owner_->changes_.size())
+        return false;
+
+    auto events = PlayerEvents::NONE;
+
+    for (auto i = sequence + 1; i <= owner_->sequence_; i++)
+    {
+        auto& record = owner_->changes_[i % owner_->changes_.size()];
+        events |= matchChange(record.events, record.itemsChange.get_ptr());
+    }
+
+    pendingEvents_.store(static_cast<int>(events));
+    return true;
+}
+
+std::string EventListener::lastEventId() const
+{
+    assert(owner_);
+
+    auto id = toString(owner_->session_);
+    id += EVENT_ID_SEPARATOR;
+    id += toString(lastSequence_);
+    return id;
+}
+
+bool EventListener::resumeAfter(StringView eventId)
+{
+    assert(owner_);
+
+    auto pos = eventId.find(EVENT_ID_SEPARATOR);
+    if (pos == StringView::npos)
+        return false;
+
+    uint64_t session;
+    uint64_t sequence;
+
+    if (!tryParseValue(eventId.substr(0, pos), &session)
+        || !tryParseValue(eventId.substr(pos + 1), &sequence))
+        return false;
+
+    return session == owner_->session_ && resumeAfter(sequence);
+}
+
 PlayerEvents EventListener::readEvents()
 {
+    assert(owner_);
+
+    // Sequence number should not run ahead of events read
+    std::lock_guard<std::mutex> lock(owner_->mutex_);
+
+    lastSequence_ = owner_->sequence_;
     return static_cast<PlayerEvents>(pendingEvents_.exchange(0));
 }
 
+PlayerEvents EventListener::matchChange(PlayerEvents events, const PlaylistItemsChange* itemsChange) const
+{
+    if (itemsChange && watchingPlaylistItems_ && !itemsChange->affects(watchedPlaylist_, watchedRange_))
+        return PlayerEvents::NONE;
+
+    return eventMask_ & events;
+}
+
 }
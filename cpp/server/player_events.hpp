@@ -2,12 +2,16 @@
 
 #include "defines.hpp"
 #include "player_api.hpp"
+#include "string_utils.hpp"
 
 #include <atomic>
 #include <unordered_set>
 #include <bitset>
 #include <mutex>
 #include <memory>
+#include <vector>
+
+#include <boost/optional.hpp>
 
 namespace msrv {
 
@@ -16,17 +20,38 @@ class EventListener;
 class EventDispatcher
 {
 public:
-    EventDispatcher() = default;
+    // Number of recent changes kept for resuming event streams
+    static constexpr size_t MAX_TRACKED_CHANGES = 1024;
+
+    EventDispatcher();
 
     std::unique_ptr<EventListener> createListener(PlayerEvents eventMask);
     void dispatch(PlayerEvents events);
 
+    // Notifies only listeners watching affected playlist items
+    void dispatch(const PlaylistItemsChange& change);
+
 private:
     friend class EventListener;
 
+    struct ChangeRecord
+    {
+        PlayerEvents events = PlayerEvents::NONE;
+        boost::optional<PlaylistItemsChange> itemsChange;
+    };
+
+    void recordChange(PlayerEvents events, const PlaylistItemsChange* itemsChange);
+
     std::mutex mutex_;
     std::unordered_set<EventListener*> listeners_;
 
+    // Random for each dispatcher, so that event ids issued before player restart are never resumed
+    const uint64_t session_;
+
+    // Each change gets the next sequence number, recent changes are kept in ring buffer
+    uint64_t sequence_;
+    std::vector<ChangeRecord> changes_;
+
     MSRV_NO_COPY_AND_ASSIGN(EventDispatcher);
 };
 
@@ -36,15 +61,45 @@ public:
     ~EventListener();
     PlayerEvents readEvents();
 
+    // Sequence number of the last change accounted by readEvents()
+    uint64_t lastSequence() const
+    {
+        return lastSequence_;
+    }
+
+    // Identifies last change accounted by readEvents() among changes of all dispatcher instances
+    std::string lastEventId() const;
+
+    // Initial events are replaced with changes made after specified one.
+    // Returns false if these changes are no longer tracked.
+    bool resumeAfter(uint64_t sequence);
+
+    // Same as above, but accepts id returned by lastEventId(), possibly of another dispatcher
+    bool resumeAfter(StringView eventId);
+
+    // PLAYLIST_ITEMS_CHANGED is reported only if changes affect specified items.
+    // Without this filter changes of any playlist are reported.
+    void watchPlaylistItems(const PlaylistRef& playlist, const Range& range);
+
 private:
     friend class EventDispatcher;
 
     explicit EventListener(PlayerEvents eventMask);
 
+    PlayerEvents matchChange(PlayerEvents events, const PlaylistItemsChange* itemsChange) const;
+
     EventDispatcher* owner_;
     const PlayerEvents eventMask_;
     std::atomic_int pendingEvents_;
 
+    // Protected by owner's mutex
+    bool watchingPlaylistItems_;
+    PlaylistRef watchedPlaylist_;
+    Range watchedRange_;
+
+    // Accessed only by reader thread
+    uint64_t lastSequence_;
+
     MSRV_NO_COPY_AND_ASSIGN(EventListener);
 };
 
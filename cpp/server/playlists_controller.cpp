@@ -157,9 +157,13 @@ ResponsePtr PlaylistsController::addItems()
     for (auto& item : items)
         normalizedItems.emplace_back(validateAndNormalizeItem(item));
 
-    auto addCompleted = player_->addPlaylistItems(plref, normalizedItems, targetIndex, options);
+    auto async = optionalParam("async", false);
 
-    if (optionalParam("async", false))
+    // Asynchronous adding continues after response is sent
+    auto addCompleted = player_->addPlaylistItems(
+        plref, normalizedItems, targetIndex, options, async ? nullptr : request()->cancellation);
+
+    if (async)
     {
         addCompleted.then(boost::launch::sync, [](boost::unique_future<void> result) {
             tryCatchLog([&] { result.get(); });
@@ -285,6 +289,7 @@ void PlaylistsController::defineRoutes(Router* router, WorkQueue* workQueue, Pla
     routes.post(":plref/:targetPlref/items/move", &PlaylistsController::moveItemsBetweenPlaylists);
     routes.post(":plref/:targetPlref/items/copy", &PlaylistsController::copyItemsBetweenPlaylists);
 
+    routes.setPriority(WorkPriority::BULK);
     routes.get(":plref/items/:range", &PlaylistsController::getPlaylistItems);
 }
 
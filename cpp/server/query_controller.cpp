@@ -4,6 +4,7 @@
 #include "core_types_json.hpp"
 #include "player_api_json.hpp"
 #include "player_api_parsers.hpp"
+#include "parsing.hpp"
 
 namespace msrv {
 
@@ -14,6 +15,8 @@ constexpr char PLAYLISTS_KEY[] = "playlists";
 constexpr char PLAYLIST_ITEMS_KEY[] = "playlistItems";
 constexpr char PLAY_QUEUE_KEY[] = "playQueue";
 constexpr char OUTPUTS_KEY[] = "outputs";
+constexpr char DIFF_KEY[] = "diff";
+constexpr char LAST_EVENT_ID_KEY[] = "lastEventId";
 
 }
 
@@ -35,22 +38,42 @@ ResponsePtr QueryController::query()
 ResponsePtr QueryController::getEvents()
 {
     auto mask = readEventMask();
-    listenForEvents(mask);
+    listenForEvents(mask, true);
 
-    return Response::eventStream([this] {
+    auto response = Response::eventStream([this] {
         return eventsToJson(listener_->readEvents());
     });
+
+    response->shareable = true;
+    response->eventId = [this] { return currentEventId(); };
+    return response;
 }
 
 ResponsePtr QueryController::getUpdates()
 {
     auto mask = readEventMask();
+    auto diff = optionalParam(DIFF_KEY, false);
+
     createQueries(mask);
-    listenForEvents(mask);
 
-    return Response::eventStream([this] {
+    // Patches are computed against the full state sent to this stream, it could not be resumed
+    listenForEvents(mask, !diff);
+
+    if (diff)
+    {
+        return Response::eventStream([this] {
+            return stateToPatch(listener_->readEvents());
+        });
+    }
+
+    // Patches depend on state sent to particular client, so only full state events are shared
+    auto response = Response::eventStream([this] {
         return stateToJson(listener_->readEvents());
     });
+
+    response->shareable = true;
+    response->eventId = [this] { return currentEventId(); };
+    return response;
 }
 
 PlayerEvents QueryController::readEventMask()
@@ -102,9 +125,38 @@ void QueryController::createQueries(PlayerEvents events)
     }
 }
 
-void QueryController::listenForEvents(PlayerEvents events)
+void QueryController::listenForEvents(PlayerEvents events, bool canResume)
 {
     listener_ = dispatcher_->createListener(events);
+
+    // Changes of other playlists and items outside of requested range are not interesting
+    if (hasFlags(events, PlayerEvents::PLAYLIST_ITEMS_CHANGED) && playlistRef_.type() != PlaylistRefType::INVALID)
+        listener_->watchPlaylistItems(playlistRef_, playlistRange_);
+
+    if (!canResume)
+        return;
+
+    // Reconnecting client receives only what it has missed, or everything if missed changes are too old
+    if (auto lastEventId = readLastEventId())
+        listener_->resumeAfter(StringView(*lastEventId));
+}
+
+boost::optional<std::string> QueryController::readLastEventId()
+{
+    // Browsers send header when reconnecting automatically, parameter allows resuming explicitly
+    if (auto value = optionalParam<std::string>(LAST_EVENT_ID_KEY))
+        return value;
+
+    auto header = request()->getHeader(HttpHeader::LAST_EVENT_ID);
+    if (!header.empty())
+        return header.to_string();
+
+    return boost::none;
+}
+
+std::string QueryController::currentEventId()
+{
+    return listener_->lastEventId();
 }
 
 Json QueryController::eventsToJson(PlayerEvents events)
@@ -155,6 +207,50 @@ Json QueryController::stateToJson(PlayerEvents events)
     return obj;
 }
 
+Json QueryController::stateToPatch(PlayerEvents events)
+{
+    auto state = stateToJson(events);
+
+    // The first event is full state, the next ones are JSON Patch (RFC 6902) documents
+    if (lastState_.is_null())
+    {
+        lastState_ = state;
+        return state;
+    }
+
+    Json patch = Json::array();
+
+    for (auto& item : state.items())
+    {
+        auto path = std::string("/") + item.key();
+        auto lastValue = lastState_.find(item.key());
+
+        if (lastValue == lastState_.end())
+        {
+            patch.push_back({{"op", "add"}, {"path", path}, {"value", item.value()}});
+            lastState_[item.key()] = std::move(item.value());
+            continue;
+        }
+
+        auto valuePatch = Json::diff(*lastValue, item.value(), path);
+
+        // Shifted array elements produce operation per element, replacing whole value is shorter
+        if (valuePatch.size() > 1 && jsonDumpSafe(valuePatch).size() > jsonDumpSafe(item.value()).size())
+            valuePatch = Json::array({{{"op", "replace"}, {"path", path}, {"value", item.value()}}});
+
+        for (auto& operation : valuePatch)
+            patch.push_back(std::move(operation));
+
+        *lastValue = std::move(item.value());
+    }
+
+    // Nothing has changed, client receives keep-alive comment
+    if (patch.empty())
+        return Json();
+
+    return patch;
+}
+
 void QueryController::defineRoutes(
     Router* router, WorkQueue* workQueue, Player* player, EventDispatcher* dispatcher, SettingsDataPtr settings)
 {
@@ -162,6 +258,7 @@ void QueryController::defineRoutes(
 
     routes.createWith([=](Request* request) { return new QueryController(request, player, dispatcher, settings); });
     routes.useWorkQueue(workQueue);
+    routes.setPriority(WorkPriority::BULK);
     routes.setPrefix("api/query");
 
     routes.get("", &QueryController::query);
@@ -7,6 +7,8 @@
 
 #include <memory>
 
+#include <boost/optional.hpp>
+
 namespace msrv {
 
 class Router;
@@ -27,10 +29,13 @@ public:
 private:
     PlayerEvents readEventMask();
     void createQueries(PlayerEvents events);
-    void listenForEvents(PlayerEvents events);
+    void listenForEvents(PlayerEvents events, bool canResume);
+    boost::optional<std::string> readLastEventId();
+    std::string currentEventId();
 
     static Json eventsToJson(PlayerEvents events);
     Json stateToJson(PlayerEvents events);
+    Json stateToPatch(PlayerEvents events);
 
     Player* player_;
     EventDispatcher* dispatcher_;
@@ -42,6 +47,9 @@ private:
     Range playlistRange_;
     ColumnsQueryPtr playlistQuery_;
     ColumnsQueryPtr queueQuery_;
+
+    // State received by client so far, used by updates stream in diff mode
+    Json lastState_;
 };
 
 }
@@ -1,6 +1,7 @@
 #include "request.hpp"
 #include "response.hpp"
 #include "log.hpp"
+#include "work_queue.hpp"
 
 namespace msrv {
 
@@ -23,6 +24,11 @@ public:
         return nullptr;
     }
 
+    WorkPriority priority() override
+    {
+        return WorkPriority::INTERACTIVE;
+    }
+
     RequestHandlerPtr createHandler(Request*) override
     {
         return std::make_unique<EmptyRequestHandler>();
@@ -48,6 +54,25 @@ Request::Request(HttpMethod methodVal, std::string pathVal)
 
 Request::~Request() = default;
 
+HttpKeyValueMap Request::headers() const
+{
+    HttpKeyValueMap result;
+
+    if (message)
+    {
+        message->visitHeaders([&](StringView name, StringView value) {
+            result.emplace(name.to_string(), value.to_string());
+        });
+    }
+
+    return result;
+}
+
+HttpKeyValueMap Request::queryParams() const
+{
+    return message ? parseQueryString(message->queryString()) : HttpKeyValueMap();
+}
+
 void Request::setErrorResponse(std::string message, std::string param)
 {
     response = Response::error(HttpStatus::S_400_BAD_REQUEST, std::move(message), std::move(param));
@@ -58,7 +83,10 @@ void Request::executeHandler()
     assert(handler);
     assert(!isHandlerExecuted_);
     isHandlerExecuted_ = true;
+
+    auto startTime = std::chrono::steady_clock::now();
     response = handler->execute();
+    handlerTime = std::chrono::steady_clock::now() - startTime;
 }
 
 RequestHandlerFactory* RequestHandlerFactory::empty()
@@ -4,7 +4,11 @@
 #include "json.hpp"
 #include "core_types.hpp"
 #include "parsing.hpp"
+#include "request_arena.hpp"
+#include "cancellation.hpp"
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 
 #include <boost/optional.hpp>
@@ -13,6 +17,8 @@ namespace msrv {
 
 class WorkQueue;
 
+enum class WorkPriority;
+
 class Request;
 
 class RequestHandler;
@@ -21,7 +27,7 @@ class RequestHandlerFactory;
 
 class Response;
 
-using RequestHandlerPtr = std::unique_ptr<RequestHandler>;
+using RequestHandlerPtr = ArenaPtr<RequestHandler>;
 using RequestHandlerFactoryPtr = std::unique_ptr<RequestHandlerFactory>;
 
 class Request
@@ -33,14 +39,23 @@ public:
 
     HttpMethod method;
     std::string path;
-    HttpKeyValueMap headers;
+    RequestMessagePtr message;
+
+    // Arena of the request, could be used only while dispatching request on server thread
+    RequestArena* arena = nullptr;
     HttpKeyValueMap routeParams;
-    HttpKeyValueMap queryParams;
     Json postData;
     RequestHandlerPtr handler;
     std::unique_ptr<Response> response;
     int lastFilter = -1;
 
+    // Cancelled when connection is closed or response is written,
+    // long running operations could use it to stop work nobody waits for
+    CancellationTokenPtr cancellation;
+
+    // Time spent in handler, collected for server metrics
+    std::chrono::steady_clock::duration handlerTime = std::chrono::steady_clock::duration::zero();
+
     template<typename T>
     T param(const std::string& key);
 
@@ -63,18 +78,33 @@ public:
         isProcessed_ = true;
     }
 
-    const std::string& getHeader(const std::string& key)
+    StringView getHeader(StringView key) const
     {
-        auto it = headers.find(key);
-        return it != headers.end() ? it->second : emptyHeader_;
+        StringView value;
+
+        if (message)
+            message->findHeader(key, &value);
+
+        return value;
     }
 
+    HttpKeyValueMap headers() const;
+    HttpKeyValueMap queryParams() const;
+
     void executeHandler();
 
+    bool isHandlerExecuted() const
+    {
+        return isHandlerExecuted_;
+    }
+
 private:
     template<typename T>
     bool tryGetParam(const HttpKeyValueMap& params, const std::string& key, T* outVal);
 
+    template<typename T>
+    bool tryGetQueryParam(const std::string& key, T* outVal);
+
     template<typename T>
     bool tryGetParam(const Json& json, const std::string& key, T* outVal);
 
@@ -85,7 +115,6 @@ private:
 
     bool isProcessed_;
     bool isHandlerExecuted_;
-    std::string emptyHeader_;
 
     MSRV_NO_COPY_AND_ASSIGN(Request);
 };
@@ -106,13 +135,42 @@ class RequestHandlerFactory
 public:
     static RequestHandlerFactory* empty();
 
-    RequestHandlerFactory() = default;
+    RequestHandlerFactory()
+        : activeRequests_(0)
+    {
+    }
+
     virtual ~RequestHandlerFactory() = default;
 
+    // Null queue means handler is non-blocking and is executed on I/O thread
     virtual WorkQueue* workQueue() = 0;
+    virtual WorkPriority priority() = 0;
     virtual RequestHandlerPtr createHandler(Request* request) = 0;
 
+    // Counts requests to this route which are not responded yet (zero limit means no limit).
+    // Every admitted request should be released by releaseRequest().
+    bool tryAdmitRequest(size_t limit)
+    {
+        auto count = activeRequests_.fetch_add(1, std::memory_order_relaxed);
+
+        if (limit > 0 && count >= limit)
+        {
+            activeRequests_.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        return true;
+    }
+
+    void releaseRequest()
+    {
+        activeRequests_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
     MSRV_NO_COPY_AND_ASSIGN(RequestHandlerFactory);
+
+private:
+    std::atomic<size_t> activeRequests_;
 };
 
 template<typename T>
@@ -130,6 +188,25 @@ bool Request::tryGetParam(const HttpKeyValueMap& params, const std::string& key,
     throw InvalidRequestException();
 }
 
+template<typename T>
+bool Request::tryGetQueryParam(const std::string& key, T* outVal)
+{
+    if (!message)
+        return false;
+
+    StringView value;
+    std::string buffer;
+
+    if (!findQueryParam(message->queryString(), key, &value, &buffer))
+        return false;
+
+    if (tryParseValue(value, outVal))
+        return true;
+
+    setErrorResponse("invalid value format", key);
+    throw InvalidRequestException();
+}
+
 template<typename T>
 bool Request::tryGetParam(const Json& json, const std::string& key, T* outVal)
 {
@@ -161,7 +238,7 @@ template<typename T>
 bool Request::tryGetParam(const std::string& key, T* outVal)
 {
     return tryGetParam(routeParams, key, outVal)
-        || tryGetParam(queryParams, key, outVal)
+        || tryGetQueryParam(key, outVal)
         || tryGetParam(postData, key, outVal);
 }
 
@@ -0,0 +1,103 @@
+#include "request_arena.hpp"
+
+#include <assert.h>
+#include <cstddef>
+
+namespace msrv {
+
+RequestArena::RequestArena()
+    : blockIndex_(0), blockOffset_(0), refs_(0)
+{
+}
+
+RequestArena::~RequestArena() = default;
+
+void* RequestArena::allocate(size_t size, size_t alignment)
+{
+    assert(refs_.load() > 0);
+    assert(alignment <= alignof(std::max_align_t));
+
+    if (size > BLOCK_SIZE / 4)
+    {
+        largeBlocks_.emplace_back(new char[size]);
+        refs_.fetch_add(1, std::memory_order_relaxed);
+        return largeBlocks_.back().get();
+    }
+
+    size_t offset = (blockOffset_ + alignment - 1) & ~(alignment - 1);
+
+    if (blocks_.empty() || offset + size > BLOCK_SIZE)
+    {
+        if (!blocks_.empty())
+            blockIndex_++;
+
+        if (blockIndex_ == blocks_.size())
+            blocks_.emplace_back(new char[BLOCK_SIZE]);
+
+        offset = 0;
+    }
+
+    blockOffset_ = offset + size;
+    refs_.fetch_add(1, std::memory_order_relaxed);
+    return blocks_[blockIndex_].get() + offset;
+}
+
+void RequestArena::unref() noexcept
+{
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    reset();
+
+    // Pool might be destroyed together with this arena when the last reference goes away
+    auto pool = std::move(pool_);
+    pool->recycle(this);
+}
+
+void RequestArena::reset() noexcept
+{
+    largeBlocks_.clear();
+    blockIndex_ = 0;
+    blockOffset_ = 0;
+}
+
+RequestArenaPool::RequestArenaPool()
+{
+    freeArenas_.reserve(MAX_FREE_ARENAS);
+}
+
+RequestArenaPool::~RequestArenaPool() = default;
+
+RequestArena* RequestArenaPool::acquire()
+{
+    std::unique_ptr<RequestArena> arena;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (!freeArenas_.empty())
+        {
+            arena = std::move(freeArenas_.back());
+            freeArenas_.pop_back();
+        }
+    }
+
+    if (!arena)
+        arena.reset(new RequestArena());
+
+    arena->pool_ = shared_from_this();
+    arena->refs_.store(1, std::memory_order_relaxed);
+    return arena.release();
+}
+
+void RequestArenaPool::recycle(RequestArena* arena) noexcept
+{
+    std::unique_ptr<RequestArena> arenaPtr(arena);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (freeArenas_.size() < MAX_FREE_ARENAS)
+        freeArenas_.emplace_back(std::move(arenaPtr));
+}
+
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+#include "defines.hpp"
+
+#include <stddef.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace msrv {
+
+class RequestArena;
+class RequestArenaPool;
+
+using RequestArenaPoolPtr = std::shared_ptr<RequestArenaPool>;
+
+// Monotonic memory arena for objects that live as long as a single request.
+// Individual deallocations do not free memory, all memory is reclaimed at once
+// when owner has released arena and every object allocated from it is destroyed.
+// allocate() should be called only by the owner, deallocate() is thread-safe.
+class RequestArena
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 4096;
+
+    ~RequestArena();
+
+    void* allocate(size_t size, size_t alignment);
+
+    void deallocate(void*) noexcept
+    {
+        unref();
+    }
+
+    void release() noexcept
+    {
+        unref();
+    }
+
+private:
+    friend class RequestArenaPool;
+
+    RequestArena();
+
+    void unref() noexcept;
+    void reset() noexcept;
+
+    RequestArenaPoolPtr pool_;
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    std::vector<std::unique_ptr<char[]>> largeBlocks_;
+    size_t blockIndex_;
+    size_t blockOffset_;
+    std::atomic<size_t> refs_;
+
+    MSRV_NO_COPY_AND_ASSIGN(RequestArena);
+};
+
+// Keeps released arenas (and their memory blocks) for reuse
+class RequestArenaPool : public std::enable_shared_from_this<RequestArenaPool>
+{
+public:
+    static constexpr size_t MAX_FREE_ARENAS = 64;
+
+    RequestArenaPool();
+    ~RequestArenaPool();
+
+    RequestArena* acquire();
+
+private:
+    friend class RequestArena;
+
+    void recycle(RequestArena* arena) noexcept;
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<RequestArena>> freeArenas_;
+
+    MSRV_NO_COPY_AND_ASSIGN(RequestArenaPool);
+};
+
+// Standard allocator adapter, uses global heap if arena is not specified
+template<typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator() noexcept
+        : arena_(nullptr)
+    {
+    }
+
+    explicit ArenaAllocator(RequestArena* arena) noexcept
+        : arena_(arena)
+    {
+    }
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+        : arena_(other.arena())
+    {
+    }
+
+    RequestArena* arena() const noexcept
+    {
+        return arena_;
+    }
+
+    T* allocate(size_t count)
+    {
+        if (arena_)
+            return static_cast<T*>(arena_->allocate(count * sizeof(T), alignof(T)));
+
+        return std::allocator<T>().allocate(count);
+    }
+
+    void deallocate(T* ptr, size_t count) noexcept
+    {
+        if (arena_)
+            arena_->deallocate(ptr);
+        else
+            std::allocator<T>().deallocate(ptr, count);
+    }
+
+private:
+    RequestArena* arena_;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) noexcept
+{
+    return lhs.arena() == rhs.arena();
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& lhs, const ArenaAllocator<U>& rhs) noexcept
+{
+    return lhs.arena() != rhs.arena();
+}
+
+// Deleter for std::unique_ptr, also accepts objects allocated with plain new
+template<typename T>
+class ArenaDeleter
+{
+public:
+    ArenaDeleter() noexcept
+        : arena_(nullptr)
+    {
+    }
+
+    explicit ArenaDeleter(RequestArena* arena) noexcept
+        : arena_(arena)
+    {
+    }
+
+    template<typename U>
+    ArenaDeleter(const ArenaDeleter<U>& other) noexcept
+        : arena_(other.arena())
+    {
+    }
+
+    template<typename U>
+    ArenaDeleter(const std::default_delete<U>&) noexcept
+        : arena_(nullptr)
+    {
+    }
+
+    RequestArena* arena() const noexcept
+    {
+        return arena_;
+    }
+
+    void operator()(T* ptr) const noexcept
+    {
+        if (arena_)
+        {
+            ptr->~T();
+            arena_->deallocate(ptr);
+        }
+        else
+        {
+            delete ptr;
+        }
+    }
+
+private:
+    RequestArena* arena_;
+};
+
+template<typename T>
+using ArenaPtr = std::unique_ptr<T, ArenaDeleter<T>>;
+
+// Completion handler wrapper, makes asynchronous operation allocate its state from arena
+template<typename Handler>
+class ArenaBoundHandler
+{
+public:
+    using allocator_type = ArenaAllocator<char>;
+
+    ArenaBoundHandler(RequestArena* arena, Handler handler)
+        : arena_(arena), handler_(std::move(handler))
+    {
+    }
+
+    allocator_type get_allocator() const noexcept
+    {
+        return allocator_type(arena_);
+    }
+
+    template<typename... Args>
+    void operator()(Args&&... args)
+    {
+        handler_(std::forward<Args>(args)...);
+    }
+
+private:
+    RequestArena* arena_;
+    Handler handler_;
+};
+
+template<typename Handler>
+ArenaBoundHandler<Handler> bindArena(RequestArena* arena, Handler handler)
+{
+    return ArenaBoundHandler<Handler>(arena, std::move(handler));
+}
+
+template<typename T, typename... Args>
+ArenaPtr<T> arenaNew(RequestArena* arena, Args&&... args)
+{
+    if (!arena)
+        return ArenaPtr<T>(new T(std::forward<Args>(args)...));
+
+    void* memory = arena->allocate(sizeof(T), alignof(T));
+
+    try
+    {
+        return ArenaPtr<T>(new (memory) T(std::forward<Args>(args)...), ArenaDeleter<T>(arena));
+    }
+    catch (...)
+    {
+        arena->deallocate(memory);
+        throw;
+    }
+}
+
+}
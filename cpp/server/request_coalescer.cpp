@@ -0,0 +1,200 @@
+#include "request_coalescer.hpp"
+#include "request.hpp"
+#include "log.hpp"
+
+#include <assert.h>
+
+#include <utility>
+
+namespace msrv {
+
+namespace {
+
+// Headers which are used by request filters and could change the response
+const char* const KEY_HEADERS[] = {
+    HttpHeader::ACCEPT_ENCODING,
+    HttpHeader::AUTHORIZATION,
+    HttpHeader::IF_NONE_MATCH,
+};
+
+// Decimal digits of size_t and separator
+constexpr size_t MAX_LENGTH_PREFIX = 21;
+
+// Components are length-prefixed, so different requests never produce the same key
+void appendKeyPart(std::string& key, StringView value)
+{
+    key += toString(value.size());
+    key += ':';
+    key.append(value.data(), value.size());
+}
+
+class BodyCapture : public boost::static_visitor<bool>
+{
+public:
+    explicit BodyCapture(CoalescedResponse::Body* body)
+        : body_(body)
+    {
+    }
+
+    bool operator()(bool) const
+    {
+        return true;
+    }
+
+    bool operator()(const std::string& str) const
+    {
+        *body_ = str;
+        return true;
+    }
+
+    bool operator()(const std::vector<uint8_t>& buffer) const
+    {
+        *body_ = buffer;
+        return true;
+    }
+
+    bool operator()(const ResponseCore::FileBody&) const
+    {
+        return false;
+    }
+
+private:
+    CoalescedResponse::Body* body_;
+};
+
+class BodyCopy : public boost::static_visitor<ResponseCore::Body>
+{
+public:
+    template<typename T>
+    ResponseCore::Body operator()(const T& value) const
+    {
+        return ResponseCore::Body(value);
+    }
+};
+
+}
+
+CoalescedResponse::CoalescedResponse()
+    : status(HttpStatus::UNDEFINED), headers(), body(false)
+{
+}
+
+CoalescedResponse::~CoalescedResponse() = default;
+
+CoalescedResponsePtr CoalescedResponse::capture(const ResponseCore& response)
+{
+    auto result = std::make_shared<CoalescedResponse>();
+
+    if (!boost::apply_visitor(BodyCapture(&result->body), response.body))
+        return CoalescedResponsePtr();
+
+    result->status = response.status;
+    result->headers = response.headers;
+    return result;
+}
+
+ResponseCorePtr CoalescedResponse::createResponse(RequestArena* arena) const
+{
+    auto response = arenaNew<ResponseCore>(arena);
+    response->status = status;
+    response->headers = headers;
+    response->body = boost::apply_visitor(BodyCopy(), body);
+    return response;
+}
+
+std::string RequestCoalescer::makeKey(const Request* request)
+{
+    if (request->method != HttpMethod::GET || !request->message)
+        return std::string();
+
+    StringView parts[2 + sizeof(KEY_HEADERS) / sizeof(KEY_HEADERS[0])];
+    size_t count = 0;
+
+    parts[count++] = request->path;
+    parts[count++] = request->message->queryString();
+
+    for (auto header : KEY_HEADERS)
+        parts[count++] = request->getHeader(header);
+
+    size_t size = 0;
+
+    for (auto& part : parts)
+        size += part.size() + MAX_LENGTH_PREFIX;
+
+    std::string key;
+    key.reserve(size);
+
+    for (auto& part : parts)
+        appendKeyPart(key, part);
+
+    return key;
+}
+
+RequestCoalescer::RequestCoalescer() = default;
+RequestCoalescer::~RequestCoalescer() = default;
+
+RequestCoalescer::Role RequestCoalescer::join(
+    const std::string& key, const void* scope, FollowerCallback follower)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = flights_.find(key);
+
+    if (it == flights_.end())
+    {
+        flights_[key].scope = scope;
+        return Role::LEADER;
+    }
+
+    if (it->second.scope != scope || it->second.started)
+        return Role::NONE;
+
+    it->second.followers.emplace_back(std::move(follower));
+    return Role::FOLLOWER;
+}
+
+void RequestCoalescer::start(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = flights_.find(key);
+    assert(it != flights_.end());
+
+    it->second.started = true;
+}
+
+void RequestCoalescer::complete(const std::string& key, const ResponseCapture& capture)
+{
+    std::vector<FollowerCallback> followers;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = flights_.find(key);
+        assert(it != flights_.end());
+
+        followers = std::move(it->second.followers);
+        flights_.erase(it);
+    }
+
+    if (followers.empty())
+        return;
+
+    CoalescedResponsePtr response;
+    tryCatchLog([&] { response = capture(); });
+
+    for (auto& follower : followers)
+        tryCatchLog([&] { follower(response); });
+}
+
+void RequestCoalescer::clear()
+{
+    std::unordered_map<std::string, Flight> flights;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flights_.swap(flights);
+    }
+}
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "defines.hpp"
+#include "server_core.hpp"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/variant.hpp>
+
+namespace msrv {
+
+class Request;
+
+class CoalescedResponse;
+
+using CoalescedResponsePtr = std::shared_ptr<const CoalescedResponse>;
+
+// Serialized response which could be sent to several clients
+class CoalescedResponse
+{
+public:
+    using Body = boost::variant<bool, std::string, std::vector<uint8_t>>;
+
+    // Returns null if response body could not be shared (e.g. file body)
+    static CoalescedResponsePtr capture(const ResponseCore& response);
+
+    CoalescedResponse();
+    ~CoalescedResponse();
+
+    ResponseCorePtr createResponse(RequestArena* arena) const;
+
+    HttpStatus status;
+    HttpKeyValueMap headers;
+    Body body;
+
+private:
+    MSRV_NO_COPY_AND_ASSIGN(CoalescedResponse);
+};
+
+// Attaches identical concurrent requests to a single computation (single-flight).
+// The first request of a key becomes the leader, requests with the same key arriving
+// before the leader has started are followers and receive the leader's response.
+// Requests arriving later run on their own: the leader might have already read the state
+// they should observe (e.g. changed by a command they have sent before).
+class RequestCoalescer
+{
+public:
+    enum class Role
+    {
+        NONE,
+        LEADER,
+        FOLLOWER,
+    };
+
+    // Called with null response if leader could not provide shareable response
+    using FollowerCallback = std::function<void(CoalescedResponsePtr)>;
+    using ResponseCapture = std::function<CoalescedResponsePtr()>;
+
+    // Returns empty string if request should not be coalesced.
+    // Query string is used as is, requests with differently encoded parameters are not coalesced.
+    static std::string makeKey(const Request* request);
+
+    RequestCoalescer();
+    ~RequestCoalescer();
+
+    // Requests are coalesced only within the same scope (e.g. server config)
+    Role join(const std::string& key, const void* scope, FollowerCallback follower);
+
+    // Should be called by leader right before computing response, closes the flight to new followers
+    void start(const std::string& key);
+
+    // Should be called by leader exactly once, followers are notified on the calling thread.
+    // Response is captured only if there are followers, null response makes them run on their own.
+    void complete(const std::string& key, const ResponseCapture& capture);
+
+    // Drops flights in progress without notifying followers
+    void clear();
+
+private:
+    struct Flight
+    {
+        Flight()
+            : scope(nullptr), started(false)
+        {
+        }
+
+        const void* scope;
+        bool started;
+        std::vector<FollowerCallback> followers;
+    };
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, Flight> flights_;
+
+    MSRV_NO_COPY_AND_ASSIGN(RequestCoalescer);
+};
+
+}
@@ -132,7 +132,7 @@ void JsonResponse::process(ResponseHandler* handler)
 }
 
 EventStreamResponse::EventStreamResponse(EventStreamSource sourceVal)
-    : Response(HttpStatus::S_200_OK), source(std::move(sourceVal))
+    : Response(HttpStatus::S_200_OK), source(std::move(sourceVal)), shareable(false), period(DurationMs::zero())
 {
 }
 
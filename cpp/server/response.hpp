@@ -2,6 +2,7 @@
 
 #include "http.hpp"
 #include "json.hpp"
+#include "chrono.hpp"
 #include "system.hpp"
 #include "file_system.hpp"
 
@@ -30,6 +31,7 @@ class ErrorResponse;
 using ResponsePtr = std::unique_ptr<Response>;
 using ResponseFuture = boost::unique_future<ResponsePtr>;
 using EventStreamSource = std::function<Json()>;
+using EventIdSource = std::function<std::string()>;
 
 class Response
 {
@@ -135,6 +137,17 @@ public:
     void process(ResponseHandler* handler) override;
 
     EventStreamSource source;
+
+    // Events of identical requests could be produced once and sent to all of them.
+    // Event source should return values which depend only on changes accumulated since the previous call.
+    bool shareable;
+
+    // If non-zero, events are also produced with this period regardless of player events
+    DurationMs period;
+
+    // If set, called right after event source on the same thread.
+    // Returned value is sent as event id which client reports in Last-Event-ID header when reconnecting.
+    EventIdSource eventId;
 };
 
 class AsyncResponse : public Response
@@ -4,29 +4,34 @@ namespace msrv {
 
 void ResponseSender::initResponse(Response* response)
 {
-    responseCore_ = std::make_unique<ResponseCore>();
+    responseCore_ = arenaNew<ResponseCore>(requestCore_->arena());
     responseCore_->status = response->status;
     responseCore_->headers = std::move(response->headers);
 }
 
-void ResponseSender::send(Response* response)
+ResponseCorePtr ResponseSender::build(Response* response)
 {
     initResponse(response);
     response->process(this);
-    requestCore_->sendResponse(std::move(responseCore_));
+    return std::move(responseCore_);
 }
 
-void ResponseSender::sendEventStream(EventStreamResponse* response, Json event)
+void ResponseSender::sendEventStream(EventStreamResponse* response, Json event, const std::string& eventId)
 {
     initResponse(response);
     setHeader(HttpHeader::CONTENT_TYPE, "text/event-stream");
-    responseCore_->body = eventToString(event);
+    responseCore_->body = eventToString(event, eventId);
     requestCore_->sendResponseBegin(std::move(responseCore_));
 }
 
-void ResponseSender::sendEvent(Json event)
+void ResponseSender::sendEvent(Json event, const std::string& eventId)
 {
-    requestCore_->sendResponseBody(eventToString(event));
+    requestCore_->sendResponseBody(eventToString(event, eventId));
+}
+
+void ResponseSender::sendSerializedEvent(std::string data)
+{
+    requestCore_->sendResponseBody(std::move(data));
 }
 
 void ResponseSender::handleResponse(SimpleResponse*)
@@ -80,7 +85,7 @@ void ResponseSender::setJsonBody(const Json& value)
     responseCore_->body = std::move(str);
 }
 
-std::string ResponseSender::eventToString(const Json& value)
+std::string ResponseSender::eventToString(const Json& value, const std::string& eventId)
 {
     std::string buffer;
 
@@ -92,7 +97,16 @@ std::string ResponseSender::eventToString(const Json& value)
 
     buffer = "data: ";
     buffer.append(jsonDumpSafe(value));
-    buffer.append("\n\n");
+    buffer.append("\n");
+
+    if (!eventId.empty())
+    {
+        buffer.append("id: ");
+        buffer.append(eventId);
+        buffer.append("\n");
+    }
+
+    buffer.append("\n");
     return buffer;
 }
 
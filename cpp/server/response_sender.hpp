@@ -17,12 +17,18 @@ public:
 
     ~ResponseSender() = default;
 
-    void send(Response* response);
-    void sendEvent(Json event);
-    void sendEventStream(EventStreamResponse* response, Json event);
+    // Response is sent by RequestCore::sendResponse(), this allows measuring serialization separately
+    ResponseCorePtr build(Response* response);
+
+    void sendEvent(Json event, const std::string& eventId);
+    void sendEventStream(EventStreamResponse* response, Json event, const std::string& eventId);
+
+    // Event serialized with eventToString(), allows sending the same event to several clients
+    void sendSerializedEvent(std::string data);
+
+    static std::string eventToString(const Json& value, const std::string& eventId);
 
 private:
-    static std::string eventToString(const Json& value);
 
     void initResponse(Response* response);
 
@@ -214,7 +214,7 @@ void Router::defineRoute(HttpMethod method, const std::string& path, RequestHand
     node->defineRoute(method, std::move(factory));
 }
 
-std::unique_ptr<RouteResult> Router::dispatch(const Request* request) const
+ArenaPtr<RouteResult> Router::dispatch(const Request* request) const
 {
     HttpKeyValueMap params;
 
@@ -222,10 +222,10 @@ std::unique_ptr<RouteResult> Router::dispatch(const Request* request) const
 
     auto node = matchNode(rootNode_.get(), &urlTokenizer, params);
     if (!node)
-        return std::make_unique<RouteResult>(Response::notFound());
+        return arenaNew<RouteResult>(request->arena, Response::notFound());
 
     if (request->method == HttpMethod::OPTIONS)
-        return std::make_unique<RouteResult>(RequestHandlerFactory::empty(), HttpKeyValueMap());
+        return arenaNew<RouteResult>(request->arena, RequestHandlerFactory::empty(), HttpKeyValueMap());
 
     auto factory = node->getRoute(request->method);
     if (!factory)
@@ -234,10 +234,10 @@ std::unique_ptr<RouteResult> Router::dispatch(const Request* request) const
                       ? HttpStatus::S_405_METHOD_NOT_ALLOWED
                       : HttpStatus::S_404_NOT_FOUND;
 
-        return std::make_unique<RouteResult>(Response::error(status));
+        return arenaNew<RouteResult>(request->arena, Response::error(status));
     }
 
-    return std::make_unique<RouteResult>(factory, std::move(params));
+    return arenaNew<RouteResult>(request->arena, factory, std::move(params));
 }
 
 }
@@ -3,6 +3,7 @@
 #include "defines.hpp"
 #include "http.hpp"
 #include "controller.hpp"
+#include "work_queue.hpp"
 
 #include <functional>
 #include <unordered_map>
@@ -43,7 +44,7 @@ public:
         return RouteBuilder<T>(this);
     }
 
-    std::unique_ptr<RouteResult> dispatch(const Request* request) const;
+    ArenaPtr<RouteResult> dispatch(const Request* request) const;
 
 private:
     std::unique_ptr<router_internal::Node> rootNode_;
@@ -61,7 +62,7 @@ class RouteBuilder
 {
 public:
     RouteBuilder(Router* router)
-        : router_(router), workQueue_(nullptr)
+        : router_(router), workQueue_(nullptr), useIoThread_(false), priority_(WorkPriority::INTERACTIVE)
     {
     }
 
@@ -81,18 +82,32 @@ public:
     void useWorkQueue(WorkQueue* queue)
     {
         workQueue_ = queue;
+        useIoThread_ = false;
+    }
+
+    // Handlers and filters of non-blocking routes are executed directly on I/O thread
+    void useIoThread()
+    {
+        workQueue_ = nullptr;
+        useIoThread_ = true;
+    }
+
+    // Applies to routes defined after this call, queues without priority support ignore it
+    void setPriority(WorkPriority priority)
+    {
+        priority_ = priority;
     }
 
     void define(HttpMethod method, const std::string& path, ControllerAction<T> action)
     {
         assert(factory_);
-        assert(workQueue_);
+        assert(workQueue_ || useIoThread_);
 
         router_->defineRoute(
             method,
             prefix_ + path,
             std::make_unique<DelegateRequestHandlerFactory<T>>(
-                factory_, std::move(action), workQueue_));
+                factory_, std::move(action), workQueue_, priority_));
     }
 
     void get(const std::string& path, ControllerAction<T> action)
@@ -118,6 +133,8 @@ private:
     ControllerFactory<T> factory_;
     std::string prefix_;
     WorkQueue* workQueue_;
+    bool useIoThread_;
+    WorkPriority priority_;
 };
 
 }
@@ -3,23 +3,84 @@
 #include "log.hpp"
 #include "response_sender.hpp"
 
+#include <algorithm>
+
 namespace msrv {
 
-ServerConfig::ServerConfig(int portVal, bool allowRemoteVal)
-    : port(portVal), allowRemote(allowRemoteVal)
+namespace {
+
+std::atomic<uint64_t> eventProductionTicket(0);
+
+uint64_t nextEventProductionTicket()
+{
+    return eventProductionTicket.fetch_add(1, std::memory_order_seq_cst) + 1;
+}
+
+bool isSameEventGroup(const RequestContextPtr& lhs, const RequestContextPtr& rhs)
+{
+    return lhs->config == rhs->config && lhs->eventGroupKey == rhs->eventGroupKey;
+}
+
+bool isEventGroupBefore(const RequestContextPtr& lhs, const RequestContextPtr& rhs)
+{
+    if (lhs->config != rhs->config)
+        return std::less<const ServerConfig*>()(lhs->config.get(), rhs->config.get());
+
+    return lhs->eventGroupKey < rhs->eventGroupKey;
+}
+
+// Changes read by producer include all changes made after client has received its state
+bool canReceiveEventOf(const RequestContext* context, const RequestContext* producer)
+{
+    return producer->eventRead.begin == context->eventState.begin
+        || producer->eventRead.end < context->eventState.begin;
+}
+
+}
+
+ServerConfig::ServerConfig(int portVal, bool allowRemoteVal, int ioThreadsVal)
+    : port(portVal),
+      allowRemote(allowRemoteVal),
+      ioThreads(ioThreadsVal),
+      maxQueuedRequests(0),
+      maxRouteRequests(0),
+      connectionLimits(),
+      accessPolicy(0),
+      metrics(std::make_shared<ServerMetrics>())
 {
 }
 
 ServerConfig::~ServerConfig() = default;
 
+bool ServerConfig::requiresRestart(const ServerConfig& next) const
+{
+    return port != next.port
+        || allowRemote != next.allowRemote
+        || ioThreads != next.ioThreads
+        || localSocket != next.localSocket;
+}
+
+bool ServerConfig::requiresReauthorization(const ServerConfig& next) const
+{
+    return accessPolicy != next.accessPolicy;
+}
+
 Server::Server(ServerCorePtr core, ServerConfigPtr config)
     : core_(std::move(core)),
       config_(std::move(config)),
+      shards_(core_->shardCount()),
       dispatchEventsRequested_(true)
 {
+    for (size_t i = 0; i < shards_.size(); i++)
+        shards_[i].workQueue = core_->shardWorkQueue(i);
+
     core_->setEventListener(this);
+    core_->setConnectionLimits(config_->connectionLimits);
     core_->bind(config_->port, config_->allowRemote);
 
+    if (!config_->localSocket.empty())
+        core_->bindLocal(config_->localSocket);
+
     dispatchEventsTimer_ = core_->timerFactory()->createTimer();
     dispatchEventsTimer_->setCallback([this](Timer*) { doDispatchEvents(); });
     dispatchEventsTimer_->runOnce(eventDispatchDelay());
@@ -27,25 +88,44 @@ Server::Server(ServerCorePtr core, ServerConfigPtr config)
 
 Server::~Server()
 {
-    std::vector<RequestCore*> requests;
+    // All shard threads are stopped at this point, it is safe to touch any shard
 
-    requests.reserve(contexts_.size());
+    std::vector<RequestCore*> requests;
 
-    for (auto& pair : contexts_)
-        requests.push_back(pair.first);
+    for (auto& shard : shards_)
+    {
+        for (auto& pair : shard.contexts)
+            requests.push_back(pair.first);
+    }
 
     for (auto corereq : requests)
         corereq->abort();
 
     dispatchEventsTimer_.reset();
     core_.reset();
+    coalescer_.clear();
 
-    assert(contexts_.empty());
-    assert(eventStreamContexts_.empty());
+    for (auto& shard : shards_)
+    {
+        assert(shard.contexts.empty());
+        assert(shard.eventStreamContexts.empty());
+        (void) shard;
+    }
 
     destroyed_.set_value();
 }
 
+void Server::run()
+{
+    for (auto& shard : shards_)
+    {
+        auto shardPtr = &shard;
+        shard.workQueue->enqueue([shardPtr] { shardPtr->threadId = std::this_thread::get_id(); });
+    }
+
+    core_->run();
+}
+
 void Server::onRequestReady(RequestCore* corereq)
 {
     RequestContextPtr context = createContext(corereq);
@@ -57,76 +137,462 @@ void Server::onRequestReady(RequestCore* corereq)
         return;
     }
 
+    if (tryCoalesceRequest(context))
+        return;
+
+    if (!admitRequest(context))
+        return;
+
     registerContext(context);
+    startRequest(std::move(context));
+}
 
-    context->workQueue->enqueue([context] {
-        if (auto server = context->server.lock())
+bool Server::admitRequest(RequestContextPtr context)
+{
+    if (!context->factory->tryAdmitRequest(context->config->maxRouteRequests))
+    {
+        auto counter = &context->metrics()->rejectedByRoute;
+        rejectRequest(std::move(context), counter);
+        return false;
+    }
+
+    context->admitted = true;
+    return true;
+}
+
+void Server::startRequest(RequestContextPtr context)
+{
+    if (context->runInline)
+    {
+        runHandlerAndProcessResponse(std::move(context));
+        return;
+    }
+
+    auto metrics = context->metrics();
+    context->enqueuedAt = MetricsClock::now();
+    metrics->queuedWork.add(1);
+
+    auto enqueued = context->workQueue->tryEnqueue([context] {
+        auto metrics = context->metrics();
+        metrics->queuedWork.add(-1);
+        metrics->phase(RequestPhase::QUEUE).record(MetricsClock::now() - context->enqueuedAt);
+
+        auto server = context->server.lock();
+        if (!server)
+            return;
+
+        if (context->isCancelled())
+            server->dropCancelledRequest(context);
+        else
             server->runHandlerAndProcessResponse(context);
+    }, context->priority, context->config->maxQueuedRequests);
+
+    if (!enqueued)
+    {
+        metrics->queuedWork.add(-1);
+        rejectRequest(std::move(context), &metrics->rejectedByQueue);
+    }
+}
+
+bool Server::tryCoalesceRequest(const RequestContextPtr& context)
+{
+    // Inline handlers are cheap, waiting for another request would not save anything
+    if (context->runInline)
+        return false;
+
+    auto key = RequestCoalescer::makeKey(&context->request);
+    if (key.empty())
+        return false;
+
+    auto role = coalescer_.join(key, context->config.get(), [context](CoalescedResponsePtr response) {
+        auto server = context->server.lock();
+        if (!server)
+            return;
+
+        server->shardQueue(context)->enqueue([context, response] {
+            if (auto server = context->server.lock())
+                server->sendCoalescedResponse(context, response);
+        });
     });
+
+    switch (role)
+    {
+    case RequestCoalescer::Role::LEADER:
+        context->coalescingKey = std::move(key);
+        return false;
+
+    case RequestCoalescer::Role::FOLLOWER:
+        registerContext(context);
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+void Server::completeCoalescing(RequestContext* context, const RequestCoalescer::ResponseCapture& capture)
+{
+    if (context->coalescingKey.empty())
+        return;
+
+    auto key = std::move(context->coalescingKey);
+    context->coalescingKey.clear();
+    coalescer_.complete(key, capture);
+}
+
+void Server::sendCoalescedResponse(RequestContextPtr context, CoalescedResponsePtr response)
+{
+    assertIsShardThread(context->shard);
+
+    if (!context->isAlive())
+        return;
+
+    // Leader has not produced shareable response, process request as usual
+    if (!response)
+    {
+        if (admitRequest(context))
+            startRequest(std::move(context));
+
+        return;
+    }
+
+    context->metrics()->coalescedRequests.increment();
+    context->responseSentAt = MetricsClock::now();
+    context->corereq->sendResponse(response->createResponse(context->corereq->arena()));
+}
+
+void Server::dropCancelledRequest(RequestContextPtr context)
+{
+    context->metrics()->cancelledRequests.increment();
+
+    // Response is not sent, but admission and coalescing should be completed as usual
+    if (isShardThread(context->shard))
+    {
+        sendResponse(std::move(context));
+        return;
+    }
+
+    shardQueue(context)->enqueue([context] {
+        if (auto server = context->server.lock())
+            server->sendResponse(context);
+    });
+}
+
+void Server::rejectRequest(RequestContextPtr context, Counter* counter)
+{
+    counter->increment();
+
+    auto response = Response::error(HttpStatus::S_503_SERVICE_UNAVAILABLE, "server is overloaded");
+    response->headers[HttpHeader::RETRY_AFTER] = toString(overloadRetryAfter().count());
+
+    context->request.response = std::move(response);
+    context->request.setProcessed();
+
+    sendResponse(std::move(context));
+}
+
+void Server::releaseAdmission(RequestContext* context)
+{
+    if (!context->admitted)
+        return;
+
+    context->admitted = false;
+    context->factory->releaseRequest();
 }
 
 void Server::onRequestDone(RequestCore* corereq)
 {
-    eventStreamContexts_.erase(corereq);
+    auto& shard = shards_[corereq->shard()];
+
+    auto it = shard.contexts.find(corereq);
+    if (it == shard.contexts.end())
+        return;
+
+    auto context = std::move(it->second);
+    context->corereq = nullptr;
+    context->request.cancellation->cancel();
+    shard.contexts.erase(it);
+
+    auto metrics = context->metrics();
+    metrics->activeRequests.add(-1);
+
+    if (shard.eventStreamContexts.erase(corereq) > 0)
+    {
+        context->eventTimer.reset();
+        metrics->eventStreams.add(-1);
+        updateBodySize(context.get());
+    }
+    else if (context->responseSentAt != MetricsClock::time_point())
+    {
+        metrics->phase(RequestPhase::WRITE).record(MetricsClock::now() - context->responseSentAt);
+    }
+}
+
+void Server::onRequestBodyDrained(RequestCore* corereq)
+{
+    auto& shard = shards_[corereq->shard()];
+
+    auto it = shard.eventStreamContexts.find(corereq);
+    if (it == shard.eventStreamContexts.end())
+        return;
+
+    auto context = it->second;
+    context->stalledSince = TimePointMs();
+    updateBodySize(context.get());
+
+    if (context->eventDeferred && !context->eventInProgress)
+    {
+        context->eventDeferred = false;
+        produceAndSendEvent(std::move(context));
+    }
+}
+
+void Server::reconfigure(ServerConfigPtr config)
+{
+    assert(!config_->requiresRestart(*config));
+
+    core_->setConnectionLimits(config->connectionLimits);
+
+    bool reauthorize = std::atomic_load(&config_)->requiresReauthorization(*config);
+
+    // Requests in progress (including event streams) keep using previous config
+    std::atomic_store(&config_, ServerConfigConstPtr(std::move(config)));
+
+    if (!reauthorize)
+        return;
+
+    // Clients reconnect and pass filters of the new config
+    std::weak_ptr<Server> thisWeak = shared_from_this();
+
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+        shards_[i].workQueue->enqueue([thisWeak, i] {
+            if (auto server = thisWeak.lock())
+                server->abortUnauthorizedStreams(i);
+        });
+    }
+
+    core_->closeWebSockets();
+}
+
+void Server::abortUnauthorizedStreams(size_t shard)
+{
+    assertIsShardThread(shard);
+
+    auto config = std::atomic_load(&config_);
+    std::vector<RequestCore*> requests;
 
-    auto it = contexts_.find(corereq);
-    if (it != contexts_.end())
+    for (auto& pair : shards_[shard].eventStreamContexts)
     {
-        it->second->corereq = nullptr;
-        contexts_.erase(it);
+        if (pair.second->config->requiresReauthorization(*config))
+            requests.push_back(pair.first);
     }
+
+    for (auto corereq : requests)
+        corereq->abort();
 }
 
 void Server::runHandlerAndProcessResponse(RequestContextPtr context)
 {
-    config_->filters.beginRequest(&context->request);
+    // Requests arriving from now on might expect state newer than the handler reads
+    if (!context->coalescingKey.empty())
+        coalescer_.start(context->coalescingKey);
+
+    auto startTime = MetricsClock::now();
+    context->config->filters.beginRequest(&context->request);
+    auto filtersTime = MetricsClock::now() - startTime;
+
+    // Handler is executed by one of filters
+    if (context->request.isHandlerExecuted())
+    {
+        filtersTime -= context->request.handlerTime;
+        context->metrics()->phase(RequestPhase::HANDLER).record(context->request.handlerTime);
+    }
+
+    context->filtersTime += filtersTime;
 
     processResponse(context);
 }
 
 void Server::produceAndSendEvent(RequestContextPtr context)
 {
-    context->workQueue->enqueue([context] {
+    context->eventInProgress = true;
+    context->metrics()->queuedWork.add(1);
+
+    // Event stream updates could be delayed in favor of requests
+    context->workQueue->enqueueWithPriority([context] {
+        context->metrics()->queuedWork.add(-1);
+
+        if (context->isCancelled())
+            return;
+
         produceEvent(context.get());
 
         if (auto server1 = context->server.lock())
         {
-            server1->core_->workQueue()->enqueue([context] {
+            server1->shardQueue(context)->enqueue([context] {
                 if (auto server2 = context->server.lock())
                     server2->sendEvent(context);
             });
         }
-    });
+    }, WorkPriority::BACKGROUND);
+}
+
+void Server::produceScheduledEvent(RequestCore* corereq)
+{
+    auto& shard = shards_[corereq->shard()];
+    assertIsShardThread(corereq->shard());
+
+    auto it = shard.eventStreamContexts.find(corereq);
+    if (it == shard.eventStreamContexts.end())
+        return;
+
+    auto context = it->second;
+
+    // Stalled streams are detected by regular dispatching
+    if (context->eventInProgress || corereq->pendingBodySize() > 0)
+    {
+        context->eventDeferred = true;
+        return;
+    }
+
+    produceAndSendEvent(std::move(context));
 }
 
 void Server::produceEvent(RequestContext* context)
 {
+    context->lastProduction.begin = nextEventProductionTicket();
+
     bool produced = tryCatchLog([context] {
-        context->lastEvent = context->eventStreamResponse->source();
+        auto response = context->eventStreamResponse;
+        context->lastEvent = response->source();
+
+        if (response->eventId)
+            context->lastEventId = response->eventId();
     });
 
+    context->lastProduction.end = nextEventProductionTicket();
+
     if (!produced)
+    {
         context->lastEvent = Json();
+        context->lastEventId.clear();
+    }
 }
 
 void Server::sendEvent(RequestContextPtr context)
 {
-    assertIsServerThread();
+    assertIsShardThread(context->shard);
+
+    context->eventInProgress = false;
 
     if (!context->isAlive())
         return;
 
-    ResponseSender(context->corereq).sendEvent(std::move(context->lastEvent));
+    context->eventState = context->lastProduction;
+    context->eventRead = context->lastProduction;
+
+    ResponseSender(context->corereq).sendEvent(std::move(context->lastEvent), context->lastEventId);
+    updateBodySize(context.get());
+}
+
+void Server::produceAndSendGroupEvent(RequestContextPtr producer, std::vector<RequestContextPtr> members)
+{
+    for (auto& member : members)
+        member->eventInProgress = true;
+
+    producer->metrics()->queuedWork.add(1);
+
+    producer->workQueue->enqueueWithPriority([producer, members = std::move(members)]() mutable {
+        producer->metrics()->queuedWork.add(-1);
+
+        // Event is serialized once, each member receives a copy of the same data
+        std::shared_ptr<const std::string> data;
+
+        if (!producer->isCancelled())
+        {
+            produceEvent(producer.get());
+            data = std::make_shared<const std::string>(ResponseSender::eventToString(
+                producer->lastEvent, producer->lastEventId));
+            producer->lastEvent = Json();
+        }
+
+        if (auto server1 = producer->server.lock())
+        {
+            server1->shardQueue(producer)->enqueue([producer, members = std::move(members), data] {
+                if (auto server2 = producer->server.lock())
+                    server2->sendGroupEvent(producer, members, data);
+            });
+        }
+    }, WorkPriority::BACKGROUND);
+}
+
+void Server::sendGroupEvent(
+    const RequestContextPtr& producer,
+    const std::vector<RequestContextPtr>& members,
+    const std::shared_ptr<const std::string>& data)
+{
+    assertIsShardThread(producer->shard);
+
+    if (data)
+        producer->eventRead = producer->lastProduction;
+
+    for (auto& member : members)
+    {
+        member->eventInProgress = false;
+
+        if (!member->isAlive())
+            continue;
+
+        // Producer has disconnected, the rest produce events on their own
+        if (!data)
+        {
+            produceAndSendEvent(member);
+            continue;
+        }
+
+        member->eventState = producer->lastProduction;
+
+        if (member != producer)
+            member->metrics()->sharedEvents.increment();
+
+        ResponseSender(member->corereq).sendSerializedEvent(*data);
+        updateBodySize(member.get());
+    }
+}
+
+void Server::updateBodySize(RequestContext* context)
+{
+    size_t bodySize = context->isAlive() ? context->corereq->pendingBodySize() : 0;
+
+    auto delta = static_cast<int64_t>(bodySize) - static_cast<int64_t>(context->reportedBodySize);
+    if (delta != 0)
+        context->metrics()->pendingBodySize.add(delta);
+
+    context->reportedBodySize = bodySize;
 }
 
 void Server::sendResponse(RequestContextPtr context)
 {
-    assertIsServerThread();
+    assertIsShardThread(context->shard);
+
+    releaseAdmission(context.get());
 
     if (!context->isAlive())
+    {
+        completeCoalescing(context.get(), [] { return CoalescedResponsePtr(); });
         return;
+    }
+
+    auto startTime = MetricsClock::now();
+    auto response = ResponseSender(context->corereq).build(context->response());
+
+    context->responseSentAt = MetricsClock::now();
+    context->metrics()->phase(RequestPhase::SERIALIZE).record(context->responseSentAt - startTime);
+
+    completeCoalescing(context.get(), [&response] { return CoalescedResponse::capture(*response); });
 
-    ResponseSender(context->corereq).send(context->response());
+    context->corereq->sendResponse(std::move(response));
 }
 
 void Server::processResponse(RequestContextPtr context)
@@ -148,14 +614,23 @@ void Server::processResponse(RequestContextPtr context)
         return;
     }
 
-    config_->filters.endRequest(&context->request);
+    auto startTime = MetricsClock::now();
+    context->config->filters.endRequest(&context->request);
+    context->filtersTime += MetricsClock::now() - startTime;
+    context->metrics()->phase(RequestPhase::FILTERS).record(context->filtersTime);
 
     if (auto eventStreamResponse = dynamic_cast<EventStreamResponse*>(context->response()))
     {
         context->eventStreamResponse = eventStreamResponse;
         produceEvent(context.get());
 
-        core_->workQueue()->enqueue([context] {
+        if (isShardThread(context->shard))
+        {
+            beginSendEventStream(std::move(context));
+            return;
+        }
+
+        shardQueue(context)->enqueue([context] {
             if (auto server = context->server.lock())
                 server->beginSendEventStream(context);
         });
@@ -163,7 +638,13 @@ void Server::processResponse(RequestContextPtr context)
         return;
     }
 
-    core_->workQueue()->enqueue([context] {
+    if (isShardThread(context->shard))
+    {
+        sendResponse(std::move(context));
+        return;
+    }
+
+    shardQueue(context)->enqueue([context] {
         if (auto server = context->server.lock())
             server->sendResponse(context);
     });
@@ -171,15 +652,47 @@ void Server::processResponse(RequestContextPtr context)
 
 void Server::beginSendEventStream(RequestContextPtr context)
 {
-    assertIsServerThread();
+    assertIsShardThread(context->shard);
+
+    releaseAdmission(context.get());
+
+    // Event streams could not be shared, followers open their own streams
+    completeCoalescing(context.get(), [] { return CoalescedResponsePtr(); });
 
     if (!context->isAlive())
         return;
 
-    eventStreamContexts_.emplace(context->corereq, context);
+    // Stream could have been started by previous config while reconfiguring
+    if (context->config->requiresReauthorization(*std::atomic_load(&config_)))
+    {
+        context->corereq->abort();
+        return;
+    }
+
+    shards_[context->shard].eventStreamContexts.emplace(context->corereq, context);
+    context->metrics()->eventStreams.add(1);
+
+    context->eventState = context->lastProduction;
+    context->eventRead = context->lastProduction;
+
+    if (context->eventStreamResponse->shareable)
+        context->eventGroupKey = RequestCoalescer::makeKey(&context->request);
+
+    auto period = context->eventStreamResponse->period;
+
+    if (period > DurationMs::zero())
+    {
+        // Timer is destroyed when request is done, it never outlives the request or this server
+        auto corereq = context->corereq;
+        context->eventTimer = core_->shardTimerFactory(context->shard)->createTimer();
+        context->eventTimer->setCallback([this, corereq](Timer*) { produceScheduledEvent(corereq); });
+        context->eventTimer->runPeriodic(period);
+    }
 
     ResponseSender(context->corereq).sendEventStream(
-        context->eventStreamResponse, std::move(context->lastEvent));
+        context->eventStreamResponse, std::move(context->lastEvent), context->lastEventId);
+
+    updateBodySize(context.get());
 }
 
 void Server::dispatchEvents()
@@ -199,18 +712,130 @@ void Server::doDispatchEvents()
     dispatchEventsRequested_.store(false);
     dispatchEventsTimer_->runOnce(pingEventPeriod());
 
-    for (auto& pair : eventStreamContexts_)
-        produceAndSendEvent(pair.second);
+    dispatchShardEvents(0);
+
+    std::weak_ptr<Server> thisWeak = shared_from_this();
+
+    for (size_t i = 1; i < shards_.size(); i++)
+    {
+        shards_[i].workQueue->enqueue([thisWeak, i] {
+            if (auto server = thisWeak.lock())
+                server->dispatchShardEvents(i);
+        });
+    }
+}
+
+void Server::dispatchShardEvents(size_t shard)
+{
+    assertIsShardThread(shard);
+
+    auto now = steadyTime();
+    std::vector<RequestContextPtr> stalled;
+    std::vector<RequestContextPtr> grouped;
+
+    for (auto& pair : shards_[shard].eventStreamContexts)
+    {
+        auto& context = pair.second;
+
+        updateBodySize(context.get());
+
+        if (context->eventInProgress || context->corereq->pendingBodySize() > 0)
+        {
+            context->eventDeferred = true;
+
+            if (context->eventInProgress)
+                continue;
+
+            if (context->stalledSince == TimePointMs())
+                context->stalledSince = now;
+            else if (now - context->stalledSince >= eventStreamStallTimeout())
+                stalled.push_back(context);
+
+            continue;
+        }
+
+        context->eventDeferred = false;
+
+        if (context->eventGroupKey.empty())
+            produceAndSendEvent(context);
+        else
+            grouped.push_back(context);
+    }
+
+    dispatchGroupEvents(std::move(grouped));
+
+    for (auto& context : stalled)
+    {
+        logError(
+            "dropping stalled event stream with %s bytes pending",
+            toString(context->corereq->pendingBodySize()).c_str());
+
+        context->corereq->abort();
+    }
+}
+
+void Server::dispatchGroupEvents(std::vector<RequestContextPtr> contexts)
+{
+    std::sort(contexts.begin(), contexts.end(), isEventGroupBefore);
+
+    for (auto first = contexts.begin(); first != contexts.end(); )
+    {
+        auto last = std::find_if(first + 1, contexts.end(), [&first](const RequestContextPtr& context) {
+            return !isSameEventGroup(*first, context);
+        });
+
+        // Producer should have read changes before any member has received its state.
+        // Such member always exists, e.g. the one with the oldest state. Among these members
+        // the one which has read changes most recently is chosen to keep the event small.
+        auto oldestState = std::min_element(first, last, [](const RequestContextPtr& lhs, const RequestContextPtr& rhs) {
+            return lhs->eventState.begin < rhs->eventState.begin;
+        });
+
+        RequestContextPtr producer;
+
+        for (auto it = first; it != last; ++it)
+        {
+            if (canReceiveEventOf(oldestState->get(), it->get())
+                && (!producer || producer->eventRead.begin < (*it)->eventRead.begin))
+            {
+                producer = *it;
+            }
+        }
+
+        assert(producer);
+
+        std::vector<RequestContextPtr> members;
+
+        for (auto it = first; it != last; ++it)
+        {
+            if (*it == producer || canReceiveEventOf(it->get(), producer.get()))
+                members.push_back(*it);
+            else
+                produceAndSendEvent(*it);
+        }
+
+        produceAndSendGroupEvent(std::move(producer), std::move(members));
+
+        first = last;
+    }
 }
 
 RequestContextPtr Server::createContext(RequestCore* corereq)
 {
-    auto context = std::make_shared<RequestContext>();
+    auto startTime = MetricsClock::now();
+
+    auto arena = corereq->arena();
+    auto context = std::allocate_shared<RequestContext>(ArenaAllocator<RequestContext>(arena));
     context->corereq = corereq;
+    context->shard = corereq->shard();
+    context->config = config();
     context->server = shared_from_this();
 
     auto* request = &context->request;
+    request->message = corereq->message();
     request->method = corereq->method();
+    request->arena = arena;
+    request->cancellation = std::allocate_shared<CancellationToken>(ArenaAllocator<CancellationToken>(arena));
 
     if (request->method == HttpMethod::UNDEFINED)
     {
@@ -219,11 +844,9 @@ RequestContextPtr Server::createContext(RequestCore* corereq)
         return context;
     }
 
-    request->path = corereq->path();
-    request->headers = corereq->headers();
-    request->queryParams = corereq->queryParams();
+    request->path = urlDecode(request->message->path());
 
-    auto body = corereq->body();
+    auto body = request->message->body();
 
     if (!body.empty())
     {
@@ -239,16 +862,26 @@ RequestContextPtr Server::createContext(RequestCore* corereq)
         }
     }
 
-    auto routeResult = config_->router.dispatch(request);
+    auto metrics = context->metrics();
+    auto routeStartTime = MetricsClock::now();
+    metrics->phase(RequestPhase::PARSE).record(routeStartTime - startTime);
+
+    auto routeResult = context->config->router.dispatch(request);
 
     if (auto factory = routeResult->factory)
     {
+        context->factory = factory;
         request->handler = factory->createHandler(request);
         assert(request->handler);
 
         context->workQueue = factory->workQueue();
+        context->priority = factory->priority();
+
         if (context->workQueue == nullptr)
-            context->workQueue = core_->workQueue();
+        {
+            context->workQueue = shardQueue(context);
+            context->runInline = true;
+        }
 
         request->routeParams = std::move(routeResult->params);
     }
@@ -258,6 +891,8 @@ RequestContextPtr Server::createContext(RequestCore* corereq)
         request->setProcessed();
     }
 
+    metrics->phase(RequestPhase::ROUTE).record(MetricsClock::now() - routeStartTime);
+
     return context;
 }
 
@@ -8,10 +8,14 @@
 #include "timers.hpp"
 #include "request_filter.hpp"
 #include "router.hpp"
+#include "metrics.hpp"
+#include "request_coalescer.hpp"
 
 #include <atomic>
 #include <memory>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/thread/future.hpp>
 
@@ -27,49 +31,144 @@ struct RequestContext;
 
 using ServerPtr = std::shared_ptr<Server>;
 using ServerConfigPtr = std::unique_ptr<ServerConfig>;
+using ServerConfigConstPtr = std::shared_ptr<const ServerConfig>;
 using RequestContextPtr = std::shared_ptr<RequestContext>;
 
 class ServerConfig
 {
 public:
-    ServerConfig(int portVal, bool allowRemoteVal);
+    ServerConfig(int portVal, bool allowRemoteVal, int ioThreadsVal = 1);
     ~ServerConfig();
 
+    // Server should be restarted if listeners or threads are different,
+    // otherwise new config could be applied to running server
+    bool requiresRestart(const ServerConfig& next) const;
+
+    // Requests which outlive reconfiguring (event streams, WebSocket sessions) have passed
+    // filters of this config, they should be closed if access rules are different
+    bool requiresReauthorization(const ServerConfig& next) const;
+
     const int port;
     const bool allowRemote;
+    const int ioThreads;
+    std::string localSocket;
+
+    // Limits of requests waiting in a single work queue and requests
+    // being processed by a single route, zero means no limit
+    size_t maxQueuedRequests;
+    size_t maxRouteRequests;
+
+    ConnectionLimits connectionLimits;
 
     Router router;
     RequestFilterChain filters;
 
+    // Identifies authentication and permission settings applied by filters and routes
+    uint64_t accessPolicy;
+
+    // Shared between configs to keep collecting metrics after reconfiguring or restarting server
+    ServerMetricsPtr metrics;
+
 private:
     MSRV_NO_COPY_AND_ASSIGN(ServerConfig);
 };
 
+// Single invocation of event source, tickets are taken right before and after the call
+struct EventProduction
+{
+    EventProduction()
+        : begin(0), end(0)
+    {
+    }
+
+    uint64_t begin;
+    uint64_t end;
+};
+
 struct RequestContext
 {
     RequestContext()
         : corereq(nullptr),
+          shard(0),
+          factory(nullptr),
           workQueue(nullptr),
-          eventStreamResponse(nullptr)
+          priority(WorkPriority::INTERACTIVE),
+          runInline(false),
+          admitted(false),
+          eventStreamResponse(nullptr),
+          eventInProgress(false),
+          eventDeferred(false),
+          stalledSince(),
+          filtersTime(0),
+          reportedBodySize(0)
     {
     }
 
     RequestCore* corereq;
+    size_t shard;
+    ServerConfigConstPtr config;
     Request request;
     std::weak_ptr<Server> server;
+    RequestHandlerFactory* factory;
     WorkQueue* workQueue;
+    WorkPriority priority;
+    bool runInline;
+
+    // Request is counted by route admission limit until response is ready
+    bool admitted;
+
+    // Non-empty if identical requests could receive response of this one
+    std::string coalescingKey;
     EventStreamResponse* eventStreamResponse;
     Json lastEvent;
-
+    std::string lastEventId;
+    EventProduction lastProduction;
+
+    // Non-empty if events could be produced once for all streams with the same key and config.
+    // Group event covers changes since producer has read its source, so it is sent only to streams
+    // which have received their state later; eventState and eventRead track these points.
+    std::string eventGroupKey;
+    EventProduction eventState;
+    EventProduction eventRead;
+
+    // Events are not produced while the previous one is not written to the client.
+    // Event sources accumulate changes, so the next event sent includes all of them.
+    bool eventInProgress;
+    bool eventDeferred;
+    TimePointMs stalledSince;
+
+    // Produces periodic events, runs on shard thread
+    TimerPtr eventTimer;
+
+    // Timings of request phases which span several calls
+    MetricsClock::time_point enqueuedAt;
+    MetricsClock::time_point responseSentAt;
+    MetricsClock::duration filtersTime;
+
+    // Pending body size accounted in metrics
+    size_t reportedBodySize;
+
+    // Should be checked only on shard thread
     bool isAlive() const
     {
         return corereq != nullptr;
     }
 
+    // Could be checked on any thread
+    bool isCancelled() const
+    {
+        return request.cancellation->isCancelled();
+    }
+
     Response* response()
     {
         return request.response.get();
     }
+
+    ServerMetrics* metrics() const
+    {
+        return config->metrics.get();
+    }
 };
 
 class Server
@@ -87,15 +186,21 @@ public:
         return DurationMs(20);
     }
 
-    Server(ServerCorePtr core, ServerConfigPtr config);
-    ~Server();
+    static DurationMs eventStreamStallTimeout()
+    {
+        return std::chrono::seconds(60);
+    }
 
-    void run()
+    static std::chrono::seconds overloadRetryAfter()
     {
-        threadId_ = std::this_thread::get_id();
-        core_->run();
+        return std::chrono::seconds(1);
     }
 
+    Server(ServerCorePtr core, ServerConfigPtr config);
+    ~Server();
+
+    void run();
+
     void exit()
     {
         core_->exit();
@@ -103,12 +208,32 @@ public:
 
     void dispatchEvents();
 
+    ServerConfigConstPtr config() const
+    {
+        return std::atomic_load(&config_);
+    }
+
+    void reconfigure(ServerConfigPtr config);
+
     boost::unique_future<void> destroyed()
     {
         return destroyed_.get_future();
     }
 
 private:
+    struct Shard
+    {
+        Shard()
+            : workQueue(nullptr)
+        {
+        }
+
+        WorkQueue* workQueue;
+        std::unordered_map<RequestCore*, RequestContextPtr> contexts;
+        std::unordered_map<RequestCore*, RequestContextPtr> eventStreamContexts;
+        std::thread::id threadId;
+    };
+
     static void produceEvent(RequestContext* context);
 
     RequestContextPtr createContext(RequestCore* corereq);
@@ -116,34 +241,65 @@ private:
     void sendEvent(RequestContextPtr context);
     void sendResponse(RequestContextPtr context);
 
+    bool tryCoalesceRequest(const RequestContextPtr& context);
+    void completeCoalescing(RequestContext* context, const RequestCoalescer::ResponseCapture& capture);
+    void sendCoalescedResponse(RequestContextPtr context, CoalescedResponsePtr response);
+
+    bool admitRequest(RequestContextPtr context);
+    void startRequest(RequestContextPtr context);
     void runHandlerAndProcessResponse(RequestContextPtr context);
+    void dropCancelledRequest(RequestContextPtr context);
+    void rejectRequest(RequestContextPtr context, Counter* counter);
+    void releaseAdmission(RequestContext* context);
     void processResponse(RequestContextPtr request);
 
     void doDispatchEvents();
+    void dispatchShardEvents(size_t shard);
+    void abortUnauthorizedStreams(size_t shard);
+    void dispatchGroupEvents(std::vector<RequestContextPtr> contexts);
     void beginSendEventStream(RequestContextPtr context);
     void produceAndSendEvent(RequestContextPtr context);
+    void produceScheduledEvent(RequestCore* corereq);
+    void produceAndSendGroupEvent(RequestContextPtr producer, std::vector<RequestContextPtr> members);
+    void sendGroupEvent(
+        const RequestContextPtr& producer,
+        const std::vector<RequestContextPtr>& members,
+        const std::shared_ptr<const std::string>& data);
+    void updateBodySize(RequestContext* context);
 
     virtual void onRequestReady(RequestCore* corereq) override;
     virtual void onRequestDone(RequestCore* corereq) override;
+    virtual void onRequestBodyDrained(RequestCore* corereq) override;
 
     void registerContext(RequestContextPtr context)
     {
         auto evreq = context->corereq;
-        contexts_.emplace(evreq, std::move(context));
+        context->metrics()->activeRequests.add(1);
+        shards_[context->shard].contexts.emplace(evreq, std::move(context));
+    }
+
+    WorkQueue* shardQueue(const RequestContextPtr& context)
+    {
+        return shards_[context->shard].workQueue;
+    }
+
+    bool isShardThread(size_t shard) const
+    {
+        return shards_[shard].threadId == std::this_thread::get_id();
     }
 
-    void assertIsServerThread()
+    void assertIsShardThread(size_t shard)
     {
-        assert(threadId_ == std::this_thread::get_id());
+        assert(shards_[shard].threadId == std::this_thread::get_id());
+        (void) shard;
     }
 
     ServerCorePtr core_;
-    ServerConfigPtr config_;
-    std::unordered_map<RequestCore*, RequestContextPtr> contexts_;
-    std::unordered_map<RequestCore*, RequestContextPtr> eventStreamContexts_;
+    ServerConfigConstPtr config_;
+    std::vector<Shard> shards_;
     std::atomic_bool dispatchEventsRequested_;
     TimerPtr dispatchEventsTimer_;
-    std::thread::id threadId_;
+    RequestCoalescer coalescer_;
     boost::promise<void> destroyed_;
 
     MSRV_NO_COPY_AND_ASSIGN(Server);
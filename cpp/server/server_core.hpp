@@ -4,6 +4,8 @@
 #include "http.hpp"
 #include "system.hpp"
 #include "string_utils.hpp"
+#include "request_arena.hpp"
+#include "chrono.hpp"
 
 #include <string>
 #include <vector>
@@ -26,12 +28,34 @@ class ResponseCore;
 class RequestEventListener;
 
 using ServerCorePtr = std::unique_ptr<ServerCore>;
-using ResponseCorePtr = std::unique_ptr<ResponseCore>;
+using ResponseCorePtr = ArenaPtr<ResponseCore>;
+
+// Limits of client connections, zero disables corresponding limit
+struct ConnectionLimits
+{
+    ConnectionLimits()
+        : idleTimeout(DurationMs::zero()),
+          headerTimeout(DurationMs::zero()),
+          bodyTimeout(DurationMs::zero()),
+          maxConnections(0)
+    {
+    }
+
+    // Time to wait for the next request on keep-alive connection
+    DurationMs idleTimeout;
+
+    // Time to receive request headers and request body after the first byte of request
+    DurationMs headerTimeout;
+    DurationMs bodyTimeout;
+
+    // When reached, new connections are not accepted until the oldest idle connection is closed
+    size_t maxConnections;
+};
 
 class ServerCore
 {
 public:
-    static ServerCorePtr create();
+    static ServerCorePtr create(size_t ioThreads = 1);
 
     ServerCore() = default;
     virtual ~ServerCore() = default;
@@ -39,8 +63,25 @@ public:
     virtual WorkQueue* workQueue() = 0;
     virtual TimerFactory* timerFactory() = 0;
 
+    // Connections are distributed over shards, each shard is served by its own thread.
+    // Requests of a shard are reported and should be responded on that shard's queue.
+    // workQueue() is the queue of shard 0 which also runs timers.
+    virtual size_t shardCount() = 0;
+    virtual WorkQueue* shardWorkQueue(size_t shard) = 0;
+
+    // Timers of this factory run on shard thread, they should be created and used only there
+    virtual TimerFactory* shardTimerFactory(size_t shard) = 0;
+
     virtual void setEventListener(RequestEventListener* listener) = 0;
+
+    // Could be called from any thread, applies to existing connections too
+    virtual void setConnectionLimits(const ConnectionLimits& limits) = 0;
+
+    // Could be called from any thread, requests of closed sessions are reported as done
+    virtual void closeWebSockets() = 0;
+
     virtual void bind(int port, bool allowRemote) = 0;
+    virtual void bindLocal(const std::string& path) = 0;
     virtual void run() = 0;
     virtual void exit() = 0;
 
@@ -93,18 +134,21 @@ private:
 class RequestCore
 {
 public:
+    virtual size_t shard() = 0;
     virtual HttpMethod method() = 0;
-    virtual std::string path() = 0;
-    virtual HttpKeyValueMap headers() = 0;
-    virtual HttpKeyValueMap queryParams() = 0;
-    virtual StringView body() = 0;
+    virtual RequestMessagePtr message() = 0;
     virtual void releaseResources() = 0;
 
+    // Memory arena for objects of this request (could be null).
+    // Objects could be allocated only on shard thread until request is done.
+    virtual RequestArena* arena() = 0;
+
     virtual void abort() = 0;
 
     virtual void sendResponse(ResponseCorePtr response) = 0;
     virtual void sendResponseBegin(ResponseCorePtr response) = 0;
     virtual void sendResponseBody(ResponseCore::Body body) = 0;
+    virtual size_t pendingBodySize() = 0;
     virtual void sendResponseEnd() = 0;
 
 protected:
@@ -121,6 +165,9 @@ public:
     virtual void onRequestReady(RequestCore* request) = 0;
     virtual void onRequestDone(RequestCore* request) = 0;
 
+    // All response body data passed so far has been written to the client
+    virtual void onRequestBodyDrained(RequestCore* request) = 0;
+
 protected:
     RequestEventListener() = default;
     ~RequestEventListener() = default;
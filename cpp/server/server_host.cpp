@@ -12,21 +12,64 @@
 #include "response_headers_filter.hpp"
 #include "client_config_controller.hpp"
 #include "outputs_controller.hpp"
+#include "metrics_controller.hpp"
+#include "fnv_hash.hpp"
 #include "log.hpp"
 
+#include <algorithm>
+#include <thread>
+
 namespace msrv {
 
+namespace {
+
+size_t utilityThreadLimit(const SettingsData& settings)
+{
+    if (settings.maxUtilityThreads > 0)
+        return static_cast<size_t>(settings.maxUtilityThreads);
+
+    // File system requests mostly wait for I/O, so there could be more threads than cores
+    auto cores = static_cast<size_t>(std::thread::hardware_concurrency());
+    return std::min(std::max(cores * 2, size_t(2)), size_t(MSRV_MAX_UTILITY_THREADS));
+}
+
+uint64_t accessPolicy(const SettingsData& settings)
+{
+    FnvHash hash;
+    hash.addValue(settings.authRequired);
+    hash.addValue(static_cast<uint32_t>(settings.permissions));
+
+    if (settings.authRequired)
+    {
+        hash.addBytes(settings.authUser.data(), settings.authUser.size());
+        hash.addValue('\0');
+        hash.addBytes(settings.authPassword.data(), settings.authPassword.size());
+    }
+
+    return hash.value();
+}
+
+}
+
 ServerHost::ServerHost(Player* player)
-    : player_(player), utilityQueue_(8, MSRV_THREAD_NAME("io"))
+    : player_(player),
+      metrics_(std::make_shared<ServerMetrics>()),
+      utilityQueue_(1, MSRV_MAX_UTILITY_THREADS, MSRV_THREAD_NAME("io"))
 {
-    playerWorkQueue_ = player_->createWorkQueue();
+    utilityQueue_.setWorkerGauge(&metrics_->utilityThreads);
+
+    // Player commands should not wait for large responses and event stream updates
+    playerWorkQueue_ = std::make_unique<PriorityWorkQueue>(player_->createWorkQueue());
     player_->onEvents([this](PlayerEvents event) { handlePlayerEvents(event); });
+    player_->onPlaylistItemsChanged([this](const PlaylistItemsChange& change) { handlePlaylistItemsChange(change); });
     serverThread_ = std::make_unique<ServerThread>();
 }
 
 ServerHost::~ServerHost()
 {
+    configWatcher_.reset();
     player_->onEvents(PlayerEventsCallback());
+    player_->onPlaylistItemsChanged(PlaylistItemsChangeCallback());
 }
 
 void ServerHost::handlePlayerEvents(PlayerEvents events)
@@ -35,9 +78,67 @@ void ServerHost::handlePlayerEvents(PlayerEvents events)
     serverThread_->dispatchEvents();
 }
 
+void ServerHost::handlePlaylistItemsChange(const PlaylistItemsChange& change)
+{
+    dispatcher_.dispatch(change);
+    serverThread_->dispatchEvents();
+}
+
 void ServerHost::reconfigure(SettingsDataPtr settings)
 {
-    auto config = std::make_unique<ServerConfig>(settings->port, settings->allowRemote);
+    // Previous watcher is destroyed after unlocking, it might be waiting for the lock in reloadSettings()
+    std::unique_ptr<FileWatcher> previousWatcher;
+
+    std::lock_guard<std::mutex> lock(settingsMutex_);
+
+    bool watch = settings->source && !settings->configFile.empty();
+
+    if (configWatcher_ && (!watch || configWatcher_->path() != settings->configFile))
+        previousWatcher = std::move(configWatcher_);
+
+    if (watch && !configWatcher_)
+    {
+        configWatcher_ = std::make_unique<FileWatcher>(
+            settings->configFile, [this] { reloadSettings(); });
+    }
+
+    applySettings(std::move(settings));
+}
+
+void ServerHost::reloadSettings()
+{
+    std::shared_ptr<const SettingsBuilder> source;
+
+    {
+        std::lock_guard<std::mutex> lock(settingsMutex_);
+        source = settings_->source;
+    }
+
+    auto settings = source->build();
+
+    std::lock_guard<std::mutex> lock(settingsMutex_);
+
+    // Settings could have been replaced by player while config file was loading
+    if (settings_->source == source)
+        applySettings(std::move(settings));
+}
+
+void ServerHost::applySettings(SettingsDataPtr settings)
+{
+    settings_ = settings;
+
+    utilityQueue_.setMaxWorkers(utilityThreadLimit(*settings));
+
+    auto config = std::make_unique<ServerConfig>(settings->port, settings->allowRemote, settings->ioThreads);
+    config->localSocket = settings->localSocket.string();
+    config->maxQueuedRequests = static_cast<size_t>(settings->maxQueuedRequests);
+    config->maxRouteRequests = static_cast<size_t>(settings->maxRouteRequests);
+    config->connectionLimits.idleTimeout = std::chrono::seconds(settings->connectionIdleTimeout);
+    config->connectionLimits.headerTimeout = std::chrono::seconds(settings->requestHeaderTimeout);
+    config->connectionLimits.bodyTimeout = std::chrono::seconds(settings->requestBodyTimeout);
+    config->connectionLimits.maxConnections = static_cast<size_t>(settings->maxConnections);
+    config->accessPolicy = accessPolicy(*settings);
+    config->metrics = metrics_;
 
     auto router = &config->router;
     auto filters = &config->filters;
@@ -65,6 +166,7 @@ void ServerHost::reconfigure(SettingsDataPtr settings)
     BrowserController::defineRoutes(router, &utilityQueue_, settings);
     StaticController::defineRoutes(router, &utilityQueue_, settings, contentTypes_);
     ClientConfigController::defineRoutes(router, &utilityQueue_, settings);
+    MetricsController::defineRoutes(router, metrics_);
 
     serverThread_->restart(std::move(config));
 }
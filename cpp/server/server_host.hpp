@@ -9,8 +9,10 @@
 #include "settings.hpp"
 #include "work_queue.hpp"
 #include "request_filter.hpp"
+#include "file_watcher.hpp"
 
 #include <memory>
+#include <mutex>
 
 namespace msrv {
 
@@ -24,16 +26,24 @@ public:
 
 private:
     void handlePlayerEvents(PlayerEvents events);
+    void handlePlaylistItemsChange(const PlaylistItemsChange& change);
+    void reloadSettings();
+    void applySettings(SettingsDataPtr settings);
 
     Player* player_;
 
     EventDispatcher dispatcher_;
     ContentTypeMap contentTypes_;
+    ServerMetricsPtr metrics_;
 
     std::unique_ptr<WorkQueue> playerWorkQueue_;
-    ThreadPoolWorkQueue utilityQueue_;
+    WorkStealingWorkQueue utilityQueue_;
     std::unique_ptr<ServerThread> serverThread_;
 
+    std::mutex settingsMutex_;
+    SettingsDataPtr settings_;
+    std::unique_ptr<FileWatcher> configWatcher_;
+
     MSRV_NO_COPY_AND_ASSIGN(ServerHost);
 };
 
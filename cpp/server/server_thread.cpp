@@ -25,6 +25,26 @@ ServerThread::~ServerThread()
     }
 }
 
+void ServerThread::restart(ServerConfigPtr config)
+{
+    ServerPtr server;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (server_ && command_ == Command::NONE && !server_->config()->requiresRestart(*config))
+            server = server_;
+    }
+
+    if (server)
+    {
+        server->reconfigure(std::move(config));
+        return;
+    }
+
+    sendCommand(Command::RESTART, std::move(config));
+}
+
 void ServerThread::dispatchEvents()
 {
     ServerPtr server;
@@ -77,7 +97,8 @@ void ServerThread::runOnce(ServerConfigPtr config)
     ServerPtr server;
 
     tryCatchLog([&config, &server] {
-        server = std::make_shared<Server>(ServerCore::create(), std::move(config));
+        auto core = ServerCore::create(static_cast<size_t>(config->ioThreads));
+        server = std::make_shared<Server>(std::move(core), std::move(config));
     });
 
     if (!server)
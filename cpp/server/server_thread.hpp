@@ -18,10 +18,8 @@ public:
     ServerThread(ServerReadyCallback readyCallback = ServerReadyCallback());
     ~ServerThread();
 
-    void restart(ServerConfigPtr config)
-    {
-        sendCommand(Command::RESTART, std::move(config));
-    }
+    // Applies config to running server if possible, restarts server otherwise
+    void restart(ServerConfigPtr config);
 
     void dispatchEvents();
 
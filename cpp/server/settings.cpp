@@ -7,6 +7,7 @@
 #define MSRV_CONFIG_FILE        "config.json"
 #define MSRV_CLIENT_CONFIG_DIR  "clientconfig"
 #define MSRV_ALT_WEB_ROOT       "webroot"
+#define MSRV_MAX_IO_THREADS     64
 
 namespace msrv {
 
@@ -193,12 +194,69 @@ void parseUrlMappings(const Json& json, const Path& baseDir, std::unordered_map<
     *result = std::move(urlMappingsResult);
 }
 
+void parseIoThreads(const Json& json, int* result)
+{
+    int ioThreads;
+
+    if (!parseValue(json, "ioThreads", &ioThreads))
+        return;
+
+    if (ioThreads < 1 || ioThreads > MSRV_MAX_IO_THREADS)
+    {
+        logError("property 'ioThreads' should be in range [1, %d]", MSRV_MAX_IO_THREADS);
+        return;
+    }
+
+    *result = ioThreads;
+}
+
+void parseUtilityThreads(const Json& json, int* result)
+{
+    int utilityThreads;
+
+    if (!parseValue(json, "maxUtilityThreads", &utilityThreads))
+        return;
+
+    if (utilityThreads < 0 || utilityThreads > MSRV_MAX_UTILITY_THREADS)
+    {
+        logError("property 'maxUtilityThreads' should be in range [0, %d]", MSRV_MAX_UTILITY_THREADS);
+        return;
+    }
+
+    *result = utilityThreads;
+}
+
+void parseLimit(const Json& json, const char* name, int* result)
+{
+    int limit;
+
+    if (!parseValue(json, name, &limit))
+        return;
+
+    if (limit < 0)
+    {
+        logError("property '%s' should be non-negative", name);
+        return;
+    }
+
+    *result = limit;
+}
+
 void processFile(const Path& baseDir, const Path& file, SettingsData* settings)
 {
     const auto json = readJsonFile(file);
 
     parseValue(json, "port", &settings->port);
     parseValue(json, "allowRemote", &settings->allowRemote);
+    parseIoThreads(json, &settings->ioThreads);
+    parseUtilityThreads(json, &settings->maxUtilityThreads);
+    parsePath(json, "localSocket", baseDir, &settings->localSocket);
+    parseLimit(json, "maxQueuedRequests", &settings->maxQueuedRequests);
+    parseLimit(json, "maxRouteRequests", &settings->maxRouteRequests);
+    parseLimit(json, "maxConnections", &settings->maxConnections);
+    parseLimit(json, "connectionIdleTimeout", &settings->connectionIdleTimeout);
+    parseLimit(json, "requestHeaderTimeout", &settings->requestHeaderTimeout);
+    parseLimit(json, "requestBodyTimeout", &settings->requestBodyTimeout);
     parseValue(json, "authRequired", &settings->authRequired);
     parseValue(json, "authUser", &settings->authUser);
     parseValue(json, "authPassword", &settings->authPassword);
@@ -305,7 +363,10 @@ SettingsDataPtr SettingsBuilder::build() const
     settings->clientConfigDir = pluginProfileDir / MSRV_PATH_LITERAL(MSRV_CLIENT_CONFIG_DIR);
     settings->musicDirs = resolveMusicDirs(pluginProfileDir, musicDirs);
 
-    processFile(pluginProfileDir, pluginProfileDir / MSRV_PATH_LITERAL(MSRV_CONFIG_FILE), settings.get());
+    settings->configFile = pluginProfileDir / MSRV_PATH_LITERAL(MSRV_CONFIG_FILE);
+    settings->source = std::make_shared<SettingsBuilder>(*this);
+
+    processFile(pluginProfileDir, settings->configFile, settings.get());
 
     tryCatchLog([&] { fs::create_directories(settings->altWebRoot); });
     tryCatchLog([&] { fs::create_directories(settings->clientConfigDir); });
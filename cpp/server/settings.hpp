@@ -11,6 +11,8 @@
 #include <memory>
 #include <unordered_map>
 
+#define MSRV_MAX_UTILITY_THREADS 64
+
 namespace msrv {
 
 enum class ApiPermissions : uint32_t
@@ -30,6 +32,8 @@ void to_json(Json& json, const ApiPermissions& permissions);
 void migrateSettings(const char* appName, const Path& profileDir);
 #endif
 
+class SettingsBuilder;
+
 class SettingsData
 {
 public:
@@ -38,6 +42,15 @@ public:
 
     int port = MSRV_DEFAULT_PORT;
     bool allowRemote = true;
+    int ioThreads = 1;
+    int maxUtilityThreads = 0;
+    Path localSocket;
+    int maxQueuedRequests = 256;
+    int maxRouteRequests = 32;
+    int maxConnections = 512;
+    int connectionIdleTimeout = 60;
+    int requestHeaderTimeout = 10;
+    int requestBodyTimeout = 30;
     std::vector<Path> musicDirs;
     bool authRequired = false;
     std::string authUser;
@@ -50,6 +63,10 @@ public:
     std::unordered_map<std::string, std::string> responseHeaders;
     std::unordered_map<std::string, Path> urlMappings;
 
+    // Config file these settings were loaded from and builder to reload them
+    Path configFile;
+    std::shared_ptr<const SettingsBuilder> source;
+
     void ensurePermissions(ApiPermissions p) const
     {
         if (!hasFlags(permissions, p))
@@ -61,6 +61,20 @@ inline char asciiToLower(char ch)
     return ch >= 'A' && ch <= 'Z' ? static_cast<char>(ch - 'A' + 'a') : ch;
 }
 
+inline bool asciiEqualsIgnoreCase(StringView s1, StringView s2)
+{
+    if (s1.size() != s2.size())
+        return false;
+
+    for (size_t i = 0; i < s1.size(); i++)
+    {
+        if (asciiToLower(s1[i]) != asciiToLower(s2[i]))
+            return false;
+    }
+
+    return true;
+}
+
 struct AsciiLowerCaseHash
 {
     size_t operator()(std::string const& str) const
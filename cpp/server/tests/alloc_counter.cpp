@@ -0,0 +1,74 @@
+#include "alloc_counter.hpp"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+namespace msrv {
+
+namespace {
+
+thread_local size_t allocationCount = 0;
+std::atomic<size_t> processAllocationCount{0};
+
+void* countedAlloc(size_t size)
+{
+    allocationCount++;
+    processAllocationCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (auto ptr = ::malloc(size ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+}
+
+AllocationCounter::AllocationCounter(Scope scope)
+    : scope_(scope), start_(current())
+{
+}
+
+size_t AllocationCounter::count() const
+{
+    return current() - start_;
+}
+
+size_t AllocationCounter::current() const
+{
+    return scope_ == Scope::PROCESS
+        ? processAllocationCount.load(std::memory_order_relaxed)
+        : allocationCount;
+}
+
+}
+
+void* operator new(size_t size)
+{
+    return msrv::countedAlloc(size);
+}
+
+void* operator new[](size_t size)
+{
+    return msrv::countedAlloc(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    ::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    ::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    ::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    ::free(ptr);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace msrv {
+
+// Counts heap allocations made while in scope, either by the current thread
+// or by all threads of the process (to account for allocations on server threads).
+// Backed by the global operator new replacement in alloc_counter.cpp.
+class AllocationCounter
+{
+public:
+    enum class Scope
+    {
+        THREAD,
+        PROCESS,
+    };
+
+    explicit AllocationCounter(Scope scope = Scope::THREAD);
+
+    size_t count() const;
+
+private:
+    size_t current() const;
+
+    Scope scope_;
+    size_t start_;
+};
+
+}
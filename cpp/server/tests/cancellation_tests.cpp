@@ -0,0 +1,57 @@
+#include "cancellation.hpp"
+
+#include <catch2/catch.hpp>
+
+namespace msrv {
+namespace cancellation_tests {
+
+TEST_CASE("cancellation token")
+{
+    auto token = std::make_shared<CancellationToken>();
+    int called = 0;
+
+    SECTION("cancel")
+    {
+        CancellationCallback callback(token, [&] { called++; });
+
+        REQUIRE(!token->isCancelled());
+        REQUIRE(called == 0);
+
+        token->cancel();
+        token->cancel();
+
+        REQUIRE(token->isCancelled());
+        REQUIRE(called == 1);
+    }
+
+    SECTION("already cancelled")
+    {
+        token->cancel();
+
+        CancellationCallback callback(token, [&] { called++; });
+
+        REQUIRE(called == 1);
+    }
+
+    SECTION("callback removed")
+    {
+        {
+            CancellationCallback callback(token, [&] { called++; });
+        }
+
+        token->cancel();
+
+        REQUIRE(called == 0);
+    }
+
+    SECTION("null token")
+    {
+        CancellationCallback callback(nullptr, [&] { called++; });
+
+        REQUIRE(!CancellationToken::isCancelled(nullptr));
+        REQUIRE(called == 0);
+    }
+}
+
+}
+}
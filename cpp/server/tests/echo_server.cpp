@@ -22,7 +22,7 @@ protected:
         if (!response)
             return;
 
-        for (auto& pair : request->headers)
+        for (auto& pair : request->headers())
             response->headers.emplace("X-Echo-" + pair.first, pair.second);
     }
 };
@@ -74,8 +74,8 @@ public:
 
         response["method"] = toString(request()->method);
         response["path"] = request()->path;
-        response["headers"] = request()->headers;
-        response["queryParams"] = request()->queryParams;
+        response["headers"] = request()->headers();
+        response["queryParams"] = request()->queryParams();
         response["body"] = request()->postData;
         response["ticks"] = steadyTime().time_since_epoch().count();
 
@@ -86,8 +86,8 @@ public:
 class EchoServer
 {
 public:
-    EchoServer(bool allowRemote, ServerReadyCallback readyCallback)
-        : allowRemote_(allowRemote), thread_(std::move(readyCallback))
+    EchoServer(bool allowRemote, int ioThreads, ServerReadyCallback readyCallback)
+        : allowRemote_(allowRemote), ioThreads_(ioThreads), thread_(std::move(readyCallback))
     {
         restart();
     }
@@ -101,7 +101,7 @@ public:
 
     std::unique_ptr<ServerConfig> buildConfig()
     {
-        auto config = std::make_unique<ServerConfig>(MSRV_DEFAULT_TEST_PORT, allowRemote_);
+        auto config = std::make_unique<ServerConfig>(MSRV_DEFAULT_TEST_PORT, allowRemote_, ioThreads_);
 
         auto router = &config->router;
         auto filters = &config->filters;
@@ -121,6 +121,7 @@ public:
 
 private:
     bool allowRemote_;
+    int ioThreads_;
     ThreadWorkQueue workQueue_;
     ServerThread thread_;
 
@@ -130,6 +131,7 @@ private:
 int testMain(int argc, char** argv)
 {
     bool allowRemote = false;
+    int ioThreads = 1;
 
     for (int i = 1; i < argc; i++)
     {
@@ -137,14 +139,18 @@ int testMain(int argc, char** argv)
         {
             allowRemote = true;
         }
+        else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc && tryParseValue(argv[i + 1], &ioThreads))
+        {
+            i++;
+        }
         else
         {
-            logError("invalid option: %s\n\nusage: echo_server [-remote]", argv[i]);
+            logError("invalid option: %s\n\nusage: echo_server [-remote] [-threads N]", argv[i]);
             return 1;
         }
     }
 
-    EchoServer server(allowRemote, [] {
+    EchoServer server(allowRemote, ioThreads, [] {
         logInfo("server is running");
         logInfo("press q<ENTER> to stop");
         logInfo("press e<ENTER> to dispatch events");
@@ -0,0 +1,50 @@
+#include "file_watcher.hpp"
+
+#include <atomic>
+#include <catch2/catch.hpp>
+
+namespace msrv {
+namespace file_watcher_tests {
+
+namespace {
+
+bool waitForCount(const std::atomic_int& counter, int expected)
+{
+    for (int i = 0; i < 50 && counter.load() < expected; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    return counter.load() == expected;
+}
+
+}
+
+TEST_CASE("file watcher")
+{
+    auto dir = fs::temp_directory_path() / fs::unique_path("beefweb-tests-%%%%-%%%%");
+    fs::create_directories(dir);
+
+    auto path = dir / "config.json";
+    std::atomic_int changes{0};
+
+    {
+        FileWatcher watcher(path, [&] { changes++; }, DurationMs(10));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(changes.load() == 0);
+
+        file_io::write(path, "{}", 2);
+        REQUIRE(waitForCount(changes, 1));
+
+        file_io::write(path, "{\"port\":1}", 10);
+        REQUIRE(waitForCount(changes, 2));
+
+        fs::remove(path);
+        REQUIRE(waitForCount(changes, 3));
+    }
+
+    boost::system::error_code error;
+    fs::remove_all(dir, error);
+}
+
+}
+}
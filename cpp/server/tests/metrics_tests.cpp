@@ -0,0 +1,122 @@
+#include "metrics.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+#include <catch2/catch.hpp>
+
+namespace msrv {
+namespace metrics_tests {
+
+TEST_CASE("histogram")
+{
+    SECTION("buckets are contiguous")
+    {
+        REQUIRE(HistogramSnapshot::bucketLowerBound(0) == 0);
+
+        for (size_t i = 0; i + 1 < HistogramSnapshot::BUCKET_COUNT; i++)
+        {
+            auto lower = HistogramSnapshot::bucketLowerBound(i);
+            auto upper = HistogramSnapshot::bucketUpperBound(i);
+
+            REQUIRE(lower < upper);
+            REQUIRE(upper == HistogramSnapshot::bucketLowerBound(i + 1));
+            REQUIRE(HistogramSnapshot::bucketIndex(lower) == i);
+            REQUIRE(HistogramSnapshot::bucketIndex(upper - 1) == i);
+        }
+    }
+
+    SECTION("relative error is bounded")
+    {
+        for (uint64_t value : {5u, 100u, 1000u, 123456u, 99999999u})
+        {
+            auto index = HistogramSnapshot::bucketIndex(value);
+            auto width = HistogramSnapshot::bucketUpperBound(index) - HistogramSnapshot::bucketLowerBound(index);
+            REQUIRE(width * 4 <= value);
+        }
+    }
+
+    SECTION("large values go to last bucket")
+    {
+        REQUIRE(HistogramSnapshot::bucketIndex(UINT64_MAX) == HistogramSnapshot::BUCKET_COUNT - 1);
+    }
+
+    SECTION("snapshot")
+    {
+        Histogram histogram;
+
+        for (uint64_t value = 1; value <= 100; value++)
+            histogram.record(value);
+
+        histogram.record(std::chrono::milliseconds(2));
+        histogram.record(std::chrono::nanoseconds(-5));
+
+        auto snapshot = histogram.snapshot();
+        REQUIRE(snapshot.count == 102);
+        REQUIRE(snapshot.sum == 5050 + 2000);
+        REQUIRE(snapshot.countBelow(1) == 1);
+        REQUIRE(snapshot.countBelow(64) == 64);
+        REQUIRE(snapshot.countBelow(128) == 101);
+        REQUIRE(snapshot.percentile(50) == 56);
+        REQUIRE(snapshot.percentile(100) == 2048);
+    }
+}
+
+TEST_CASE("server metrics format")
+{
+    ServerMetrics metrics;
+    metrics.phase(RequestPhase::HANDLER).record(std::chrono::microseconds(10));
+    metrics.phase(RequestPhase::HANDLER).record(std::chrono::seconds(100));
+    metrics.activeRequests.add(3);
+    metrics.activeRequests.add(-1);
+
+    auto text = metrics.format();
+
+    auto contains = [&](const std::string& line) {
+        return text.find(line + "\n") != std::string::npos;
+    };
+
+    REQUIRE(contains("# TYPE beefweb_request_phase_seconds histogram"));
+    REQUIRE(contains("beefweb_request_phase_seconds_bucket{phase=\"handler\",le=\"0.000008\"} 0"));
+    REQUIRE(contains("beefweb_request_phase_seconds_bucket{phase=\"handler\",le=\"0.000016\"} 1"));
+    REQUIRE(contains("beefweb_request_phase_seconds_bucket{phase=\"handler\",le=\"33.554432\"} 1"));
+    REQUIRE(contains("beefweb_request_phase_seconds_bucket{phase=\"handler\",le=\"+Inf\"} 2"));
+    REQUIRE(contains("beefweb_request_phase_seconds_sum{phase=\"handler\"} 100.000010"));
+    REQUIRE(contains("beefweb_request_phase_seconds_count{phase=\"handler\"} 2"));
+    REQUIRE(contains("beefweb_request_phase_seconds_count{phase=\"write\"} 0"));
+    REQUIRE(contains("# TYPE beefweb_active_requests gauge"));
+    REQUIRE(contains("beefweb_active_requests 2"));
+    REQUIRE(contains("beefweb_event_streams 0"));
+}
+
+TEST_CASE("histogram benchmark", "[.][benchmark]")
+{
+    auto threadCount = GENERATE(1, 4);
+    const int recordCount = 10000000;
+
+    Histogram histogram;
+    std::vector<std::thread> threads;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        threads.emplace_back([&histogram, i] {
+            for (int j = 0; j < recordCount; j++)
+                histogram.record(static_cast<uint64_t>((j * 37 + i) % 100000));
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    auto elapsed = std::chrono::steady_clock::now() - startTime;
+    auto nsPerRecord = std::chrono::duration<double, std::nano>(elapsed).count() / recordCount;
+
+    REQUIRE(histogram.snapshot().count == static_cast<uint64_t>(threadCount) * recordCount);
+
+    WARN("record with " << threadCount << " threads: " << nsPerRecord << " ns");
+}
+
+}
+}
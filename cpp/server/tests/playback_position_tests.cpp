@@ -0,0 +1,77 @@
+#include "playback_position.hpp"
+
+#include <atomic>
+#include <thread>
+#include <catch2/catch.hpp>
+
+namespace msrv {
+namespace playback_position_tests {
+
+TEST_CASE("playback position snapshot")
+{
+    PlaybackPositionSnapshot snapshot;
+    auto now = steadyTime();
+
+    SECTION("initial")
+    {
+        auto value = snapshot.read(now);
+        REQUIRE(value.playbackState == PlaybackState::STOPPED);
+        REQUIRE(value.position == 0.0);
+        REQUIRE(value.duration == 0.0);
+    }
+
+    SECTION("playing")
+    {
+        snapshot.update(PlaybackPosition(PlaybackState::PLAYING, 10.0, 60.0), now);
+
+        auto value = snapshot.read(now + DurationMs(2500));
+        REQUIRE(value.playbackState == PlaybackState::PLAYING);
+        REQUIRE(value.position == Approx(12.5));
+        REQUIRE(value.duration == 60.0);
+
+        REQUIRE(snapshot.read(now + DurationMs(100000)).position == 60.0);
+    }
+
+    SECTION("paused")
+    {
+        snapshot.update(PlaybackPosition(PlaybackState::PAUSED, 10.0, 60.0), now);
+
+        auto value = snapshot.read(now + DurationMs(2500));
+        REQUIRE(value.playbackState == PlaybackState::PAUSED);
+        REQUIRE(value.position == 10.0);
+    }
+
+    SECTION("unknown duration")
+    {
+        snapshot.update(PlaybackPosition(PlaybackState::PLAYING, 10.0, -1.0), now);
+        REQUIRE(snapshot.read(now + DurationMs(100000)).position == Approx(110.0));
+    }
+
+    SECTION("concurrent updates")
+    {
+        std::atomic_bool stop(false);
+
+        std::thread writer([&] {
+            for (int i = 0; !stop; i++)
+                snapshot.update(PlaybackPosition(PlaybackState::PAUSED, i, i), now);
+        });
+
+        int inconsistentReads = 0;
+
+        for (int i = 0; i < 100000; i++)
+        {
+            auto value = snapshot.read(now);
+
+            if (value.position != value.duration)
+                inconsistentReads++;
+        }
+
+        stop = true;
+        writer.join();
+
+        REQUIRE(inconsistentReads == 0);
+    }
+}
+
+}
+}
@@ -0,0 +1,169 @@
+#include "player_events.hpp"
+
+#include <catch2/catch.hpp>
+
+namespace msrv {
+namespace player_events_tests {
+
+TEST_CASE("playlist items change")
+{
+    PlaylistItemsChange change(1, "p2");
+
+    SECTION("matches playlist")
+    {
+        change.setItemsModified(0, 0);
+
+        REQUIRE(change.affects(PlaylistRef(1), Range(0, 10)));
+        REQUIRE(change.affects(PlaylistRef("p2"), Range(0, 10)));
+        REQUIRE(change.affects(PlaylistRef("current"), Range(0, 10)));
+        REQUIRE(!change.affects(PlaylistRef(0), Range(0, 10)));
+        REQUIRE(!change.affects(PlaylistRef("p1"), Range(0, 10)));
+    }
+
+    SECTION("modified items")
+    {
+        change.setItemsModified(10, 19);
+
+        REQUIRE(change.affects(PlaylistRef(1), Range(0, 11)));
+        REQUIRE(change.affects(PlaylistRef(1), Range(19, 5)));
+        REQUIRE(change.affects(PlaylistRef(1), Range(12, 2)));
+        REQUIRE(!change.affects(PlaylistRef(1), Range(0, 10)));
+        REQUIRE(!change.affects(PlaylistRef(1), Range(20, 10)));
+        REQUIRE(change.affects(PlaylistRef(1), Range(0, std::numeric_limits<int32_t>::max())));
+    }
+
+    SECTION("shifted items")
+    {
+        change.setItemsShifted(10);
+
+        // Total count is changed
+        REQUIRE(change.affects(PlaylistRef(1), Range(0, 5)));
+        REQUIRE(change.affects(PlaylistRef(1), Range(100, 5)));
+        REQUIRE(!change.affects(PlaylistRef(2), Range(100, 5)));
+    }
+}
+
+TEST_CASE("event dispatcher")
+{
+    EventDispatcher dispatcher;
+
+    auto all = dispatcher.createListener(PlayerEvents::PLAYLIST_ITEMS_CHANGED);
+    auto first = dispatcher.createListener(PlayerEvents::PLAYLIST_ITEMS_CHANGED);
+    auto second = dispatcher.createListener(PlayerEvents::PLAYLIST_ITEMS_CHANGED);
+    auto player = dispatcher.createListener(PlayerEvents::PLAYER_CHANGED);
+
+    first->watchPlaylistItems(PlaylistRef("p1"), Range(0, 10));
+    second->watchPlaylistItems(PlaylistRef("p2"), Range(0, 10));
+
+    // Initial events
+    all->readEvents();
+    first->readEvents();
+    second->readEvents();
+    player->readEvents();
+
+    PlaylistItemsChange change(1, "p2");
+    change.setItemsModified(5, 5);
+    dispatcher.dispatch(change);
+
+    REQUIRE(all->readEvents() == PlayerEvents::PLAYLIST_ITEMS_CHANGED);
+    REQUIRE(first->readEvents() == PlayerEvents::NONE);
+    REQUIRE(second->readEvents() == PlayerEvents::PLAYLIST_ITEMS_CHANGED);
+    REQUIRE(player->readEvents() == PlayerEvents::NONE);
+
+    change.setItemsModified(20, 30);
+    dispatcher.dispatch(change);
+
+    REQUIRE(all->readEvents() == PlayerEvents::PLAYLIST_ITEMS_CHANGED);
+    REQUIRE(second->readEvents() == PlayerEvents::NONE);
+
+    dispatcher.dispatch(PlayerEvents::PLAYLIST_ITEMS_CHANGED);
+
+    REQUIRE(first->readEvents() == PlayerEvents::PLAYLIST_ITEMS_CHANGED);
+    REQUIRE(second->readEvents() == PlayerEvents::PLAYLIST_ITEMS_CHANGED);
+}
+
+TEST_CASE("event listener resume")
+{
+    EventDispatcher dispatcher;
+
+    auto listener = dispatcher.createListener(PlayerEvents::PLAYER_CHANGED | PlayerEvents::PLAYLIST_ITEMS_CHANGED);
+    listener->readEvents();
+    auto sequence = listener->lastSequence();
+
+    PlaylistItemsChange change(1, "p2");
+    change.setItemsModified(5, 5);
+
+    dispatcher.dispatch(change);
+    dispatcher.dispatch(PlayerEvents::PLAY_QUEUE_CHANGED);
+
+    SECTION("missed changes")
+    {
+        auto resumed = dispatcher.createListener(PlayerEvents::PLAYER_CHANGED | PlayerEvents::PLAYLIST_ITEMS_CHANGED);
+        REQUIRE(resumed->resumeAfter(sequence));
+        REQUIRE(resumed->readEvents() == PlayerEvents::PLAYLIST_ITEMS_CHANGED);
+        REQUIRE(resumed->lastSequence() == sequence + 2);
+    }
+
+    SECTION("missed changes of other playlist")
+    {
+        auto resumed = dispatcher.createListener(PlayerEvents::PLAYER_CHANGED | PlayerEvents::PLAYLIST_ITEMS_CHANGED);
+        resumed->watchPlaylistItems(PlaylistRef("p1"), Range(0, 10));
+        REQUIRE(resumed->resumeAfter(sequence));
+        REQUIRE(resumed->readEvents() == PlayerEvents::NONE);
+    }
+
+    SECTION("no changes")
+    {
+        auto resumed = dispatcher.createListener(PlayerEvents::PLAYER_CHANGED);
+        REQUIRE(resumed->resumeAfter(sequence + 2));
+        REQUIRE(resumed->readEvents() == PlayerEvents::NONE);
+    }
+
+    SECTION("unknown changes")
+    {
+        auto resumed = dispatcher.createListener(PlayerEvents::PLAYER_CHANGED);
+        REQUIRE(!resumed->resumeAfter(sequence + 3));
+        REQUIRE(!resumed->resumeAfter(sequence - 1));
+        REQUIRE(resumed->readEvents() == PlayerEvents::PLAYER_CHANGED);
+    }
+
+    SECTION("event ids")
+    {
+        auto eventId = listener->lastEventId();
+
+        auto resumed = dispatcher.createListener(PlayerEvents::PLAYER_CHANGED | PlayerEvents::PLAYLIST_ITEMS_CHANGED);
+        REQUIRE(resumed->resumeAfter(StringView(eventId)));
+        REQUIRE(resumed->readEvents() == PlayerEvents::PLAYLIST_ITEMS_CHANGED);
+
+        REQUIRE(!resumed->resumeAfter(StringView("")));
+        REQUIRE(!resumed->resumeAfter(StringView("123")));
+        REQUIRE(!resumed->resumeAfter(StringView("abc-1")));
+    }
+
+    SECTION("event ids of other dispatcher")
+    {
+        // Sequence numbers are the same, but changes are not
+        EventDispatcher otherDispatcher;
+        auto otherListener = otherDispatcher.createListener(PlayerEvents::PLAYER_CHANGED);
+        otherListener->readEvents();
+        REQUIRE(otherListener->lastSequence() == sequence);
+
+        auto resumed = dispatcher.createListener(PlayerEvents::PLAYER_CHANGED);
+        REQUIRE(!resumed->resumeAfter(StringView(otherListener->lastEventId())));
+        REQUIRE(resumed->readEvents() == PlayerEvents::PLAYER_CHANGED);
+    }
+
+    SECTION("too old changes")
+    {
+        for (size_t i = 0; i < EventDispatcher::MAX_TRACKED_CHANGES; i++)
+            dispatcher.dispatch(PlayerEvents::OUTPUTS_CHANGED);
+
+        auto resumed = dispatcher.createListener(PlayerEvents::PLAYER_CHANGED);
+        REQUIRE(!resumed->resumeAfter(sequence));
+        REQUIRE(resumed->resumeAfter(sequence + 2));
+        REQUIRE(resumed->readEvents() == PlayerEvents::NONE);
+    }
+}
+
+}
+}
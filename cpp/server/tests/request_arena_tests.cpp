@@ -0,0 +1,125 @@
+#include "request_arena.hpp"
+#include "alloc_counter.hpp"
+
+#include <string>
+#include <catch2/catch.hpp>
+
+namespace msrv {
+namespace request_arena_tests {
+
+namespace {
+
+struct TestObject
+{
+    explicit TestObject(int* destroyedVal)
+        : destroyed(destroyedVal)
+    {
+    }
+
+    ~TestObject()
+    {
+        (*destroyed)++;
+    }
+
+    int* destroyed;
+    char data[100];
+};
+
+}
+
+TEST_CASE("request arena")
+{
+    auto pool = std::make_shared<RequestArenaPool>();
+
+    SECTION("recycles memory")
+    {
+        auto arena = pool->acquire();
+        int destroyed = 0;
+
+        {
+            auto object = arenaNew<TestObject>(arena, &destroyed);
+            auto shared = std::allocate_shared<TestObject>(ArenaAllocator<TestObject>(arena), &destroyed);
+            arena->release();
+        }
+
+        REQUIRE(destroyed == 2);
+
+        AllocationCounter counter;
+
+        auto arena2 = pool->acquire();
+        REQUIRE(arena2 == arena);
+
+        {
+            auto object = arenaNew<TestObject>(arena2, &destroyed);
+            auto shared = std::allocate_shared<TestObject>(ArenaAllocator<TestObject>(arena2), &destroyed);
+        }
+
+        arena2->release();
+
+        REQUIRE(counter.count() == 0);
+        REQUIRE(destroyed == 4);
+    }
+
+    SECTION("is not recycled while objects are alive")
+    {
+        auto arena = pool->acquire();
+        int destroyed = 0;
+
+        auto object = arenaNew<TestObject>(arena, &destroyed);
+        arena->release();
+
+        auto arena2 = pool->acquire();
+        REQUIRE(arena2 != arena);
+
+        object.reset();
+        REQUIRE(destroyed == 1);
+
+        arena2->release();
+    }
+
+    SECTION("keeps pool alive")
+    {
+        auto arena = pool->acquire();
+        std::weak_ptr<RequestArenaPool> poolWeak = pool;
+        pool.reset();
+
+        REQUIRE(!poolWeak.expired());
+
+        arena->release();
+
+        REQUIRE(poolWeak.expired());
+    }
+
+    SECTION("allocates large and many objects")
+    {
+        auto arena = pool->acquire();
+        std::vector<ArenaPtr<std::string>> strings;
+
+        for (size_t i = 0; i < 200; i++)
+            strings.emplace_back(arenaNew<std::string>(arena, i, 'x'));
+
+        auto large = arena->allocate(RequestArena::BLOCK_SIZE * 2, alignof(std::max_align_t));
+        REQUIRE(large != nullptr);
+        arena->deallocate(large);
+
+        for (size_t i = 0; i < strings.size(); i++)
+            REQUIRE(strings[i]->size() == i);
+
+        strings.clear();
+        arena->release();
+    }
+
+    SECTION("falls back to heap")
+    {
+        int destroyed = 0;
+
+        auto object = arenaNew<TestObject>(nullptr, &destroyed);
+        REQUIRE(object.get_deleter().arena() == nullptr);
+
+        object.reset();
+        REQUIRE(destroyed == 1);
+    }
+}
+
+}
+}
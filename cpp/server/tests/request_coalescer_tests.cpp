@@ -0,0 +1,147 @@
+#include "request_coalescer.hpp"
+#include "beast_request.hpp"
+#include "request.hpp"
+
+#include <catch2/catch.hpp>
+
+namespace msrv {
+namespace request_coalescer_tests {
+
+namespace {
+
+std::string makeKey(const char* target, const char* acceptEncoding = "gzip")
+{
+    BeastHttpRequest message(beast::http::verb::get, target, 11);
+    message.set(beast::http::field::accept_encoding, acceptEncoding);
+    message.set(beast::http::field::user_agent, target);
+
+    Request request;
+    request.message = std::make_shared<BeastRequestMessage>(std::move(message));
+    request.method = HttpMethod::GET;
+    request.path = urlDecode(request.message->path());
+    return RequestCoalescer::makeKey(&request);
+}
+
+CoalescedResponsePtr makeResponse(std::string body)
+{
+    ResponseCore response;
+    response.status = HttpStatus::S_200_OK;
+    response.headers[HttpHeader::CONTENT_TYPE] = ContentType::APPLICATION_JSON;
+    response.body = std::move(body);
+    return CoalescedResponse::capture(response);
+}
+
+}
+
+TEST_CASE("request coalescer key")
+{
+    REQUIRE(!makeKey("/api/playlists").empty());
+
+    // Path is compared decoded, query string is compared as is
+    REQUIRE(makeKey("/api/path%20name") == makeKey("/api/path name"));
+    REQUIRE(makeKey("/api/items?a=1&b=2") == makeKey("/api/items?a=1&b=2"));
+
+    REQUIRE(makeKey("/api/items?a=1") != makeKey("/api/items?a=2"));
+    REQUIRE(makeKey("/api/items?a=1") != makeKey("/api/items"));
+    REQUIRE(makeKey("/api/items") != makeKey("/api/item"));
+
+    // Headers used by filters are part of the key, other headers are not
+    REQUIRE(makeKey("/api/items", "gzip") != makeKey("/api/items", "identity"));
+
+    Request postRequest(HttpMethod::POST, "/api/items");
+    REQUIRE(RequestCoalescer::makeKey(&postRequest).empty());
+}
+
+TEST_CASE("request coalescer")
+{
+    RequestCoalescer coalescer;
+    std::vector<CoalescedResponsePtr> received;
+    int captures = 0;
+
+    auto follower = [&](CoalescedResponsePtr response) { received.push_back(std::move(response)); };
+
+    auto capture = [&] {
+        captures++;
+        return makeResponse("data");
+    };
+
+    int scope1 = 0;
+    int scope2 = 0;
+
+    SECTION("single flight")
+    {
+        REQUIRE(coalescer.join("a", &scope1, follower) == RequestCoalescer::Role::LEADER);
+        REQUIRE(coalescer.join("a", &scope1, follower) == RequestCoalescer::Role::FOLLOWER);
+        REQUIRE(coalescer.join("a", &scope1, follower) == RequestCoalescer::Role::FOLLOWER);
+        REQUIRE(coalescer.join("b", &scope1, follower) == RequestCoalescer::Role::LEADER);
+        REQUIRE(coalescer.join("a", &scope2, follower) == RequestCoalescer::Role::NONE);
+
+        coalescer.complete("a", capture);
+
+        REQUIRE(captures == 1);
+        REQUIRE(received.size() == 2);
+        REQUIRE(received[0] == received[1]);
+        REQUIRE(received[0]->status == HttpStatus::S_200_OK);
+        REQUIRE(boost::get<std::string>(received[0]->body) == "data");
+
+        // Completed flight is removed
+        REQUIRE(coalescer.join("a", &scope2, follower) == RequestCoalescer::Role::LEADER);
+    }
+
+    SECTION("started flight")
+    {
+        REQUIRE(coalescer.join("a", &scope1, follower) == RequestCoalescer::Role::LEADER);
+        REQUIRE(coalescer.join("a", &scope1, follower) == RequestCoalescer::Role::FOLLOWER);
+
+        coalescer.start("a");
+
+        // Leader could have read state older than expected by new requests
+        REQUIRE(coalescer.join("a", &scope1, follower) == RequestCoalescer::Role::NONE);
+
+        coalescer.complete("a", capture);
+
+        REQUIRE(captures == 1);
+        REQUIRE(received.size() == 1);
+    }
+
+    SECTION("no followers")
+    {
+        REQUIRE(coalescer.join("a", &scope1, follower) == RequestCoalescer::Role::LEADER);
+
+        coalescer.complete("a", capture);
+
+        REQUIRE(captures == 0);
+        REQUIRE(received.empty());
+    }
+
+    SECTION("unshareable response")
+    {
+        REQUIRE(coalescer.join("a", &scope1, follower) == RequestCoalescer::Role::LEADER);
+        REQUIRE(coalescer.join("a", &scope1, follower) == RequestCoalescer::Role::FOLLOWER);
+
+        coalescer.complete("a", [] {
+            ResponseCore response;
+            response.body = ResponseCore::FileBody();
+            return CoalescedResponse::capture(response);
+        });
+
+        REQUIRE(received.size() == 1);
+        REQUIRE(!received[0]);
+    }
+}
+
+TEST_CASE("coalesced response")
+{
+    auto shared = makeResponse("data");
+
+    auto response1 = shared->createResponse(nullptr);
+    auto response2 = shared->createResponse(nullptr);
+
+    REQUIRE(response1->status == HttpStatus::S_200_OK);
+    REQUIRE(response1->headers[HttpHeader::CONTENT_TYPE] == ContentType::APPLICATION_JSON);
+    REQUIRE(boost::get<std::string>(response1->body) == "data");
+    REQUIRE(boost::get<std::string>(response2->body) == "data");
+}
+
+}
+}
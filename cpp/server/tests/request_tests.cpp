@@ -0,0 +1,104 @@
+#include "beast_request.hpp"
+#include "request.hpp"
+#include "alloc_counter.hpp"
+
+#include <catch2/catch.hpp>
+
+namespace msrv {
+namespace request_tests {
+
+namespace {
+
+RequestMessagePtr makeMessage(const char* target)
+{
+    BeastHttpRequest request(beast::http::verb::get, target, 11);
+    request.set(beast::http::field::host, "localhost");
+    request.set(beast::http::field::accept_encoding, "gzip, deflate");
+    request.set("X-Custom", "value");
+    request.body() = "{\"key\":1}";
+    return std::make_shared<BeastRequestMessage>(std::move(request));
+}
+
+std::unique_ptr<Request> makeRequest(const char* target)
+{
+    auto request = std::make_unique<Request>();
+    request->message = makeMessage(target);
+    request->method = HttpMethod::GET;
+    request->path = urlDecode(request->message->path());
+    return request;
+}
+
+}
+
+TEST_CASE("request message")
+{
+    auto message = makeMessage("/api/path%20name?a=1&b=x%20y");
+
+    REQUIRE(message->path() == "/api/path%20name");
+    REQUIRE(message->queryString() == "a=1&b=x%20y");
+    REQUIRE(message->body() == "{\"key\":1}");
+
+    StringView value;
+    REQUIRE(message->findHeader("x-custom", &value));
+    REQUIRE(value == "value");
+    REQUIRE(!message->findHeader("X-Missing", &value));
+
+    HttpKeyValueMap headers;
+    message->visitHeaders([&](StringView name, StringView val) {
+        headers.emplace(name.to_string(), val.to_string());
+    });
+
+    REQUIRE(headers.size() == 3);
+    REQUIRE(headers["Host"] == "localhost");
+}
+
+TEST_CASE("request message without query")
+{
+    auto message = makeMessage("/api/player");
+
+    REQUIRE(message->path() == "/api/player");
+    REQUIRE(message->queryString().empty());
+}
+
+TEST_CASE("request lazy lookups")
+{
+    auto request = makeRequest("/api/query?count=10&Name=a%2Bb&name=second&flag=true");
+
+    REQUIRE(request->path == "/api/query");
+    REQUIRE(request->getHeader("ACCEPT-ENCODING") == "gzip, deflate");
+    REQUIRE(request->getHeader("X-Missing").empty());
+
+    REQUIRE(request->param<int>("count") == 10);
+    REQUIRE(request->param<std::string>("name") == "a+b");
+    REQUIRE(request->param<bool>("flag"));
+    REQUIRE(!request->optionalParam<int>("missing"));
+
+    auto params = request->queryParams();
+    REQUIRE(params.size() == 3);
+    REQUIRE(params["name"] == "a+b");
+
+    auto headers = request->headers();
+    REQUIRE(headers["x-custom"] == "value");
+}
+
+TEST_CASE("request lookups do not allocate")
+{
+    auto request = makeRequest("/api/query?count=10&columns=%artist%");
+    StringView value;
+    std::string buffer;
+
+    AllocationCounter counter;
+
+    auto header = request->getHeader("Accept-Encoding");
+    auto found = findQueryParam(request->message->queryString(), "count", &value, &buffer);
+
+    auto allocations = counter.count();
+
+    REQUIRE(header == "gzip, deflate");
+    REQUIRE(found);
+    REQUIRE(value == "10");
+    REQUIRE(allocations == 0);
+}
+
+}
+}
@@ -16,6 +16,11 @@ class DummyFactoryBase : public RequestHandlerFactory
     {
         return nullptr;
     }
+
+    virtual WorkPriority priority() override
+    {
+        return WorkPriority::INTERACTIVE;
+    }
 };
 
 class GetRoot : public DummyFactoryBase
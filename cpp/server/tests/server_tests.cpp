@@ -4,13 +4,418 @@
 #include "work_queue.hpp"
 #include "settings.hpp"
 #include "project_info.hpp"
+#include "beast.hpp"
+#include "file_system.hpp"
+#include "metrics_controller.hpp"
+#include "basic_auth_filter.hpp"
+#include "alloc_counter.hpp"
 
 #include <catch2/catch.hpp>
 #include <boost/thread/future.hpp>
 
+#include <array>
+#include <algorithm>
+#include <ctime>
+#include <sstream>
+#include <unordered_map>
+
 namespace msrv {
 namespace server_tests {
 
+class TestController : public ControllerBase
+{
+public:
+    static void defineRoutes(
+        Router* router, WorkQueue* workQueue, const Path& fileDir, const std::string& configName = "initial")
+    {
+        auto factory = [fileDir, configName](Request* request) {
+            return new TestController(request, fileDir, configName);
+        };
+
+        auto routes = router->defineRoutes<TestController>();
+
+        routes.createWith(factory);
+        routes.useWorkQueue(workQueue);
+
+        routes.get("test", &TestController::handle);
+        routes.get("config", &TestController::getConfig);
+        routes.get("file", &TestController::getFile);
+        routes.get("events", &TestController::getEvents);
+        routes.get("shared-events", &TestController::getSharedEvents);
+        routes.get("thread", &TestController::getThread);
+        routes.get("sleep", &TestController::sleep);
+        routes.get("count", &TestController::count);
+
+        auto inlineRoutes = router->defineRoutes<TestController>();
+
+        inlineRoutes.createWith(factory);
+        inlineRoutes.useIoThread();
+        inlineRoutes.setPrefix("inline");
+
+        inlineRoutes.get("test", &TestController::handle);
+        inlineRoutes.get("file", &TestController::getFile);
+        inlineRoutes.get("events", &TestController::getEvents);
+        inlineRoutes.get("thread", &TestController::getThread);
+    }
+
+    TestController(Request* request, Path fileDir, std::string configName)
+        : ControllerBase(request), fileDir_(std::move(fileDir)), configName_(std::move(configName))
+    {
+    }
+
+    ResponsePtr handle()
+    {
+        return Response::json({{"value", optionalParam<std::string>("value", "")}});
+    }
+
+    ResponsePtr getThread()
+    {
+        std::ostringstream threadId;
+        threadId << std::this_thread::get_id();
+        return Response::json({{"thread", threadId.str()}});
+    }
+
+    ResponsePtr sleep()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(param<int>("ms")));
+        return Response::json({{"slept", true}});
+    }
+
+    ResponsePtr count()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(param<int>("ms")));
+        return Response::json({{"count", ++handlersExecuted}});
+    }
+
+    ResponsePtr getConfig()
+    {
+        return Response::json({{"name", configName_}});
+    }
+
+    ResponsePtr getFile()
+    {
+        auto path = fileDir_ / param<std::string>("name");
+        auto handle = file_io::open(path);
+        auto info = file_io::queryInfo(handle.get());
+
+        return Response::file(
+            std::move(path), std::move(handle), info, ContentType::APPLICATION_OCTET_STREAM);
+    }
+
+    ResponsePtr getEvents()
+    {
+        auto padding = std::string(optionalParam<int>("padding", 0), 'x');
+        auto counter = std::make_shared<int>(0);
+
+        auto response = Response::eventStream([counter, padding] {
+            eventsProduced++;
+            return Json({{"value", (*counter)++}, {"padding", padding}});
+        });
+
+        response->period = DurationMs(optionalParam<int>("period", 0));
+
+        if (optionalParam<bool>("ids", false))
+            response->eventId = [counter] { return toString(*counter - 1); };
+
+        return response;
+    }
+
+    ResponsePtr getSharedEvents()
+    {
+        auto response = getEvents();
+        static_cast<EventStreamResponse*>(response.get())->shareable = true;
+        return response;
+    }
+
+    static std::atomic_int eventsProduced;
+    static std::atomic_int handlersExecuted;
+
+private:
+    Path fileDir_;
+    std::string configName_;
+};
+
+std::atomic_int TestController::eventsProduced{0};
+std::atomic_int TestController::handlersExecuted{0};
+
+class TestFiles
+{
+public:
+    TestFiles()
+        : dir_(fs::temp_directory_path() / fs::unique_path("beefweb-tests-%%%%-%%%%"))
+    {
+        fs::create_directories(dir_);
+    }
+
+    ~TestFiles()
+    {
+        boost::system::error_code error;
+        fs::remove_all(dir_, error);
+    }
+
+    const Path& dir() const
+    {
+        return dir_;
+    }
+
+    std::string create(const std::string& name, size_t size)
+    {
+        std::string data;
+        data.reserve(size);
+
+        for (size_t i = 0; i < size; i++)
+            data.push_back(static_cast<char>('a' + (i * 7 + i / 251) % 26));
+
+        file_io::write(dir_ / name, data.data(), data.size());
+        return data;
+    }
+
+private:
+    Path dir_;
+};
+
+class TestServer
+{
+public:
+    explicit TestServer(int ioThreads, const Path& fileDir = Path(), const Path& localSocket = Path())
+        : thread_([this] { startCount_++; })
+    {
+        thread_.restart(createConfig(ioThreads, fileDir, localSocket));
+    }
+
+    ServerConfigPtr createConfig(
+        int ioThreads,
+        const Path& fileDir = Path(),
+        const Path& localSocket = Path(),
+        const std::string& configName = "initial",
+        RequestFilterPtr authFilter = RequestFilterPtr())
+    {
+        auto config = std::make_unique<ServerConfig>(MSRV_DEFAULT_TEST_PORT, false, ioThreads);
+        config->localSocket = localSocket.string();
+        TestController::defineRoutes(&config->router, &workQueue_, fileDir, configName);
+        MetricsController::defineRoutes(&config->router, config->metrics);
+
+        if (authFilter)
+        {
+            config->filters.add(std::move(authFilter));
+            config->accessPolicy = 1;
+        }
+
+        config->filters.add(std::make_unique<ExecuteHandlerFilter>());
+        return config;
+    }
+
+    void reconfigure(ServerConfigPtr config)
+    {
+        thread_.restart(std::move(config));
+    }
+
+    int startCount() const
+    {
+        return startCount_.load();
+    }
+
+    void dispatchEvents()
+    {
+        thread_.dispatchEvents();
+    }
+
+    bool waitStarted(int count = 1)
+    {
+        for (int i = 0; i < 10 && startCount_.load() < count; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        return startCount_.load() >= count;
+    }
+
+private:
+    std::atomic_int startCount_{0};
+    ThreadWorkQueue workQueue_;
+    ServerThread thread_;
+};
+
+template<typename Stream>
+void httpSendGet(Stream& stream, const std::string& target)
+{
+    beast::http::request<beast::http::empty_body> request(beast::http::verb::get, target, 11);
+    request.set(beast::http::field::host, "localhost");
+    request.keep_alive(true);
+
+    beast::http::write(stream, request);
+}
+
+template<typename Stream>
+beast::http::response<beast::http::string_body> httpReceive(Stream& stream)
+{
+    beast::flat_buffer buffer;
+    beast::http::response_parser<beast::http::string_body> parser;
+    parser.body_limit(std::numeric_limits<uint64_t>::max());
+    beast::http::read(stream, buffer, parser);
+    return parser.release();
+}
+
+template<typename Stream>
+beast::http::response<beast::http::string_body> httpGet(Stream& stream, const std::string& target)
+{
+    httpSendGet(stream, target);
+    return httpReceive(stream);
+}
+
+class TestClient
+{
+public:
+    TestClient()
+        : stream_(ioContext_)
+    {
+        stream_.expires_after(std::chrono::seconds(5));
+        stream_.connect(asio::ip::tcp::endpoint(
+            asio::ip::address_v4::loopback(), MSRV_DEFAULT_TEST_PORT));
+    }
+
+    beast::http::response<beast::http::string_body> get(const std::string& target)
+    {
+        stream_.expires_after(std::chrono::seconds(5));
+        return httpGet(stream_, target);
+    }
+
+    void sendGet(const std::string& target)
+    {
+        stream_.expires_after(std::chrono::seconds(5));
+        httpSendGet(stream_, target);
+    }
+
+    void sendRaw(const std::string& data)
+    {
+        stream_.expires_after(std::chrono::seconds(5));
+        asio::write(stream_, asio::buffer(data));
+    }
+
+    beast::http::response<beast::http::string_body> receive()
+    {
+        stream_.expires_after(std::chrono::seconds(5));
+        return httpReceive(stream_);
+    }
+
+    void shutdownSend()
+    {
+        stream_.socket().shutdown(asio::ip::tcp::socket::shutdown_send);
+    }
+
+    // Connection is reset instead of being closed gracefully
+    void abort()
+    {
+        stream_.socket().set_option(asio::socket_base::linger(true, 0));
+        stream_.socket().close();
+    }
+
+    void openEventStream(const std::string& target)
+    {
+        auto request = "GET " + target + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+        stream_.expires_after(std::chrono::seconds(5));
+        asio::write(stream_, asio::buffer(request));
+
+        auto size = asio::read_until(stream_, asio::dynamic_buffer(eventBuffer_), "\r\n\r\n");
+        REQUIRE(eventBuffer_.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+        eventBuffer_.erase(0, size);
+    }
+
+    Json readEvent()
+    {
+        stream_.expires_after(std::chrono::seconds(5));
+
+        std::string event;
+
+        do
+        {
+            auto size = asio::read_until(stream_, asio::dynamic_buffer(eventBuffer_), "\n\n");
+            event = eventBuffer_.substr(0, size);
+            eventBuffer_.erase(0, size);
+        }
+        while (event.front() == ':');
+
+        REQUIRE(event.compare(0, 6, "data: ") == 0);
+
+        auto idPos = event.find("\nid: ");
+
+        if (idPos != std::string::npos)
+        {
+            lastEventId_ = event.substr(idPos + 5, event.find('\n', idPos + 1) - idPos - 5);
+            event.erase(idPos);
+        }
+        else
+        {
+            lastEventId_.clear();
+        }
+
+        return Json::parse(event.substr(6));
+    }
+
+    const std::string& lastEventId() const
+    {
+        return lastEventId_;
+    }
+
+private:
+    asio::io_context ioContext_;
+    beast::tcp_stream stream_;
+    std::string eventBuffer_;
+    std::string lastEventId_;
+};
+
+class WebSocketTestClient
+{
+public:
+    WebSocketTestClient()
+        : stream_(ioContext_)
+    {
+        stream_.next_layer().connect(asio::ip::tcp::endpoint(
+            asio::ip::address_v4::loopback(), MSRV_DEFAULT_TEST_PORT));
+
+        stream_.handshake("localhost", "/api/ws");
+        stream_.text(true);
+    }
+
+    void send(const Json& frame)
+    {
+        stream_.write(asio::buffer(frame.dump()));
+    }
+
+    Json receive()
+    {
+        beast::flat_buffer buffer;
+        stream_.read(buffer);
+        return Json::parse(beast::buffers_to_string(buffer.data()));
+    }
+
+private:
+    asio::io_context ioContext_;
+    beast::websocket::stream<asio::ip::tcp::socket> stream_;
+};
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+class LocalTestClient
+{
+public:
+    explicit LocalTestClient(const Path& path)
+        : socket_(ioContext_)
+    {
+        socket_.connect(asio::local::stream_protocol::endpoint(path.string()));
+    }
+
+    beast::http::response<beast::http::string_body> get(const std::string& target)
+    {
+        return httpGet(socket_, target);
+    }
+
+private:
+    asio::io_context ioContext_;
+    asio::local::stream_protocol::socket socket_;
+};
+
+#endif
+
 TEST_CASE("server")
 {
     boost::promise<void> startedPromise;
@@ -29,5 +434,983 @@ TEST_CASE("server")
     started.get();
 }
 
+TEST_CASE("server io threads")
+{
+    auto ioThreads = GENERATE(1, 4);
+
+    TestServer server(ioThreads);
+    REQUIRE(server.waitStarted());
+
+    std::vector<std::unique_ptr<TestClient>> clients;
+
+    for (int i = 0; i < 8; i++)
+        clients.emplace_back(std::make_unique<TestClient>());
+
+    for (int round = 0; round < 3; round++)
+    {
+        for (size_t i = 0; i < clients.size(); i++)
+        {
+            auto value = toString(i);
+            auto response = clients[i]->get("/test?value=" + value);
+
+            REQUIRE(response.result() == beast::http::status::ok);
+            REQUIRE(Json::parse(response.body())["value"] == value);
+        }
+    }
+}
+
+TEST_CASE("server file responses")
+{
+    TestFiles files;
+    auto small = files.create("small.bin", 1000);
+    auto large = files.create("large.bin", 3 * 1024 * 1024 + 17);
+
+    TestServer server(1, files.dir());
+    REQUIRE(server.waitStarted());
+
+    TestClient client;
+
+    for (int round = 0; round < 2; round++)
+    {
+        auto smallResponse = client.get("/file?name=small.bin");
+        REQUIRE(smallResponse.result() == beast::http::status::ok);
+        REQUIRE(smallResponse.body() == small);
+
+        auto largeResponse = client.get("/file?name=large.bin");
+        REQUIRE(largeResponse.result() == beast::http::status::ok);
+        REQUIRE(largeResponse[beast::http::field::content_length] == toString(large.size()));
+        REQUIRE(largeResponse.body() == large);
+    }
+}
+
+TEST_CASE("server event streams")
+{
+    auto padding = GENERATE(0, 300000);
+
+    TestServer server(1);
+    REQUIRE(server.waitStarted());
+
+    TestClient client;
+    client.openEventStream("/events?padding=" + toString(padding));
+    REQUIRE(client.readEvent()["value"] == 0);
+
+    for (int i = 1; i <= 5; i++)
+    {
+        server.dispatchEvents();
+
+        auto event = client.readEvent();
+        REQUIRE(event["value"] == i);
+        REQUIRE(event["padding"].get<std::string>().size() == static_cast<size_t>(padding));
+    }
+}
+
+TEST_CASE("server shared event streams")
+{
+    TestServer server(1);
+    REQUIRE(server.waitStarted());
+
+    TestClient client1;
+    TestClient client2;
+    TestClient client3;
+
+    client1.openEventStream("/shared-events");
+    client2.openEventStream("/shared-events");
+    client3.openEventStream("/shared-events?padding=1");
+
+    REQUIRE(client1.readEvent()["value"] == 0);
+    REQUIRE(client2.readEvent()["value"] == 0);
+    REQUIRE(client3.readEvent()["value"] == 0);
+
+    TestController::eventsProduced = 0;
+
+    for (int i = 1; i <= 5; i++)
+    {
+        server.dispatchEvents();
+
+        auto event = client1.readEvent();
+        REQUIRE(event["value"] == i);
+        REQUIRE(client2.readEvent() == event);
+        REQUIRE(client3.readEvent()["value"] == i);
+    }
+
+    // Streams with different query are produced separately
+    REQUIRE(TestController::eventsProduced == 10);
+
+    auto metrics = TestClient().get("/api/metrics").body();
+    REQUIRE(metrics.find("beefweb_shared_events_total 5\n") != std::string::npos);
+}
+
+TEST_CASE("server periodic event streams")
+{
+    TestServer server(2);
+    REQUIRE(server.waitStarted());
+
+    TestClient client1;
+    TestClient client2;
+
+    client1.openEventStream("/events?period=50");
+    client2.openEventStream("/inline/events?period=50");
+
+    // Events are produced without dispatching
+    for (int i = 0; i <= 3; i++)
+    {
+        REQUIRE(client1.readEvent()["value"] == i);
+        REQUIRE(client2.readEvent()["value"] == i);
+    }
+}
+
+TEST_CASE("server event ids")
+{
+    TestServer server(1);
+    REQUIRE(server.waitStarted());
+
+    TestClient client1;
+    TestClient client2;
+
+    client1.openEventStream("/events?ids=true");
+    client2.openEventStream("/shared-events?ids=true");
+
+    REQUIRE(client1.readEvent()["value"] == 0);
+    REQUIRE(client1.lastEventId() == "0");
+    REQUIRE(client2.readEvent()["value"] == 0);
+    REQUIRE(client2.lastEventId() == "0");
+
+    for (int i = 1; i <= 3; i++)
+    {
+        server.dispatchEvents();
+
+        REQUIRE(client1.readEvent()["value"] == i);
+        REQUIRE(client1.lastEventId() == toString(i));
+        REQUIRE(client2.readEvent()["value"] == i);
+        REQUIRE(client2.lastEventId() == toString(i));
+    }
+
+    TestClient client3;
+    client3.openEventStream("/events");
+    client3.readEvent();
+    REQUIRE(client3.lastEventId().empty());
+}
+
+TEST_CASE("server reconfigure")
+{
+    TestServer server(1);
+    REQUIRE(server.waitStarted());
+
+    TestClient client;
+    REQUIRE(Json::parse(client.get("/config").body())["name"] == "initial");
+
+    TestClient eventClient;
+    eventClient.openEventStream("/events");
+    REQUIRE(eventClient.readEvent()["value"] == 0);
+
+    SECTION("hot swap")
+    {
+        server.reconfigure(server.createConfig(1, Path(), Path(), "updated"));
+
+        // Existing connection and event stream survive, new requests use new config
+        REQUIRE(Json::parse(client.get("/config").body())["name"] == "updated");
+
+        server.dispatchEvents();
+        REQUIRE(eventClient.readEvent()["value"] == 1);
+
+        REQUIRE(server.startCount() == 1);
+    }
+
+    SECTION("restart")
+    {
+        server.reconfigure(server.createConfig(2, Path(), Path(), "updated"));
+        REQUIRE(server.waitStarted(2));
+
+        TestClient newClient;
+        REQUIRE(Json::parse(newClient.get("/config").body())["name"] == "updated");
+    }
+}
+
+TEST_CASE("server reconfigure access policy")
+{
+    TestServer server(1);
+    REQUIRE(server.waitStarted());
+
+    TestClient eventClient;
+    eventClient.openEventStream("/events");
+    REQUIRE(eventClient.readEvent()["value"] == 0);
+
+    WebSocketTestClient wsClient;
+    wsClient.send({{"id", 1}, {"path", "/test?value=abc"}});
+    REQUIRE(wsClient.receive()["status"] == 200);
+
+    SECTION("same policy")
+    {
+        server.reconfigure(server.createConfig(1, Path(), Path(), "updated"));
+
+        server.dispatchEvents();
+        REQUIRE(eventClient.readEvent()["value"] == 1);
+
+        wsClient.send({{"id", 2}, {"path", "/test?value=abc"}});
+        REQUIRE(wsClient.receive()["status"] == 200);
+    }
+
+    SECTION("auth enabled")
+    {
+        auto settings = std::make_shared<SettingsData>();
+        settings->authRequired = true;
+        settings->authUser = "user";
+        settings->authPassword = "password";
+
+        server.reconfigure(server.createConfig(
+            1, Path(), Path(), "updated", std::make_unique<BasicAuthFilter>(settings)));
+
+        // Streams opened without credentials are closed
+        REQUIRE_THROWS(eventClient.readEvent());
+        REQUIRE_THROWS(wsClient.receive());
+
+        TestClient client;
+        REQUIRE(client.get("/test").result_int() == 401);
+        REQUIRE(server.startCount() == 1);
+    }
+}
+
+TEST_CASE("server inline routes")
+{
+    TestFiles files;
+    auto data = files.create("test.bin", 10000);
+
+    TestServer server(1, files.dir());
+    REQUIRE(server.waitStarted());
+
+    TestClient client;
+
+    auto queuedThread = Json::parse(client.get("/thread").body())["thread"];
+    auto inlineThread = Json::parse(client.get("/inline/thread").body())["thread"];
+    REQUIRE(queuedThread != inlineThread);
+
+    REQUIRE(Json::parse(client.get("/inline/test?value=abc").body())["value"] == "abc");
+    REQUIRE(client.get("/inline/test?value=abc").result_int() == 200);
+    REQUIRE(client.get("/inline/file?name=test.bin").body() == data);
+    REQUIRE(client.get("/inline/file?name=missing.bin").result_int() == 500);
+
+    TestClient eventClient;
+    eventClient.openEventStream("/inline/events");
+    REQUIRE(eventClient.readEvent()["value"] == 0);
+
+    server.dispatchEvents();
+    REQUIRE(eventClient.readEvent()["value"] == 1);
+}
+
+TEST_CASE("server metrics")
+{
+    TestServer server(1);
+    REQUIRE(server.waitStarted());
+
+    TestClient eventClient;
+    eventClient.openEventStream("/events");
+    REQUIRE(eventClient.readEvent()["value"] == 0);
+
+    TestClient client;
+
+    for (int i = 0; i < 3; i++)
+        REQUIRE(client.get("/test").result_int() == 200);
+
+    auto response = client.get("/api/metrics");
+    REQUIRE(response.result_int() == 200);
+
+    std::unordered_map<std::string, double> values;
+    std::istringstream lines(response.body());
+    std::string line;
+
+    while (std::getline(lines, line))
+    {
+        if (line.empty() || line.front() == '#')
+            continue;
+
+        auto pos = line.rfind(' ');
+        REQUIRE(pos != std::string::npos);
+        values[line.substr(0, pos)] = std::stod(line.substr(pos + 1));
+    }
+
+    auto phaseCount = [&](const char* phase) {
+        return values.at(std::string("beefweb_request_phase_seconds_count{phase=\"") + phase + "\"}");
+    };
+
+    // Metrics request is still in progress, its timings are recorded later
+    REQUIRE(phaseCount("parse") >= 5);
+    REQUIRE(phaseCount("route") >= 5);
+    REQUIRE(phaseCount("queue") >= 4);
+    REQUIRE(phaseCount("handler") >= 4);
+    REQUIRE(phaseCount("filters") >= 4);
+    REQUIRE(phaseCount("serialize") >= 3);
+    REQUIRE(phaseCount("write") >= 3);
+
+    REQUIRE(values.at("beefweb_request_phase_seconds_bucket{phase=\"write\",le=\"+Inf\"}") == phaseCount("write"));
+
+    REQUIRE(values.at("beefweb_active_requests") == 2);
+    REQUIRE(values.at("beefweb_event_streams") == 1);
+}
+
+TEST_CASE("server load shedding")
+{
+    TestServer server(1);
+    REQUIRE(server.waitStarted());
+
+    TestClient client1;
+    TestClient client2;
+    TestClient client3;
+
+    auto requireOverloaded = [](const beast::http::response<beast::http::string_body>& response) {
+        REQUIRE(response.result_int() == 503);
+        REQUIRE(response[beast::http::field::retry_after] == "1");
+    };
+
+    SECTION("route limit")
+    {
+        auto config = server.createConfig(1);
+        config->maxRouteRequests = 2;
+        server.reconfigure(std::move(config));
+
+        // Requests are different, so they are not coalesced
+        client1.sendGet("/sleep?ms=500");
+        client2.sendGet("/sleep?ms=400");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        requireOverloaded(client3.get("/sleep?ms=0"));
+
+        // Other routes are not affected
+        REQUIRE(client3.get("/inline/test").result_int() == 200);
+
+        REQUIRE(client1.receive().result_int() == 200);
+        REQUIRE(client2.receive().result_int() == 200);
+        REQUIRE(client3.get("/sleep?ms=0").result_int() == 200);
+
+        auto metrics = client3.get("/api/metrics").body();
+        REQUIRE(metrics.find("beefweb_rejected_requests_total{limit=\"route\"} 1\n") != std::string::npos);
+        REQUIRE(metrics.find("beefweb_rejected_requests_total{limit=\"queue\"} 0\n") != std::string::npos);
+    }
+
+    SECTION("queue capacity")
+    {
+        auto config = server.createConfig(1);
+        config->maxQueuedRequests = 1;
+        server.reconfigure(std::move(config));
+
+        client1.sendGet("/sleep?ms=500");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        // The first request is executing, the second one is waiting in the queue
+        client2.sendGet("/test");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        requireOverloaded(client3.get("/test?value=other"));
+
+        // Routes executed on I/O thread don't use the queue
+        REQUIRE(client3.get("/inline/test").result_int() == 200);
+
+        REQUIRE(client1.receive().result_int() == 200);
+        REQUIRE(client2.receive().result_int() == 200);
+        REQUIRE(client3.get("/test").result_int() == 200);
+
+        auto metrics = client3.get("/api/metrics").body();
+        REQUIRE(metrics.find("beefweb_rejected_requests_total{limit=\"queue\"} 1\n") != std::string::npos);
+    }
+}
+
+TEST_CASE("server request coalescing")
+{
+    TestServer server(2);
+    REQUIRE(server.waitStarted());
+
+    TestClient blocker;
+    TestClient client1;
+    TestClient client2;
+    TestClient client3;
+    TestClient client4;
+    TestClient client5;
+
+    TestController::handlersExecuted = 0;
+
+    // Keep the work queue busy, so that identical requests wait for the leader to start
+    blocker.sendGet("/sleep?ms=300");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    client1.sendGet("/count?ms=300");
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    client2.sendGet("/count?ms=300");
+    client3.sendGet("/count?ms=300");
+    client4.sendGet("/count?ms=0");
+
+    // Leader is running now, it could have read state older than the new request expects
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    client5.sendGet("/count?ms=300");
+
+    REQUIRE(blocker.receive().result_int() == 200);
+
+    auto response1 = client1.receive();
+    auto response2 = client2.receive();
+    auto response3 = client3.receive();
+
+    REQUIRE(response1.result_int() == 200);
+    REQUIRE(response2.result_int() == 200);
+    REQUIRE(response3.result_int() == 200);
+    REQUIRE(response2.body() == response1.body());
+    REQUIRE(response3.body() == response1.body());
+    REQUIRE(response2[beast::http::field::content_type] == response1[beast::http::field::content_type]);
+
+    // Different query is executed separately
+    REQUIRE(client4.receive().body() != response1.body());
+
+    // Request arrived after the leader has started is executed separately
+    REQUIRE(client5.receive().body() != response1.body());
+    REQUIRE(TestController::handlersExecuted == 3);
+
+    // Completed request is not reused
+    auto response6 = client1.get("/count?ms=0");
+    REQUIRE(response6.body() != response1.body());
+    REQUIRE(TestController::handlersExecuted == 4);
+
+    auto metrics = client1.get("/api/metrics").body();
+    REQUIRE(metrics.find("beefweb_coalesced_requests_total 2\n") != std::string::npos);
+}
+
+TEST_CASE("server request cancellation")
+{
+    TestServer server(1);
+    REQUIRE(server.waitStarted());
+
+    TestClient client1;
+
+    TestController::handlersExecuted = 0;
+
+    client1.sendGet("/sleep?ms=300");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    {
+        TestClient client2;
+        client2.sendGet("/count?ms=0");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        client2.abort();
+    }
+
+    // Client has disconnected while request was waiting in queue
+    REQUIRE(client1.receive().result_int() == 200);
+    REQUIRE(Json::parse(client1.get("/count?ms=0").body())["count"] == 1);
+
+    auto metrics = client1.get("/api/metrics").body();
+    REQUIRE(metrics.find("beefweb_cancelled_requests_total 1\n") != std::string::npos);
+    REQUIRE(metrics.find("beefweb_active_requests 1\n") != std::string::npos);
+}
+
+TEST_CASE("server request cancellation with pipelined request")
+{
+    TestServer server(1);
+    REQUIRE(server.waitStarted());
+
+    TestClient client1;
+
+    TestController::handlersExecuted = 0;
+
+    client1.sendGet("/sleep?ms=300");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    {
+        // Disconnect is detected after pipelined request is received
+        TestClient client2;
+        client2.sendGet("/count?ms=0");
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        client2.sendGet("/count?ms=0");
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        client2.abort();
+    }
+
+    REQUIRE(client1.receive().result_int() == 200);
+    REQUIRE(Json::parse(client1.get("/count?ms=0").body())["count"] == 1);
+}
+
+TEST_CASE("server half-closed connection")
+{
+    TestServer server(1);
+    REQUIRE(server.waitStarted());
+
+    TestClient client;
+
+    SECTION("single request")
+    {
+        // Client has nothing more to send, but waits for response
+        client.sendGet("/sleep?ms=100");
+        client.shutdownSend();
+
+        REQUIRE(client.receive().result_int() == 200);
+    }
+
+    SECTION("pipelined requests")
+    {
+        client.sendGet("/sleep?ms=100");
+        client.sendGet("/test?value=1");
+        client.shutdownSend();
+
+        REQUIRE(client.receive().result_int() == 200);
+        REQUIRE(Json::parse(client.receive().body())["value"] == "1");
+    }
+}
+
+TEST_CASE("server connection limits")
+{
+    TestServer server(1);
+    REQUIRE(server.waitStarted());
+
+    auto config = server.createConfig(1);
+
+    SECTION("idle timeout")
+    {
+        config->connectionLimits.idleTimeout = std::chrono::milliseconds(200);
+        server.reconfigure(std::move(config));
+
+        TestClient client;
+        REQUIRE(client.get("/inline/test").result_int() == 200);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        REQUIRE(client.get("/inline/test").result_int() == 200);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        REQUIRE_THROWS(client.get("/inline/test"));
+    }
+
+    SECTION("header timeout")
+    {
+        config->connectionLimits.headerTimeout = std::chrono::milliseconds(200);
+        server.reconfigure(std::move(config));
+
+        TestClient client1;
+        REQUIRE(client1.get("/inline/test").result_int() == 200);
+
+        // Idle connection is not affected
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        client1.sendRaw("GET /inline/test HTTP/1.1\r\nHost: localhost\r\n");
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        REQUIRE_THROWS(client1.receive());
+
+        // Request completed before deadline is served
+        TestClient client2;
+        client2.sendRaw("GET /inline/test HTTP/1.1\r\n");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        client2.sendRaw("Host: localhost\r\n\r\n");
+        REQUIRE(client2.receive().result_int() == 200);
+    }
+
+    SECTION("max connections")
+    {
+        config->connectionLimits.maxConnections = 2;
+        server.reconfigure(std::move(config));
+
+        TestClient client1;
+        REQUIRE(client1.get("/inline/test").result_int() == 200);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        TestClient client2;
+        REQUIRE(client2.get("/inline/test").result_int() == 200);
+
+        // Connections are kept while limit is not exceeded
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        REQUIRE(client1.get("/inline/test").result_int() == 200);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        // The oldest idle connection is closed to serve the new one
+        TestClient client3;
+        REQUIRE(client3.get("/inline/test").result_int() == 200);
+        REQUIRE_THROWS(client2.get("/inline/test"));
+        REQUIRE(client1.get("/inline/test").result_int() == 200);
+    }
+}
+
+TEST_CASE("server max connections with shards")
+{
+    TestServer server(2);
+    REQUIRE(server.waitStarted());
+
+    auto config = server.createConfig(2);
+    config->connectionLimits.maxConnections = 2;
+    server.reconfigure(std::move(config));
+
+    auto threadOf = [](TestClient& client) {
+        return Json::parse(client.get("/inline/thread").body())["thread"];
+    };
+
+    TestClient client1;
+    auto thread1 = threadOf(client1);
+
+    TestClient client2;
+    auto thread2 = threadOf(client2);
+    REQUIRE(thread1 != thread2);
+
+    // Idle connection is closed to serve the new one, it is served by the next shard in turn
+    TestClient client3;
+    REQUIRE(threadOf(client3) == thread1);
+
+    // Throttling does not change the order of shards for new connections
+    client3.abort();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    TestClient client4;
+    REQUIRE(threadOf(client4) == thread2);
+}
+
+TEST_CASE("server slow event stream consumer")
+{
+    const int padding = 2 * 1024 * 1024;
+    const int dispatchCount = 30;
+
+    TestServer server(1);
+    REQUIRE(server.waitStarted());
+
+    TestClient client;
+    client.openEventStream("/events?padding=" + toString(padding));
+
+    TestController::eventsProduced = 0;
+
+    for (int i = 0; i < dispatchCount; i++)
+    {
+        server.dispatchEvents();
+        std::this_thread::sleep_for(Server::eventDispatchDelay() * 2);
+    }
+
+    int produced = TestController::eventsProduced;
+    REQUIRE(produced < dispatchCount / 2);
+
+    int value = 0;
+
+    while (value < produced)
+        value = client.readEvent()["value"];
+
+    REQUIRE(TestController::eventsProduced <= produced + 1);
+}
+
+TEST_CASE("server websocket")
+{
+    TestServer server(1);
+    REQUIRE(server.waitStarted());
+
+    WebSocketTestClient client;
+
+    SECTION("requests")
+    {
+        client.send({{"id", 1}, {"path", "/test?value=abc"}});
+        auto response = client.receive();
+        REQUIRE(response["id"] == 1);
+        REQUIRE(response["status"] == 200);
+        REQUIRE(response["body"]["value"] == "abc");
+
+        client.send({{"id", "x"}, {"method", "POST"}, {"path", "/test"}});
+        response = client.receive();
+        REQUIRE(response["id"] == "x");
+        REQUIRE(response["status"] == 405);
+
+        client.send({{"id", 3}, {"path", "/missing"}});
+        response = client.receive();
+        REQUIRE(response["id"] == 3);
+        REQUIRE(response["status"] == 404);
+    }
+
+    SECTION("invalid frames")
+    {
+        client.send("not an object");
+        auto response = client.receive();
+        REQUIRE(response["id"].is_null());
+        REQUIRE(response["status"] == 400);
+
+        client.send({{"id", 1}});
+        response = client.receive();
+        REQUIRE(response["id"] == 1);
+        REQUIRE(response["status"] == 400);
+
+        client.send({{"id", 2}, {"method", "PUT"}, {"path", "/test"}});
+        response = client.receive();
+        REQUIRE(response["id"] == 2);
+        REQUIRE(response["status"] == 405);
+    }
+
+    SECTION("event streams")
+    {
+        client.send({{"id", 1}, {"path", "/events"}});
+
+        auto response = client.receive();
+        REQUIRE(response["id"] == 1);
+        REQUIRE(response["status"] == 200);
+
+        response = client.receive();
+        REQUIRE(response["id"] == 1);
+        REQUIRE(response["event"]["value"] == 0);
+
+        for (int i = 1; i <= 3; i++)
+        {
+            server.dispatchEvents();
+
+            response = client.receive();
+            REQUIRE(response["id"] == 1);
+            REQUIRE(response["event"]["value"] == i);
+        }
+
+        client.send({{"id", 1}, {"method", "CANCEL"}});
+        client.send({{"id", 3}, {"path", "/events?ids=true"}});
+
+        // Cancelled stream could send its last frames before
+        do
+            response = client.receive();
+        while (response["id"] != 3);
+
+        REQUIRE(response["status"] == 200);
+
+        response = client.receive();
+        REQUIRE(response["id"] == 3);
+        REQUIRE(response["event"]["value"] == 0);
+        REQUIRE(response["eventId"] == "0");
+
+        client.send({{"id", 3}, {"method", "CANCEL"}});
+        client.send({{"id", 2}, {"path", "/test?value=next"}});
+
+        response = client.receive();
+        REQUIRE(response["id"] == 2);
+        REQUIRE(response["body"]["value"] == "next");
+    }
+}
+
+TEST_CASE("server websocket origin")
+{
+    TestServer server(1);
+    REQUIRE(server.waitStarted());
+
+    auto host = "localhost:" + toString(MSRV_DEFAULT_TEST_PORT);
+
+    auto upgradeRequest = [&host](const std::string& origin) {
+        return "GET /api/ws HTTP/1.1\r\n"
+            "Host: " + host + "\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n"
+            "Origin: " + origin + "\r\n\r\n";
+    };
+
+    SECTION("same origin")
+    {
+        TestClient client;
+        client.sendRaw(upgradeRequest("http://" + host));
+        REQUIRE(client.receive().result() == beast::http::status::switching_protocols);
+    }
+
+    SECTION("cross origin")
+    {
+        TestClient client;
+        client.sendRaw(upgradeRequest("http://example.com"));
+        REQUIRE(client.receive().result() == beast::http::status::forbidden);
+    }
+
+    SECTION("opaque origin")
+    {
+        TestClient client;
+        client.sendRaw(upgradeRequest("null"));
+        REQUIRE(client.receive().result() == beast::http::status::forbidden);
+    }
+}
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+TEST_CASE("server local socket")
+{
+    TestFiles files;
+    auto socketPath = files.dir() / "beefweb.sock";
+
+    // Stale socket file of a previous instance is replaced
+    {
+        asio::io_context ioContext;
+        asio::local::stream_protocol::acceptor acceptor(
+            ioContext, asio::local::stream_protocol::endpoint(socketPath.string()));
+    }
+
+    REQUIRE(fs::exists(socketPath));
+
+    {
+        TestServer server(1, files.dir(), socketPath);
+        REQUIRE(server.waitStarted());
+
+        LocalTestClient client(socketPath);
+
+        auto response = client.get("/test?value=local");
+        REQUIRE(response.result() == beast::http::status::ok);
+        REQUIRE(Json::parse(response.body())["value"] == "local");
+
+        auto large = files.create("large.bin", 1024 * 1024);
+        response = client.get("/file?name=large.bin");
+        REQUIRE(response.body() == large);
+    }
+
+    REQUIRE(!fs::exists(socketPath));
+}
+
+TEST_CASE("server local socket path is not a socket")
+{
+    TestFiles files;
+    auto data = files.create("data.bin", 100);
+    auto socketPath = files.dir() / "data.bin";
+
+    {
+        TestServer server(1, files.dir(), socketPath);
+        REQUIRE(server.waitStarted());
+
+        // Other listeners keep working
+        TestClient client;
+        REQUIRE(client.get("/test?value=tcp").result() == beast::http::status::ok);
+    }
+
+    REQUIRE(fs::is_regular_file(socketPath));
+    REQUIRE(fs::file_size(socketPath) == data.size());
+}
+
+TEST_CASE("server local socket benchmark", "[.][benchmark]")
+{
+    const int requestCount = 5000;
+
+    TestFiles files;
+    auto socketPath = files.dir() / "beefweb.sock";
+
+    TestServer server(1, files.dir(), socketPath);
+    REQUIRE(server.waitStarted());
+
+    TestClient tcpClient;
+    LocalTestClient localClient(socketPath);
+
+    auto measure = [&](auto& client) {
+        client.get("/test?value=x");
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < requestCount; i++)
+            client.get("/test?value=x");
+
+        auto elapsed = std::chrono::steady_clock::now() - startTime;
+        return std::chrono::duration<double, std::micro>(elapsed).count() / requestCount;
+    };
+
+    auto tcpLatency = measure(tcpClient);
+    auto localLatency = measure(localClient);
+
+    WARN("round trip latency: tcp " << tcpLatency << " us, local " << localLatency << " us");
+}
+
+#endif
+
+TEST_CASE("server file responses benchmark", "[.][benchmark]")
+{
+    const size_t fileSize = 64 * 1024 * 1024;
+    const int rounds = 8;
+
+    TestFiles files;
+    files.create("bench.bin", fileSize);
+
+    TestServer server(1, files.dir());
+    REQUIRE(server.waitStarted());
+
+    TestClient client;
+    client.get("/file?name=bench.bin");
+
+    auto startTime = std::clock();
+
+    for (int i = 0; i < rounds; i++)
+        REQUIRE(client.get("/file?name=bench.bin").body().size() == fileSize);
+
+    auto cpuMs = 1000.0 * (std::clock() - startTime) / CLOCKS_PER_SEC;
+    auto totalMb = static_cast<double>(fileSize) * rounds / (1024 * 1024);
+
+    WARN("process CPU time per MB served: " << cpuMs / totalMb << " ms");
+}
+
+TEST_CASE("server inline routes benchmark", "[.][benchmark]")
+{
+    const int rounds = 5000;
+
+    TestFiles files;
+    files.create("asset.js", 16 * 1024);
+
+    TestServer server(1, files.dir());
+    REQUIRE(server.waitStarted());
+
+    TestClient client;
+
+    auto measure = [&](const std::string& target) {
+        std::vector<double> latencies;
+        latencies.reserve(rounds);
+
+        for (int i = 0; i < 100; i++)
+            client.get(target);
+
+        for (int i = 0; i < rounds; i++)
+        {
+            auto startTime = std::chrono::steady_clock::now();
+            client.get(target);
+            auto endTime = std::chrono::steady_clock::now();
+            latencies.push_back(std::chrono::duration<double, std::micro>(endTime - startTime).count());
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+
+        WARN(target << ": p50 " << latencies[rounds / 2] << " us, p99 " << latencies[rounds * 99 / 100] << " us");
+    };
+
+    measure("/test");
+    measure("/inline/test");
+    measure("/file?name=asset.js");
+    measure("/inline/file?name=asset.js");
+}
+
+TEST_CASE("server request allocations")
+{
+    TestServer server(1);
+    REQUIRE(server.waitStarted());
+
+    asio::io_context ioContext;
+    asio::ip::tcp::socket socket(ioContext);
+    socket.connect(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), MSRV_DEFAULT_TEST_PORT));
+
+    // Client side does not allocate, so process-wide counter reflects server allocations
+    const std::string request =
+        "GET /test?value=1 HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+        "Accept: application/json\r\n"
+        "Accept-Language: en-US,en;q=0.5\r\n"
+        "Referer: http://localhost/\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n";
+    std::array<char, 4096> response;
+
+    auto roundTrip = [&] {
+        asio::write(socket, asio::buffer(request));
+
+        size_t received = 0;
+        do
+        {
+            received += socket.read_some(
+                asio::buffer(response.data() + received, response.size() - received));
+        }
+        while (response[received - 1] != '}');
+    };
+
+    for (int i = 0; i < 100; i++)
+        roundTrip();
+
+    const size_t requestCount = 200;
+
+    AllocationCounter counter(AllocationCounter::Scope::PROCESS);
+
+    for (size_t i = 0; i < requestCount; i++)
+        roundTrip();
+
+    auto allocations = static_cast<double>(counter.count()) / requestCount;
+    INFO("allocations per request: " << allocations);
+
+    // Arena pools are warm at this point, remaining allocations are made by the handler
+    // (controller, JSON value), work queues, coalescing and response serialization
+    REQUIRE(allocations <= 29);
+}
+
 }
 }
@@ -1,6 +1,10 @@
 #include "timers.hpp"
 
+#include <chrono>
+#include <memory>
+#include <random>
 #include <string>
+#include <vector>
 #include <boost/optional/optional_io.hpp>
 #include <catch2/catch.hpp>
 
@@ -300,5 +304,213 @@ TEST_CASE("timers")
     }
 }
 
+TEST_CASE("timer wheel")
+{
+    TestTimeSource timeSource;
+    TimerWheel wheel(&timeSource);
+
+    auto advance = [&](DurationMs duration) {
+        timeSource.update(duration);
+        wheel.execute();
+    };
+
+    SECTION("calculate next timeout")
+    {
+        WheelTimer timer1(&wheel);
+        WheelTimer timer2(&wheel);
+
+        auto now = timeSource.currentTime();
+
+        // Timers are moved through levels of the wheel, next timeout might be earlier than expiration
+        auto isValidTimeout = [&](TimePointMs expiry) {
+            auto timeout = wheel.nextTimeout().value();
+            return timeout >= now && timeout <= expiry;
+        };
+
+        REQUIRE_FALSE(wheel.nextTimeout().has_value());
+
+        timer1.runOnce(DurationMs(20));
+        REQUIRE(isValidTimeout(now + DurationMs(20)));
+
+        timer2.runOnce(DurationMs(10));
+        REQUIRE(isValidTimeout(now + DurationMs(10)));
+
+        timer2.stop();
+        REQUIRE(isValidTimeout(now + DurationMs(20)));
+
+        timer1.runOnce(DurationMs(100000));
+        REQUIRE(isValidTimeout(now + DurationMs(100000)));
+
+        timer1.stop();
+        REQUIRE_FALSE(wheel.nextTimeout().has_value());
+    }
+
+    SECTION("one time")
+    {
+        int runCount = 0;
+        WheelTimer timer(&wheel);
+        timer.setCallback([&](Timer*) { runCount++; });
+        timer.runOnce(DurationMs(100));
+
+        advance(DurationMs(99));
+        REQUIRE(runCount == 0);
+
+        advance(DurationMs(1));
+        REQUIRE(runCount == 1);
+        REQUIRE(timer.state() == TimerState::STOPPED);
+
+        advance(DurationMs(100));
+        REQUIRE(runCount == 1);
+    }
+
+    SECTION("periodic timer")
+    {
+        int runCount = 0;
+        WheelTimer timer(&wheel);
+        timer.setCallback([&](Timer*) { runCount++; });
+        timer.runPeriodic(DurationMs(100));
+
+        SECTION("run twice")
+        {
+            advance(DurationMs(100));
+            REQUIRE(runCount == 1);
+
+            advance(DurationMs(100));
+            REQUIRE(runCount == 2);
+        }
+
+        SECTION("no run twice if lagging")
+        {
+            advance(DurationMs(250));
+            REQUIRE(runCount == 1);
+            REQUIRE(timer.runAt() == timeSource.currentTime() + DurationMs(100));
+        }
+    }
+
+    SECTION("long delays")
+    {
+        int runCount = 0;
+        WheelTimer timer(&wheel);
+        timer.setCallback([&](Timer*) { runCount++; });
+
+        auto delay = std::chrono::duration_cast<DurationMs>(std::chrono::hours(30));
+        timer.runOnce(delay);
+
+        advance(delay - DurationMs(1));
+        REQUIRE(runCount == 0);
+
+        advance(DurationMs(1));
+        REQUIRE(runCount == 1);
+    }
+
+    SECTION("modify in callback")
+    {
+        int callCount = 0;
+
+        WheelTimer timer1(&wheel);
+        WheelTimer timer2(&wheel);
+
+        timer2.setCallback([&](Timer*) { callCount++; });
+
+        timer1.setCallback([&](Timer* t) {
+            callCount++;
+            timer2.stop();
+            t->runOnce(DurationMs(50));
+        });
+
+        timer1.runOnce(DurationMs(100));
+        timer2.runOnce(DurationMs(100));
+
+        advance(DurationMs(100));
+        REQUIRE(callCount == 1);
+        REQUIRE(timer1.state() == TimerState::RUNNING);
+        REQUIRE(timer1.runAt() == timeSource.currentTime() + DurationMs(50));
+        REQUIRE(timer2.state() == TimerState::STOPPED);
+
+        advance(DurationMs(50));
+        REQUIRE(callCount == 2);
+    }
+
+    SECTION("runs timers at their time")
+    {
+        const int timerCount = 1000;
+
+        std::mt19937 random(42);
+        std::uniform_int_distribution<int> delays(0, 200000);
+
+        std::vector<std::unique_ptr<WheelTimer>> timers;
+        std::vector<TimePointMs> expected;
+        std::vector<TimePointMs> executed(timerCount);
+
+        for (int i = 0; i < timerCount; i++)
+        {
+            timers.emplace_back(std::make_unique<WheelTimer>(&wheel));
+            timers.back()->setCallback([&, i](Timer*) { executed[i] = timeSource.currentTime(); });
+            timers.back()->runOnce(DurationMs(delays(random)));
+            expected.push_back(timers.back()->runAt());
+        }
+
+        // Time advances both by small steps and by jumps to next timeout
+        std::uniform_int_distribution<int> steps(1, 3);
+
+        while (auto next = wheel.nextTimeout())
+        {
+            auto step = steps(random) == 1
+                ? *next - timeSource.currentTime()
+                : DurationMs(1);
+
+            advance(std::max(step, DurationMs(1)));
+        }
+
+        REQUIRE(executed == expected);
+    }
+}
+
+TEST_CASE("timers benchmark", "[.][benchmark]")
+{
+    const int timerCount = 100000;
+    const int rounds = 20;
+
+    auto measure = [&](TimerFactory* factory, TestTimeSource* timeSource, std::function<void()> execute) {
+        std::mt19937 random(42);
+        std::uniform_int_distribution<int> delays(1000, 30000);
+
+        std::vector<TimerPtr> timers;
+
+        for (int i = 0; i < timerCount; i++)
+        {
+            timers.emplace_back(factory->createTimer());
+            timers.back()->runOnce(DurationMs(delays(random)));
+        }
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        // Every timer is re-armed once per round (like idle timeouts on active connections)
+        for (int round = 0; round < rounds; round++)
+        {
+            for (auto& timer : timers)
+                timer->runOnce(DurationMs(delays(random)));
+
+            timeSource->update(DurationMs(10));
+            execute();
+        }
+
+        auto elapsed = std::chrono::steady_clock::now() - startTime;
+        return std::chrono::duration<double, std::milli>(elapsed).count();
+    };
+
+    TestTimeSource setTimeSource;
+    SimpleTimerQueue queue(&setTimeSource);
+    auto setTime = measure(&queue, &setTimeSource, [&] { queue.execute(); });
+
+    TestTimeSource wheelTimeSource;
+    TimerWheel wheel(&wheelTimeSource);
+    auto wheelTime = measure(&wheel, &wheelTimeSource, [&] { wheel.execute(); });
+
+    WARN(
+        timerCount << " timers re-armed " << rounds << " times: "
+        << "timer set " << setTime << " ms, timer wheel " << wheelTime << " ms");
+}
+
 }
 }
@@ -0,0 +1,558 @@
+#include "work_queue.hpp"
+#include "asio_adapters.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <catch2/catch.hpp>
+
+namespace msrv {
+namespace work_queue_tests {
+
+TEST_CASE("work callback")
+{
+    auto state = std::make_shared<int>(0);
+
+    SECTION("stores small callables inline")
+    {
+        auto small = [state] { (*state)++; };
+        auto large = [state, padding = std::array<char, 128>()] { (*state) += padding.size(); };
+
+        REQUIRE(WorkCallback::isStoredInline<decltype(small)>());
+        REQUIRE(!WorkCallback::isStoredInline<decltype(large)>());
+
+        WorkCallback smallCallback(small);
+        WorkCallback largeCallback(large);
+
+        smallCallback();
+        largeCallback();
+
+        REQUIRE(*state == 129);
+    }
+
+    SECTION("accepts move-only callables")
+    {
+        auto value = std::make_unique<int>(42);
+        WorkCallback callback([state, value = std::move(value)] { *state = *value; });
+
+        callback();
+
+        REQUIRE(*state == 42);
+    }
+
+    SECTION("moves callable")
+    {
+        auto large = [state, padding = std::array<char, 128>()] { (*state)++; };
+
+        WorkCallback first([state] { (*state)++; });
+        WorkCallback second(large);
+        REQUIRE(state.use_count() == 4);
+
+        WorkCallback third(std::move(first));
+        REQUIRE(!first);
+        REQUIRE(third);
+
+        third = std::move(second);
+        REQUIRE(!second);
+        REQUIRE(state.use_count() == 3);
+
+        third();
+        REQUIRE(*state == 1);
+
+        third = nullptr;
+        REQUIRE(!third);
+        REQUIRE(state.use_count() == 2);
+    }
+}
+
+TEST_CASE("thread work queue")
+{
+    ThreadWorkQueue queue;
+
+    const int threadCount = 4;
+    const int itemCount = 10000;
+
+    std::array<int, threadCount> lastExecuted;
+    lastExecuted.fill(-1);
+
+    bool ordered = true;
+    std::atomic_int executed{0};
+    std::promise<void> donePromise;
+    auto done = donePromise.get_future();
+
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        threads.emplace_back([&, i] {
+            for (int j = 0; j < itemCount; j++)
+            {
+                queue.enqueue([&, i, j] {
+                    // Work enqueued by a single thread is executed in order
+                    if (lastExecuted[i] != j - 1)
+                        ordered = false;
+
+                    lastExecuted[i] = j;
+
+                    if (++executed == threadCount * itemCount)
+                        donePromise.set_value();
+                });
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    REQUIRE(done.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+    REQUIRE(ordered);
+}
+
+TEST_CASE("priority work queue")
+{
+    PriorityWorkQueue queue(std::make_unique<ThreadWorkQueue>());
+
+    std::promise<void> blockPromise;
+    auto block = blockPromise.get_future().share();
+
+    std::promise<void> donePromise;
+    auto done = donePromise.get_future();
+
+    std::vector<std::string> executed;
+
+    auto add = [&](const char* name, WorkPriority priority) {
+        queue.enqueueWithPriority([&executed, name] { executed.emplace_back(name); }, priority);
+    };
+
+    SECTION("executes work in order of priority")
+    {
+        queue.enqueue([block] { block.wait(); });
+
+        add("background1", WorkPriority::BACKGROUND);
+        add("bulk1", WorkPriority::BULK);
+        add("interactive1", WorkPriority::INTERACTIVE);
+        add("background2", WorkPriority::BACKGROUND);
+        add("bulk2", WorkPriority::BULK);
+        queue.enqueue([&executed] { executed.emplace_back("interactive2"); });
+        queue.enqueueWithPriority([&] { donePromise.set_value(); }, WorkPriority::BACKGROUND);
+
+        blockPromise.set_value();
+        REQUIRE(done.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+
+        REQUIRE(executed == std::vector<std::string>({
+            "interactive1", "interactive2", "bulk1", "bulk2", "background1", "background2"}));
+    }
+
+    SECTION("keeps running after exception")
+    {
+        queue.enqueue([block] {
+            block.wait();
+            throw std::runtime_error("test error");
+        });
+
+        add("interactive", WorkPriority::INTERACTIVE);
+        queue.enqueueWithPriority([&] { donePromise.set_value(); }, WorkPriority::BULK);
+
+        blockPromise.set_value();
+        REQUIRE(done.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+
+        REQUIRE(executed == std::vector<std::string>({"interactive"}));
+    }
+}
+
+TEST_CASE("bounded work queue")
+{
+    ThreadWorkQueue queue;
+
+    std::promise<void> blockPromise;
+    auto block = blockPromise.get_future().share();
+
+    std::promise<void> donePromise;
+    auto done = donePromise.get_future();
+
+    std::atomic_int executed{0};
+
+    queue.enqueue([block] { block.wait(); });
+
+    REQUIRE(queue.tryEnqueue([&] { executed++; }, WorkPriority::INTERACTIVE, 2));
+    REQUIRE(queue.tryEnqueue([&] { executed++; }, WorkPriority::INTERACTIVE, 2));
+    REQUIRE(!queue.tryEnqueue([&] { executed++; }, WorkPriority::INTERACTIVE, 2));
+    REQUIRE(queue.tryEnqueue([&] { executed++; }, WorkPriority::INTERACTIVE, 0));
+
+    // Work enqueued without limit is not counted
+    queue.enqueue([&] { donePromise.set_value(); });
+
+    blockPromise.set_value();
+    REQUIRE(done.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    REQUIRE(executed == 3);
+
+    REQUIRE(queue.tryEnqueue([] { }, WorkPriority::INTERACTIVE, 1));
+}
+
+TEST_CASE("work stealing work queue")
+{
+    WorkStealingWorkQueue queue(4);
+
+    SECTION("executes work from many threads")
+    {
+        const int threadCount = 4;
+        const int itemCount = 10000;
+
+        std::atomic_int executed{0};
+        std::promise<void> donePromise;
+        auto done = donePromise.get_future();
+
+        std::vector<std::thread> threads;
+
+        for (int i = 0; i < threadCount; i++)
+        {
+            threads.emplace_back([&] {
+                for (int j = 0; j < itemCount; j++)
+                {
+                    queue.enqueue([&] {
+                        if (++executed == threadCount * itemCount)
+                            donePromise.set_value();
+                    });
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+            thread.join();
+
+        REQUIRE(done.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+        REQUIRE(executed == threadCount * itemCount);
+    }
+
+    SECTION("executes work enqueued by workers")
+    {
+        const int depth = 1000;
+
+        std::promise<void> donePromise;
+        auto done = donePromise.get_future();
+
+        std::function<void(int)> step = [&](int remaining) {
+            if (remaining == 0)
+                donePromise.set_value();
+            else
+                queue.enqueue([&step, remaining] { step(remaining - 1); });
+        };
+
+        queue.enqueue([&] { step(depth); });
+
+        REQUIRE(done.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    }
+
+    SECTION("idle workers steal work")
+    {
+        std::promise<void> blockPromise;
+        auto block = blockPromise.get_future().share();
+
+        std::promise<void> donePromise;
+        auto done = donePromise.get_future();
+
+        // All work is enqueued by a worker which is blocked
+        queue.enqueue([&] {
+            queue.enqueue([&] { donePromise.set_value(); });
+            block.wait();
+        });
+
+        auto status = done.wait_for(std::chrono::seconds(5));
+        blockPromise.set_value();
+
+        REQUIRE(status == std::future_status::ready);
+    }
+
+    SECTION("keeps running after exception")
+    {
+        std::promise<void> donePromise;
+        auto done = donePromise.get_future();
+
+        for (int i = 0; i < 8; i++)
+            queue.enqueue([] { throw std::runtime_error("test error"); });
+
+        queue.enqueue([&] { donePromise.set_value(); });
+
+        REQUIRE(done.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    }
+}
+
+TEST_CASE("elastic work stealing work queue")
+{
+    const size_t maxWorkers = 4;
+
+    Gauge gauge;
+    WorkStealingWorkQueue queue(1, maxWorkers, nullptr);
+    queue.setWorkerGauge(&gauge);
+
+    REQUIRE(queue.workerCount() == 1);
+    REQUIRE(gauge.value() == 1);
+
+    std::promise<void> blockPromise;
+    auto block = blockPromise.get_future().share();
+    bool blockReleased = false;
+
+    std::atomic_int started{0};
+
+    auto startBlockingWork = [&](size_t count) {
+        for (size_t i = 0; i < count; i++)
+        {
+            queue.enqueue([&started, block] {
+                started++;
+                block.wait();
+            });
+        }
+
+        // Backlog is detected when work is enqueued or taken
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+        while (static_cast<size_t>(started) < count && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(WorkStealingWorkQueue::GROW_DELAY);
+            queue.enqueue([] { });
+        }
+    };
+
+    auto releaseBlockingWork = [&] {
+        if (!blockReleased)
+        {
+            blockPromise.set_value();
+            blockReleased = true;
+        }
+    };
+
+    auto waitForWorkerCount = [&](size_t count) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+        while (queue.workerCount() != count && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        return queue.workerCount();
+    };
+
+    SECTION("grows under backlog up to maximum")
+    {
+        startBlockingWork(maxWorkers);
+        auto startedCount = started.load();
+        auto workerCount = queue.workerCount();
+
+        startBlockingWork(1);
+        auto finalCount = queue.workerCount();
+        releaseBlockingWork();
+
+        REQUIRE(startedCount == static_cast<int>(maxWorkers));
+        REQUIRE(workerCount == maxWorkers);
+        REQUIRE(finalCount == maxWorkers);
+        REQUIRE(gauge.value() == static_cast<int64_t>(maxWorkers));
+    }
+
+    SECTION("respects changed maximum")
+    {
+        queue.setMaxWorkers(2);
+
+        startBlockingWork(3);
+        auto startedCount = started.load();
+        auto workerCount = queue.workerCount();
+        releaseBlockingWork();
+
+        REQUIRE(startedCount == 2);
+        REQUIRE(workerCount == 2);
+    }
+
+    SECTION("stops idle workers")
+    {
+        queue.setIdleTimeout(DurationMs(50));
+
+        startBlockingWork(maxWorkers);
+        releaseBlockingWork();
+
+        REQUIRE(waitForWorkerCount(1) == 1);
+        REQUIRE(gauge.value() == 1);
+
+        // Work is executed after workers are stopped, stopped slots are reused
+        std::promise<void> donePromise;
+        auto done = donePromise.get_future();
+        queue.enqueue([&] { donePromise.set_value(); });
+        REQUIRE(done.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+
+        started = 0;
+        blockPromise = std::promise<void>();
+        block = blockPromise.get_future().share();
+        blockReleased = false;
+
+        startBlockingWork(maxWorkers);
+        auto startedCount = started.load();
+        releaseBlockingWork();
+
+        REQUIRE(startedCount == static_cast<int>(maxWorkers));
+    }
+
+    releaseBlockingWork();
+}
+
+TEST_CASE("priority work queue benchmark", "[.][benchmark]")
+{
+    const int bulkCount = 200;
+    const auto bulkDuration = std::chrono::milliseconds(2);
+
+    auto measure = [&](WorkQueue* queue) {
+        for (int i = 0; i < bulkCount; i++)
+        {
+            queue->enqueueWithPriority(
+                [&] { std::this_thread::sleep_for(bulkDuration); }, WorkPriority::BULK);
+        }
+
+        std::promise<std::chrono::steady_clock::time_point> executedPromise;
+        auto executed = executedPromise.get_future();
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        queue->enqueueWithPriority([&] {
+            executedPromise.set_value(std::chrono::steady_clock::now());
+        }, WorkPriority::INTERACTIVE);
+
+        auto latency = executed.get() - startTime;
+        return std::chrono::duration<double, std::milli>(latency).count();
+    };
+
+    ThreadWorkQueue plainQueue;
+    PriorityWorkQueue priorityQueue(std::make_unique<ThreadWorkQueue>());
+
+    auto plainLatency = measure(&plainQueue);
+    auto priorityLatency = measure(&priorityQueue);
+
+    WARN(
+        "interactive work latency behind " << bulkCount << " bulk items: "
+        << "plain queue " << plainLatency << " ms, priority queue " << priorityLatency << " ms");
+}
+
+TEST_CASE("thread pool contention benchmark", "[.][benchmark]")
+{
+    const size_t workerCount = 8;
+    const int producerCount = 4;
+    const int itemCount = 100000;
+
+    auto measure = [&](WorkQueue* queue) {
+        std::atomic_int executed{0};
+        std::promise<void> donePromise;
+        auto done = donePromise.get_future();
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> producers;
+
+        for (int i = 0; i < producerCount; i++)
+        {
+            producers.emplace_back([&] {
+                for (int j = 0; j < itemCount; j++)
+                {
+                    queue->enqueue([&] {
+                        if (++executed == producerCount * itemCount)
+                            donePromise.set_value();
+                    });
+                }
+            });
+        }
+
+        for (auto& producer : producers)
+            producer.join();
+
+        done.wait();
+
+        auto elapsed = std::chrono::steady_clock::now() - startTime;
+        return std::chrono::duration<double, std::milli>(elapsed).count();
+    };
+
+    ThreadPoolWorkQueue lockingPool(workerCount);
+    auto lockingTime = measure(&lockingPool);
+
+    WorkStealingWorkQueue stealingPool(workerCount);
+    auto stealingTime = measure(&stealingPool);
+
+    WARN(
+        producerCount << " producers x " << itemCount << " items on " << workerCount << " workers: "
+        << "thread pool " << lockingTime << " ms, work stealing pool " << stealingTime << " ms");
+}
+
+TEST_CASE("work queue latency benchmark", "[.][benchmark]")
+{
+    const int roundTrips = 20000;
+    const int burstCount = 200000;
+
+    // Captures the same state as request handlers in Server
+    auto payload = std::make_shared<std::string>("request context");
+
+    auto measureLatency = [&](WorkQueue* queue) {
+        std::chrono::steady_clock::duration total{0};
+
+        for (int i = 0; i < roundTrips; i++)
+        {
+            std::promise<std::chrono::steady_clock::time_point> executedPromise;
+            auto executed = executedPromise.get_future();
+
+            auto startTime = std::chrono::steady_clock::now();
+
+            queue->enqueue([payload, &executedPromise] {
+                executedPromise.set_value(std::chrono::steady_clock::now());
+            });
+
+            total += executed.get() - startTime;
+        }
+
+        return std::chrono::duration<double, std::micro>(total).count() / roundTrips;
+    };
+
+    auto measureBurst = [&](WorkQueue* queue) {
+        int executed = 0;
+        std::promise<void> donePromise;
+        auto done = donePromise.get_future();
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < burstCount; i++)
+        {
+            queue->enqueue([payload, burstCount, &executed, &donePromise] {
+                if (++executed == burstCount)
+                    donePromise.set_value();
+            });
+        }
+
+        done.wait();
+
+        auto elapsed = std::chrono::steady_clock::now() - startTime;
+        return std::chrono::duration<double, std::milli>(elapsed).count();
+    };
+
+    ThreadWorkQueue threadQueue;
+
+    asio::io_context ioContext;
+    auto ioWork = asio::make_work_guard(ioContext);
+    std::thread ioThread([&] { ioContext.run(); });
+
+    {
+        AsioWorkQueue externalQueue(&ioContext);
+
+        WARN(
+            "enqueue to execute latency: "
+            << "thread queue " << measureLatency(&threadQueue) << " us, "
+            << "external queue " << measureLatency(&externalQueue) << " us");
+
+        WARN(
+            burstCount << " items from one producer: "
+            << "thread queue " << measureBurst(&threadQueue) << " ms, "
+            << "external queue " << measureBurst(&externalQueue) << " ms");
+    }
+
+    ioWork.reset();
+    ioThread.join();
+}
+
+}
+}
@@ -3,11 +3,47 @@
 
 #include <assert.h>
 
+#include <algorithm>
+
 namespace msrv {
 
+namespace {
+
+int64_t toTicks(TimePointMs time)
+{
+    return time.time_since_epoch().count();
+}
+
+uint64_t slotBit(size_t slot)
+{
+    return uint64_t(1) << slot;
+}
+
+size_t lowestBit(uint64_t value)
+{
+    assert(value != 0);
+
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<size_t>(__builtin_ctzll(value));
+#else
+    size_t index = 0;
+
+    while ((value & 1) == 0)
+    {
+        value >>= 1;
+        index++;
+    }
+
+    return index;
+#endif
+}
+
+}
+
 Timer::~Timer() = default;
 TimerFactory::~TimerFactory() = default;
 TimeSource::~TimeSource() = default;
+SystemTimeSource::~SystemTimeSource() = default;
 
 SimpleTimer::~SimpleTimer()
 {
@@ -97,4 +133,234 @@ void SimpleTimerQueue::execute(const bool* wantExit)
     }
 }
 
+WheelTimer::~WheelTimer()
+{
+    stop();
+}
+
+void WheelTimer::runOnce(DurationMs delay)
+{
+    stop();
+
+    expiry_ = toTicks(wheel_->source_->currentTime() + delay);
+    period_ = DurationMs::zero();
+
+    wheel_->add(this, true);
+
+    state_ = TimerState::RUNNING;
+}
+
+void WheelTimer::runPeriodic(DurationMs period)
+{
+    assert(period > DurationMs::zero());
+
+    stop();
+
+    expiry_ = toTicks(wheel_->source_->currentTime() + period);
+    period_ = period;
+
+    wheel_->add(this, true);
+
+    state_ = TimerState::RUNNING;
+}
+
+void WheelTimer::stop()
+{
+    switch (state_)
+    {
+    case TimerState::STOPPED:
+        break;
+
+    case TimerState::WILL_RESTART:
+        state_ = TimerState::STOPPED;
+        break;
+
+    case TimerState::RUNNING:
+        state_ = TimerState::STOPPED;
+        wheel_->remove(this);
+        break;
+    }
+}
+
+void WheelTimer::run(TimePointMs now)
+{
+    state_ = isPeriodic() ? TimerState::WILL_RESTART : TimerState::STOPPED;
+
+    if (callback_)
+        tryCatchLog([this] { callback_(this); });
+
+    if (state_ == TimerState::WILL_RESTART)
+    {
+        expiry_ = toTicks(now + period_);
+        wheel_->add(this, false);
+        state_ = TimerState::RUNNING;
+    }
+}
+
+TimerWheel::TimerWheel(TimeSource* source)
+    : source_(source),
+      currentTick_(toTicks(source->currentTime()))
+{
+    for (auto& level : slots_)
+        level.fill(nullptr);
+
+    occupied_.fill(0);
+}
+
+TimerWheel::~TimerWheel() = default;
+
+void TimerWheel::add(WheelTimer* timer, bool notify)
+{
+    timer->expiry_ = std::min(std::max(timer->expiry_, currentTick_), currentTick_ + MAX_DELAY);
+
+    insert(timer);
+
+    if (notify && armCallback_)
+        armCallback_(timer->runAt());
+}
+
+void TimerWheel::insert(WheelTimer* timer)
+{
+    // Timer goes to the level of the highest group of bits which differs from current time,
+    // so that it is moved to lower level exactly when time reaches its slot
+    auto diff = static_cast<uint64_t>(timer->expiry_ ^ currentTick_);
+    int level = 0;
+
+    while (level < LEVEL_COUNT - 1 && (diff >> (LEVEL_BITS * (level + 1))) != 0)
+        level++;
+
+    auto slot = static_cast<size_t>(timer->expiry_ >> (LEVEL_BITS * level)) & (SLOT_COUNT - 1);
+    auto& head = slots_[level][slot];
+
+    timer->level_ = level;
+    timer->slot_ = slot;
+    timer->next_ = head;
+    timer->prev_ = &head;
+
+    if (head)
+        head->prev_ = &timer->next_;
+
+    head = timer;
+    occupied_[level] |= slotBit(slot);
+}
+
+void TimerWheel::remove(WheelTimer* timer)
+{
+    assert(timer->prev_);
+
+    *timer->prev_ = timer->next_;
+
+    if (timer->next_)
+        timer->next_->prev_ = timer->prev_;
+
+    timer->next_ = nullptr;
+    timer->prev_ = nullptr;
+
+    // Timer might be in a detached list which is being executed, slot is checked to be actually empty
+    if (!slots_[timer->level_][timer->slot_])
+        occupied_[timer->level_] &= ~slotBit(timer->slot_);
+}
+
+void TimerWheel::detachSlot(int level, size_t slot, WheelTimer** head)
+{
+    *head = slots_[level][slot];
+    slots_[level][slot] = nullptr;
+    occupied_[level] &= ~slotBit(slot);
+
+    if (*head)
+        (*head)->prev_ = head;
+}
+
+void TimerWheel::cascade(int level, size_t slot)
+{
+    WheelTimer* head;
+    detachSlot(level, slot, &head);
+
+    while (head)
+    {
+        auto timer = head;
+        remove(timer);
+        insert(timer);
+    }
+}
+
+void TimerWheel::runSlot(size_t slot, TimePointMs now)
+{
+    WheelTimer* head;
+    detachSlot(0, slot, &head);
+
+    // Timers could be stopped or armed by callbacks, list head is updated accordingly
+    while (head)
+    {
+        auto timer = head;
+        remove(timer);
+        timer->run(now);
+    }
+}
+
+bool TimerWheel::nextEventTick(int64_t* tick) const
+{
+    bool found = false;
+
+    for (int level = 0; level < LEVEL_COUNT; level++)
+    {
+        auto bits = occupied_[level];
+        if (bits == 0)
+            continue;
+
+        auto shift = LEVEL_BITS * level;
+        auto rotation = int64_t(1) << (shift + LEVEL_BITS);
+        auto rotationStart = currentTick_ & ~(rotation - 1);
+        auto currentSlot = static_cast<size_t>(currentTick_ >> shift) & (SLOT_COUNT - 1);
+        auto ahead = bits & (~uint64_t(0) << currentSlot);
+
+        // Slots behind current one could be used only on the top level by timers of the next rotation
+        if (ahead == 0)
+        {
+            assert(level == LEVEL_COUNT - 1);
+            rotationStart += rotation;
+            ahead = bits;
+        }
+
+        // Time when this slot is executed or moved to lower level
+        auto slotTick = std::max(
+            rotationStart + (static_cast<int64_t>(lowestBit(ahead)) << shift), currentTick_);
+
+        if (!found || slotTick < *tick)
+        {
+            *tick = slotTick;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+void TimerWheel::execute()
+{
+    auto now = source_->currentTime();
+    auto nowTick = toTicks(now);
+    int64_t tick;
+
+    while (nextEventTick(&tick) && tick <= nowTick)
+    {
+        currentTick_ = tick;
+
+        // Higher levels go first, their timers might go to lower slots which are due at this tick
+        for (int level = LEVEL_COUNT - 1; level > 0; level--)
+        {
+            auto shift = LEVEL_BITS * level;
+
+            if ((tick & ((int64_t(1) << shift) - 1)) == 0)
+                cascade(level, static_cast<size_t>(tick >> shift) & (SLOT_COUNT - 1));
+        }
+
+        // Timers armed by callbacks without delay are executed at the next tick
+        currentTick_ = tick + 1;
+        runSlot(static_cast<size_t>(tick) & (SLOT_COUNT - 1), now);
+    }
+
+    currentTick_ = std::max(currentTick_, nowTick + 1);
+}
+
 }
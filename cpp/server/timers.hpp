@@ -5,6 +5,9 @@
 
 #include <assert.h>
 
+#include <stdint.h>
+
+#include <array>
 #include <utility>
 #include <functional>
 #include <set>
@@ -24,6 +27,10 @@ class SimpleTimer;
 
 class SimpleTimerQueue;
 
+class WheelTimer;
+
+class TimerWheel;
+
 using TimerPtr = std::unique_ptr<Timer>;
 using TimerCallback = std::function<void(Timer*)>;
 
@@ -84,6 +91,18 @@ private:
     MSRV_NO_COPY_AND_ASSIGN(TimeSource);
 };
 
+class SystemTimeSource final : public TimeSource
+{
+public:
+    SystemTimeSource() = default;
+    virtual ~SystemTimeSource();
+
+    virtual TimePointMs currentTime() override
+    {
+        return steadyTime();
+    }
+};
+
 class SimpleTimer final : public Timer
 {
 public:
@@ -194,4 +213,134 @@ private:
     MSRV_NO_COPY_AND_ASSIGN(SimpleTimerQueue);
 };
 
+class WheelTimer final : public Timer
+{
+public:
+    WheelTimer(TimerWheel* wheel)
+        : wheel_(wheel),
+          state_(TimerState::STOPPED),
+          period_(DurationMs::zero()),
+          expiry_(0),
+          level_(0),
+          slot_(0),
+          next_(nullptr),
+          prev_(nullptr)
+    {
+    }
+
+    virtual ~WheelTimer();
+
+    virtual TimerState state() const override
+    {
+        return state_;
+    }
+
+    virtual DurationMs period() const override
+    {
+        return period_;
+    }
+
+    virtual void setCallback(TimerCallback callback) override
+    {
+        callback_ = std::move(callback);
+    }
+
+    virtual void runOnce(DurationMs delay) override;
+    virtual void runPeriodic(DurationMs period) override;
+    virtual void stop() override;
+
+    TimePointMs runAt() const
+    {
+        return TimePointMs(DurationMs(expiry_));
+    }
+
+private:
+    friend class TimerWheel;
+
+    void run(TimePointMs now);
+
+    TimerWheel* wheel_;
+    TimerCallback callback_;
+    TimerState state_;
+    DurationMs period_;
+    int64_t expiry_;
+
+    // Position in the wheel, timers of the same slot form intrusive doubly linked list
+    int level_;
+    size_t slot_;
+    WheelTimer* next_;
+    WheelTimer** prev_;
+
+    MSRV_NO_COPY_AND_ASSIGN(WheelTimer);
+};
+
+// Hierarchical timing wheel with millisecond resolution, timers are armed and stopped in constant time.
+// Each level has SLOT_COUNT slots, slot of level N covers SLOT_COUNT^N milliseconds.
+// Timers are moved to lower levels when time reaches their slot.
+class TimerWheel final : public TimerFactory
+{
+public:
+    static constexpr int LEVEL_BITS = 6;
+    static constexpr int LEVEL_COUNT = 6;
+    static constexpr size_t SLOT_COUNT = size_t(1) << LEVEL_BITS;
+
+    // Longer delays are shortened to this value (about two years)
+    static constexpr int64_t MAX_DELAY =
+        (static_cast<int64_t>(SLOT_COUNT - 1) << (LEVEL_BITS * (LEVEL_COUNT - 1))) - 1;
+
+    using ArmCallback = std::function<void(TimePointMs)>;
+
+    TimerWheel(TimeSource* source);
+    virtual ~TimerWheel();
+
+    virtual TimerPtr createTimer() override
+    {
+        return std::make_unique<WheelTimer>(this);
+    }
+
+    // Called when timer is armed by runOnce() or runPeriodic(),
+    // allows driver to wake up earlier than previously returned nextTimeout()
+    void setArmCallback(ArmCallback callback)
+    {
+        armCallback_ = std::move(callback);
+    }
+
+    // Time when execute() should be called next, might be earlier than expiration of any timer
+    boost::optional<TimePointMs> nextTimeout() const
+    {
+        int64_t tick;
+
+        if (!nextEventTick(&tick))
+            return boost::none;
+
+        return TimePointMs(DurationMs(tick));
+    }
+
+    void execute();
+
+private:
+    friend class WheelTimer;
+
+    void add(WheelTimer* timer, bool notify);
+    void remove(WheelTimer* timer);
+    void insert(WheelTimer* timer);
+    void cascade(int level, size_t slot);
+    void runSlot(size_t slot, TimePointMs now);
+    void detachSlot(int level, size_t slot, WheelTimer** head);
+    bool nextEventTick(int64_t* tick) const;
+
+    TimeSource* source_;
+    ArmCallback armCallback_;
+
+    // All timers which expire before this tick have been executed
+    int64_t currentTick_;
+
+    std::array<std::array<WheelTimer*, SLOT_COUNT>, LEVEL_COUNT> slots_;
+
+    // Bit masks of non-empty slots, allow skipping empty slots when time advances
+    std::array<uint64_t, LEVEL_COUNT> occupied_;
+
+    MSRV_NO_COPY_AND_ASSIGN(TimerWheel);
+};
+
 }
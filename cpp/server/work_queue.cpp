@@ -6,8 +6,86 @@
 
 namespace msrv {
 
+namespace {
+
+// Rounds of looking for work before parking idle worker,
+// spinning only wastes time of busy workers on a single core
+int workerSpinCount()
+{
+    static const int value = std::thread::hardware_concurrency() > 1 ? 16 : 0;
+    return value;
+}
+
+struct CurrentWorker
+{
+    const void* pool;
+    size_t index;
+};
+
+thread_local CurrentWorker currentWorker = {nullptr, 0};
+
+}
+
 WorkQueue::~WorkQueue() = default;
 
+void WorkQueue::enqueueWithPriority(WorkCallback callback, WorkPriority)
+{
+    enqueue(std::move(callback));
+}
+
+WorkBatchList::~WorkBatchList()
+{
+    destroyNodes(head_.load(std::memory_order_acquire));
+}
+
+bool WorkBatchList::push(WorkCallback callback)
+{
+    auto node = new Node{nullptr, std::move(callback)};
+    auto head = head_.load(std::memory_order_relaxed);
+
+    do
+    {
+        node->next = head;
+    }
+    while (!head_.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+
+    return head == nullptr;
+}
+
+void WorkBatchList::executeAll()
+{
+    // Items are pushed to the head, the whole list is taken at once and reversed.
+    // Nodes are never popped one by one, so there is no ABA problem.
+    Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+    Node* first = nullptr;
+
+    while (node)
+    {
+        auto next = node->next;
+        node->next = first;
+        first = node;
+        node = next;
+    }
+
+    while (first)
+    {
+        auto next = first->next;
+        tryCatchLog([&] { first->callback(); });
+        delete first;
+        first = next;
+    }
+}
+
+void WorkBatchList::destroyNodes(Node* node) noexcept
+{
+    while (node)
+    {
+        auto next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
 ThreadWorkQueue::ThreadWorkQueue(ThreadName name)
 {
     thread_ = std::thread([this, name] {
@@ -34,8 +112,11 @@ ThreadWorkQueue::~ThreadWorkQueue()
 
 void ThreadWorkQueue::enqueue(WorkCallback callback)
 {
+    if (!enqueued_.push(std::move(callback)))
+        return;
+
+    // Thread checks for work while holding the mutex, so the notification is not lost
     std::lock_guard<std::mutex> lock(mutex_);
-    enqueued_.emplace_back(std::move(callback));
     ready_.notify_one();
 }
 
@@ -51,14 +132,9 @@ void ThreadWorkQueue::run()
 
             if (shutdown_)
                 return;
-
-            std::swap(executing_, enqueued_);
         }
 
-        for (auto& item : executing_)
-            tryCatchLog([&] { item(); });
-
-        executing_.clear();
+        enqueued_.executeAll();
     }
 }
 
@@ -124,50 +200,498 @@ void ThreadPoolWorkQueue::run()
     }
 }
 
-ExternalWorkQueue::ExternalWorkQueue()
-    : state_(std::make_shared<State>())
+WorkStealingWorkQueue::Inbox::Inbox()
+    : head_(&stub_), tail_(&stub_)
 {
+    stub_.next.store(nullptr, std::memory_order_relaxed);
 }
 
-ExternalWorkQueue::~ExternalWorkQueue()
+WorkStealingWorkQueue::Inbox::~Inbox()
 {
-    auto stateDestroyed = state_->destroyed.get_future();
-    state_.reset();
-    stateDestroyed.wait();
+    while (auto node = pop())
+        delete node;
 }
 
-void ExternalWorkQueue::enqueue(WorkCallback callback)
+void WorkStealingWorkQueue::Inbox::push(Node* node)
 {
-    bool willSchedule;
+    node->next.store(nullptr, std::memory_order_relaxed);
+    auto prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+}
 
+WorkStealingWorkQueue::Node* WorkStealingWorkQueue::Inbox::pop()
+{
+    auto tail = tail_;
+    auto next = tail->next.load(std::memory_order_acquire);
+
+    if (tail == &stub_)
     {
-        std::lock_guard<std::mutex> lock(state_->mutex);
-        willSchedule = state_->enqueued.empty();
-        state_->enqueued.emplace_back(std::move(callback));
+        if (!next)
+            return nullptr;
+
+        tail_ = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
     }
 
-    if (!willSchedule)
-        return;
+    if (next)
+    {
+        tail_ = next;
+        return tail;
+    }
 
-    std::weak_ptr<State> stateWeak = state_;
+    // Producer has taken the head, but has not linked its node yet.
+    // The node is picked up after producer notifies workers.
+    if (tail != head_.load(std::memory_order_acquire))
+        return nullptr;
 
-    schedule([stateWeak] {
-        if (auto state = stateWeak.lock())
-            execute(state.get());
+    push(&stub_);
+
+    next = tail->next.load(std::memory_order_acquire);
+
+    if (next)
+    {
+        tail_ = next;
+        return tail;
+    }
+
+    return nullptr;
+}
+
+WorkStealingWorkQueue::WorkStealingWorkQueue(size_t workers, ThreadName name)
+    : WorkStealingWorkQueue(workers, workers, name)
+{
+}
+
+WorkStealingWorkQueue::WorkStealingWorkQueue(size_t minWorkers, size_t maxWorkers, ThreadName name)
+    : name_(name),
+      minWorkers_(minWorkers),
+      nextWorker_(0),
+      slotCount_(0),
+      workerCount_(0),
+      maxWorkers_(maxWorkers),
+      idleTimeout_(DEFAULT_IDLE_TIMEOUT.count()),
+      workerGauge_(nullptr),
+      backlogSince_(0),
+      pending_(0),
+      searching_(0),
+      epoch_(0),
+      waiters_(0),
+      shutdown_(false)
+{
+    assert(minWorkers > 0);
+    assert(minWorkers <= maxWorkers);
+
+    workers_.reserve(maxWorkers);
+    threads_.resize(maxWorkers);
+
+    for (size_t i = 0; i < maxWorkers; i++)
+        workers_.emplace_back(std::make_unique<Worker>());
+
+    std::lock_guard<std::mutex> lock(growMutex_);
+
+    for (size_t i = 0; i < minWorkers; i++)
+        startWorker();
+}
+
+WorkStealingWorkQueue::~WorkStealingWorkQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(parkMutex_);
+        shutdown_.store(true);
+        parked_.notify_all();
+    }
+
+    // Workers might lock growMutex_ while stopping, so they are joined without it
+    std::vector<std::thread> threads;
+
+    {
+        std::lock_guard<std::mutex> lock(growMutex_);
+        threads = std::move(threads_);
+
+        if (workerGauge_)
+            workerGauge_->add(-static_cast<int64_t>(workerCount_.load()));
+    }
+
+    for (auto& thread : threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+}
+
+void WorkStealingWorkQueue::setMaxWorkers(size_t value)
+{
+    maxWorkers_.store(std::max(minWorkers_, std::min(value, workers_.size())));
+}
+
+void WorkStealingWorkQueue::setWorkerGauge(Gauge* gauge)
+{
+    std::lock_guard<std::mutex> lock(growMutex_);
+
+    if (workerGauge_)
+        workerGauge_->add(-static_cast<int64_t>(workerCount_.load()));
+
+    workerGauge_ = gauge;
+
+    if (workerGauge_)
+        workerGauge_->add(static_cast<int64_t>(workerCount_.load()));
+}
+
+bool WorkStealingWorkQueue::startWorker()
+{
+    if (shutdown_.load() || workerCount_.load() >= maxWorkers_.load())
+        return false;
+
+    size_t index = 0;
+
+    while (workers_[index]->active.load())
+        index++;
+
+    // Previous worker of this slot has stopped or is about to stop
+    auto& thread = threads_[index];
+    if (thread.joinable())
+        thread.join();
+
+    // Slot is counted before the thread starts, so that the worker scans its own slot
+    if (index >= slotCount_.load())
+        slotCount_.store(index + 1);
+
+    thread = std::thread([this, index]
+    {
+        if (name_)
+            setThreadName(name_);
+
+        run(index);
     });
+
+    workers_[index]->active.store(true);
+    workerCount_.fetch_add(1);
+
+    if (workerGauge_)
+        workerGauge_->add(1);
+
+    return true;
+}
+
+bool WorkStealingWorkQueue::tryRetire(size_t index)
+{
+    std::lock_guard<std::mutex> lock(growMutex_);
+
+    if (shutdown_.load() || workerCount_.load() <= minWorkers_)
+        return false;
+
+    workers_[index]->active.store(false);
+    workerCount_.fetch_sub(1);
+
+    if (workerGauge_)
+        workerGauge_->add(-1);
+
+    return true;
+}
+
+void WorkStealingWorkQueue::checkBacklog()
+{
+    // Work is waiting only if there are no idle workers to take it
+    if (pending_.load() == 0
+        || searching_.load() > 0
+        || waiters_.load() > 0
+        || workerCount_.load(std::memory_order_relaxed) >= maxWorkers_.load(std::memory_order_relaxed))
+    {
+        if (backlogSince_.load(std::memory_order_relaxed) != 0)
+            backlogSince_.store(0, std::memory_order_relaxed);
+
+        return;
+    }
+
+    auto now = steadyTime().time_since_epoch().count();
+    auto since = backlogSince_.load(std::memory_order_relaxed);
+
+    if (since == 0)
+    {
+        backlogSince_.compare_exchange_strong(since, now, std::memory_order_relaxed);
+        return;
+    }
+
+    if (now - since < GROW_DELAY.count())
+        return;
+
+    std::unique_lock<std::mutex> lock(growMutex_, std::try_to_lock);
+    if (!lock.owns_lock())
+        return;
+
+    // Next worker is started only if backlog persists for another period
+    backlogSince_.store(0, std::memory_order_relaxed);
+    startWorker();
 }
 
-void ExternalWorkQueue::execute(State* state)
+void WorkStealingWorkQueue::enqueue(WorkCallback callback)
 {
+    // Counted before the item becomes visible, so that the counter never goes below zero
+    pending_.fetch_add(1);
+
+    if (currentWorker.pool == this)
     {
-        std::unique_lock<std::mutex> lock(state->mutex);
-        std::swap(state->executing, state->enqueued);
+        auto worker = workers_[currentWorker.index].get();
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->local.emplace_back(std::move(callback));
     }
+    else
+    {
+        auto node = new Node();
+        node->callback = std::move(callback);
+
+        // Prefer slots with running workers, work in other slots is found only by stealing
+        auto count = slotCount_.load();
+        auto index = nextWorker_.fetch_add(1, std::memory_order_relaxed) % count;
 
-    for (auto& item : state->executing)
-        tryCatchLog([&] { item(); });
+        for (size_t i = 1; i < count && !workers_[index]->active.load(std::memory_order_relaxed); i++)
+            index = (index + 1) % count;
+
+        workers_[index]->inbox.push(node);
+    }
+
+    notify();
+    checkBacklog();
+}
+
+void WorkStealingWorkQueue::notify()
+{
+    epoch_.fetch_add(1);
+
+    // Searching worker will take the work, otherwise wake up a parked one
+    if (searching_.load() == 0)
+        wakeOne();
+}
+
+void WorkStealingWorkQueue::wakeOne()
+{
+    if (waiters_.load() == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(parkMutex_);
+    parked_.notify_one();
+}
+
+bool WorkStealingWorkQueue::tryTake(Worker* worker, bool wait, WorkCallback* callback)
+{
+    std::unique_lock<std::mutex> lock(worker->mutex, std::defer_lock);
 
-    state->executing.clear();
+    if (wait)
+        lock.lock();
+    else if (!lock.try_lock())
+        return false;
+
+    if (!worker->local.empty())
+    {
+        *callback = std::move(worker->local.front());
+        worker->local.pop_front();
+    }
+    else if (auto node = worker->inbox.pop())
+    {
+        *callback = std::move(node->callback);
+        delete node;
+    }
+    else
+    {
+        return false;
+    }
+
+    pending_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool WorkStealingWorkQueue::findWork(size_t index, bool wait, WorkCallback* callback)
+{
+    if (pending_.load(std::memory_order_relaxed) == 0)
+        return false;
+
+    auto count = slotCount_.load();
+
+    if (tryTake(workers_[index].get(), true, callback))
+        return true;
+
+    for (size_t i = 1; i < count; i++)
+    {
+        if (tryTake(workers_[(index + i) % count].get(), wait, callback))
+            return true;
+    }
+
+    return false;
+}
+
+void WorkStealingWorkQueue::run(size_t index)
+{
+    currentWorker = {this, index};
+
+    WorkCallback callback;
+    auto spinCount = workerSpinCount();
+
+    searching_.fetch_add(1);
+
+    while (!shutdown_.load(std::memory_order_acquire))
+    {
+        bool found = findWork(index, false, &callback);
+
+        for (int i = 0; !found && i < spinCount; i++)
+        {
+            std::this_thread::yield();
+            found = findWork(index, false, &callback);
+        }
+
+        if (!found)
+        {
+            waiters_.fetch_add(1);
+            auto epoch = epoch_.load();
+
+            // Work enqueued before registering as waiter is found here,
+            // work enqueued after that changes epoch and wakes up a waiter
+            if (pending_.load() > 0)
+                found = findWork(index, true, &callback);
+
+            if (!found)
+            {
+                searching_.fetch_sub(1);
+
+                bool idle = false;
+
+                {
+                    std::unique_lock<std::mutex> lock(parkMutex_);
+                    auto timeout = DurationMs(idleTimeout_.load(std::memory_order_relaxed));
+
+                    while (epoch_.load() == epoch && !shutdown_.load())
+                    {
+                        if (parked_.wait_for(lock, timeout) == std::cv_status::timeout && epoch_.load() == epoch)
+                        {
+                            idle = true;
+                            break;
+                        }
+                    }
+                }
+
+                waiters_.fetch_sub(1);
+
+                if (idle && tryRetire(index))
+                {
+                    // Work might have been enqueued after timeout, it should not wait for busy workers
+                    if (pending_.load() > 0)
+                        wakeOne();
+
+                    return;
+                }
+
+                searching_.fetch_add(1);
+                continue;
+            }
+
+            waiters_.fetch_sub(1);
+        }
+
+        // Producers don't wake up workers while someone is searching,
+        // the last searcher passes remaining work to a parked worker
+        if (searching_.fetch_sub(1) == 1 && pending_.load() > 0)
+            wakeOne();
+
+        checkBacklog();
+
+        tryCatchLog([&] { callback(); });
+        callback = nullptr;
+
+        searching_.fetch_add(1);
+    }
+}
+
+PriorityWorkQueue::PriorityWorkQueue(std::unique_ptr<WorkQueue> queue)
+    : queue_(std::move(queue))
+{
+}
+
+PriorityWorkQueue::~PriorityWorkQueue()
+{
+    // Underlying queue does not run callbacks after destruction, they could safely reference this
+    queue_.reset();
+}
+
+void PriorityWorkQueue::enqueue(WorkCallback callback)
+{
+    enqueueWithPriority(std::move(callback), WorkPriority::INTERACTIVE);
+}
+
+void PriorityWorkQueue::enqueueWithPriority(WorkCallback callback, WorkPriority priority)
+{
+    bool willSchedule;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lanes_[static_cast<size_t>(priority)].emplace_back(std::move(callback));
+        willSchedule = !scheduled_;
+        scheduled_ = true;
+    }
+
+    if (willSchedule)
+        queue_->enqueue([this] { executeNext(); });
+}
+
+void PriorityWorkQueue::executeNext()
+{
+    WorkCallback callback;
+    bool hasMore = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        for (auto& lane : lanes_)
+        {
+            if (lane.empty())
+                continue;
+
+            if (!callback)
+            {
+                callback = std::move(lane.front());
+                lane.pop_front();
+            }
+
+            if (!lane.empty())
+            {
+                hasMore = true;
+                break;
+            }
+        }
+
+        scheduled_ = hasMore;
+    }
+
+    // Scheduled before executing, so that the queue keeps running if callback throws
+    if (hasMore)
+        queue_->enqueue([this] { executeNext(); });
+
+    if (callback)
+        callback();
+}
+
+ExternalWorkQueue::ExternalWorkQueue()
+    : state_(std::make_shared<State>())
+{
+}
+
+ExternalWorkQueue::~ExternalWorkQueue()
+{
+    auto stateDestroyed = state_->destroyed.get_future();
+    state_.reset();
+    stateDestroyed.wait();
+}
+
+void ExternalWorkQueue::enqueue(WorkCallback callback)
+{
+    if (!state_->enqueued.push(std::move(callback)))
+        return;
+
+    std::weak_ptr<State> stateWeak = state_;
+
+    schedule([stateWeak] {
+        if (auto state = stateWeak.lock())
+            state->enqueued.executeAll();
+    });
 }
 
 }
@@ -2,18 +2,243 @@
 
 #include "defines.hpp"
 #include "system.hpp"
+#include "chrono.hpp"
+#include "metrics.hpp"
 
+#include <assert.h>
+#include <stddef.h>
+
+#include <array>
+#include <atomic>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <deque>
 #include <boost/thread/future.hpp>
 
 namespace msrv {
 
-using WorkCallback = std::function<void()>;
+// Move-only replacement of std::function<void()> for work items.
+// Callables of up to INLINE_SIZE bytes (e.g. lambdas capturing a couple of shared pointers)
+// are stored inline, larger ones are allocated on heap.
+class WorkCallback
+{
+public:
+    static constexpr size_t INLINE_SIZE = 6 * sizeof(void*);
+
+    template<typename Function>
+    static constexpr bool isStoredInline()
+    {
+        return sizeof(Function) <= INLINE_SIZE
+            && alignof(Function) <= alignof(void*)
+            && std::is_nothrow_move_constructible<Function>::value;
+    }
+
+    WorkCallback() noexcept
+        : ops_(nullptr)
+    {
+    }
+
+    WorkCallback(std::nullptr_t) noexcept
+        : ops_(nullptr)
+    {
+    }
+
+    template<
+        typename Function,
+        typename = std::enable_if_t<!std::is_same<std::decay_t<Function>, WorkCallback>::value>>
+    WorkCallback(Function&& function)
+        : ops_(nullptr)
+    {
+        using Target = std::decay_t<Function>;
+
+        if constexpr (isStoredInline<Target>())
+        {
+            new (storage_) Target(std::forward<Function>(function));
+            ops_ = &InlineOps<Target>::instance;
+        }
+        else
+        {
+            new (storage_) Target*(new Target(std::forward<Function>(function)));
+            ops_ = &HeapOps<Target>::instance;
+        }
+    }
+
+    WorkCallback(WorkCallback&& other) noexcept
+        : ops_(other.ops_)
+    {
+        if (ops_)
+        {
+            ops_->move(other.storage_, storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    ~WorkCallback()
+    {
+        reset();
+    }
+
+    WorkCallback& operator=(WorkCallback&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+
+            if (other.ops_)
+            {
+                other.ops_->move(other.storage_, storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+
+        return *this;
+    }
+
+    WorkCallback& operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return ops_ != nullptr;
+    }
+
+    void operator()()
+    {
+        assert(ops_);
+        ops_->invoke(storage_);
+    }
+
+private:
+    struct Ops
+    {
+        void (*invoke)(void* storage);
+        void (*move)(void* from, void* to) noexcept;
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template<typename Function>
+    struct InlineOps
+    {
+        static Function* get(void* storage)
+        {
+            return static_cast<Function*>(storage);
+        }
+
+        static void invoke(void* storage)
+        {
+            (*get(storage))();
+        }
+
+        static void move(void* from, void* to) noexcept
+        {
+            new (to) Function(std::move(*get(from)));
+            get(from)->~Function();
+        }
+
+        static void destroy(void* storage) noexcept
+        {
+            get(storage)->~Function();
+        }
+
+        static constexpr Ops instance = {&invoke, &move, &destroy};
+    };
+
+    template<typename Function>
+    struct HeapOps
+    {
+        static Function*& get(void* storage)
+        {
+            return *static_cast<Function**>(storage);
+        }
+
+        static void invoke(void* storage)
+        {
+            (*get(storage))();
+        }
+
+        static void move(void* from, void* to) noexcept
+        {
+            new (to) Function*(get(from));
+        }
+
+        static void destroy(void* storage) noexcept
+        {
+            delete get(storage);
+        }
+
+        static constexpr Ops instance = {&invoke, &move, &destroy};
+    };
+
+    void reset() noexcept
+    {
+        if (ops_)
+        {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    const Ops* ops_;
+    alignas(void*) unsigned char storage_[INLINE_SIZE];
+
+    MSRV_NO_COPY_AND_ASSIGN(WorkCallback);
+};
+
+// Lock-free list of work items with many producers and a single consumer.
+// Consumer takes all enqueued items at once and executes them in order of enqueueing,
+// items enqueued during execution go to the next batch.
+class WorkBatchList
+{
+public:
+    WorkBatchList()
+        : head_(nullptr)
+    {
+    }
+
+    ~WorkBatchList();
+
+    // Returns true if the list was empty, consumer might need to be woken up
+    bool push(WorkCallback callback);
+
+    bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) == nullptr;
+    }
+
+    // Executes all items enqueued so far, exceptions are logged
+    void executeAll();
+
+private:
+    struct Node
+    {
+        Node* next;
+        WorkCallback callback;
+    };
+
+    static void destroyNodes(Node* node) noexcept;
+
+    std::atomic<Node*> head_;
+
+    MSRV_NO_COPY_AND_ASSIGN(WorkBatchList);
+};
+
+enum class WorkPriority
+{
+    INTERACTIVE,
+    BULK,
+    BACKGROUND,
+};
 
 class WorkQueue
 {
@@ -21,10 +246,42 @@ public:
     virtual ~WorkQueue();
     virtual void enqueue(WorkCallback callback) = 0;
 
+    // Queues without priority support execute work in order of enqueueing
+    virtual void enqueueWithPriority(WorkCallback callback, WorkPriority priority);
+
+    // Enqueues work which could be rejected when the queue is overloaded (zero capacity means no limit).
+    // Returns false if capacity items enqueued this way are already waiting for execution.
+    // Accepts a callable directly, so that wrapping it for accounting does not need extra allocation.
+    template<typename Function>
+    bool tryEnqueue(Function&& function, WorkPriority priority, size_t capacity)
+    {
+        auto count = boundedCount_.fetch_add(1, std::memory_order_relaxed);
+
+        if (capacity > 0 && count >= capacity)
+        {
+            boundedCount_.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // Queue does not run callbacks after destruction, it is safe to reference this
+        enqueueWithPriority([this, function = std::forward<Function>(function)]() mutable {
+            boundedCount_.fetch_sub(1, std::memory_order_relaxed);
+            function();
+        }, priority);
+
+        return true;
+    }
+
 protected:
-    WorkQueue() = default;
+    WorkQueue()
+        : boundedCount_(0)
+    {
+    }
 
     MSRV_NO_COPY_AND_ASSIGN(WorkQueue);
+
+private:
+    std::atomic<size_t> boundedCount_;
 };
 
 class ThreadWorkQueue : public WorkQueue
@@ -39,10 +296,11 @@ private:
     void run();
 
     std::thread thread_;
+    WorkBatchList enqueued_;
+
+    // Used only for waking up idle thread, producers don't take it when thread is busy
     std::mutex mutex_;
     std::condition_variable ready_;
-    std::vector<WorkCallback> enqueued_;
-    std::vector<WorkCallback> executing_;
     bool shutdown_ = false;
 };
 
@@ -64,6 +322,147 @@ private:
     bool shutdown_ = false;
 };
 
+// Thread pool with a queue per worker, idle workers steal work from busy ones.
+// Work enqueued from outside of the pool is distributed over workers without locks,
+// work enqueued by a worker goes to its own queue. Order of execution is not guaranteed.
+// Elastic pool starts a worker when work has been waiting for busy workers for GROW_DELAY,
+// workers which stay idle for idle timeout are stopped.
+class WorkStealingWorkQueue : public WorkQueue
+{
+public:
+    static constexpr DurationMs GROW_DELAY = DurationMs(10);
+    static constexpr DurationMs DEFAULT_IDLE_TIMEOUT = DurationMs(30000);
+
+    // Pool of fixed size
+    explicit WorkStealingWorkQueue(size_t workers, ThreadName name = nullptr);
+
+    // Elastic pool, maxWorkers is also upper bound for setMaxWorkers()
+    WorkStealingWorkQueue(size_t minWorkers, size_t maxWorkers, ThreadName name);
+
+    ~WorkStealingWorkQueue();
+
+    void enqueue(WorkCallback callback) override;
+
+    size_t workerCount() const
+    {
+        return workerCount_.load(std::memory_order_relaxed);
+    }
+
+    // Excess workers are stopped when they become idle
+    void setMaxWorkers(size_t value);
+
+    void setIdleTimeout(DurationMs value)
+    {
+        idleTimeout_.store(value.count(), std::memory_order_relaxed);
+    }
+
+    // Gauge is updated when workers are started and stopped
+    void setWorkerGauge(Gauge* gauge);
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> next;
+        WorkCallback callback;
+    };
+
+    // Accepts work from any thread without locks (intrusive MPSC queue by Dmitry Vyukov),
+    // consumer should hold worker's mutex
+    class Inbox
+    {
+    public:
+        Inbox();
+        ~Inbox();
+
+        void push(Node* node);
+        Node* pop();
+
+    private:
+        std::atomic<Node*> head_;
+        Node* tail_;
+        Node stub_;
+
+        MSRV_NO_COPY_AND_ASSIGN(Inbox);
+    };
+
+    struct alignas(64) Worker
+    {
+        std::mutex mutex;
+        std::deque<WorkCallback> local;
+        Inbox inbox;
+
+        // Thread is running for this slot, work is still taken from inactive slots by stealing
+        std::atomic_bool active{false};
+    };
+
+    void run(size_t index);
+    bool tryTake(Worker* worker, bool wait, WorkCallback* callback);
+    bool findWork(size_t index, bool wait, WorkCallback* callback);
+    void notify();
+    void wakeOne();
+    void checkBacklog();
+    bool startWorker();
+    bool tryRetire(size_t index);
+
+    const ThreadName name_;
+    const size_t minWorkers_;
+
+    // Slots for maximum number of workers are allocated upfront, so that they could be accessed without locks
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> nextWorker_;
+
+    // Number of slots which have ever been used, only these are scanned for work
+    std::atomic<size_t> slotCount_;
+
+    // Worker threads are started and stopped with growMutex_ held
+    std::mutex growMutex_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> workerCount_;
+    std::atomic<size_t> maxWorkers_;
+    std::atomic<DurationMs::rep> idleTimeout_;
+    Gauge* workerGauge_;
+
+    // Time (in milliseconds of steadyTime()) since work is waiting for busy workers, zero if it does not
+    std::atomic<DurationMs::rep> backlogSince_;
+
+    // Number of enqueued items not taken by workers yet, allows skipping scan of empty queues
+    std::atomic<size_t> pending_;
+
+    // Number of workers looking for work, they don't need to be woken up
+    std::atomic<int> searching_;
+
+    // Event count for parking idle workers: a worker registers as waiter,
+    // checks queues once more and sleeps only if epoch has not changed since registration
+    std::atomic<uint64_t> epoch_;
+    std::atomic<int> waiters_;
+    std::mutex parkMutex_;
+    std::condition_variable parked_;
+    std::atomic_bool shutdown_;
+};
+
+// Executes work on underlying serial queue, work of higher priority goes first.
+// Work is passed to underlying queue one item at a time,
+// so the next item waits at most for the item which is currently executing.
+class PriorityWorkQueue : public WorkQueue
+{
+public:
+    static constexpr size_t PRIORITY_COUNT = static_cast<size_t>(WorkPriority::BACKGROUND) + 1;
+
+    explicit PriorityWorkQueue(std::unique_ptr<WorkQueue> queue);
+    ~PriorityWorkQueue();
+
+    void enqueue(WorkCallback callback) override;
+    void enqueueWithPriority(WorkCallback callback, WorkPriority priority) override;
+
+private:
+    void executeNext();
+
+    std::unique_ptr<WorkQueue> queue_;
+    std::mutex mutex_;
+    std::array<std::deque<WorkCallback>, PRIORITY_COUNT> lanes_;
+    bool scheduled_ = false;
+};
+
 class ExternalWorkQueue : public WorkQueue
 {
 public:
@@ -74,7 +473,8 @@ public:
 protected:
     ExternalWorkQueue();
 
-    virtual void schedule(WorkCallback callback) = 0;
+    // Callback is copyable, so that it could be passed to APIs accepting std::function
+    virtual void schedule(std::function<void()> callback) = 0;
 
 private:
     struct State
@@ -86,16 +486,12 @@ private:
             destroyed.set_value();
         }
 
-        std::mutex mutex;
-        std::vector<WorkCallback> enqueued;
-        std::vector<WorkCallback> executing;
+        WorkBatchList enqueued;
         boost::promise<void> destroyed;
 
         MSRV_NO_COPY_AND_ASSIGN(State);
     };
 
-    static void execute(State* state);
-
     std::shared_ptr<State> state_;
 };
 
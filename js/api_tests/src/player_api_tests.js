@@ -209,6 +209,34 @@ describe('player api', () => {
         assert.ok(true);
     });
 
+    test('playback position stream', async () => {
+        await client.addPlaylistItems(0, [tracks.t1]);
+
+        await client.play(0, 0);
+        await client.waitForState('playing');
+
+        // Position is advanced without player events
+        let firstPosition = null;
+
+        const expectation = client.expectPlaybackPosition(
+            { period: 100 },
+            e => {
+                if (e.playbackState !== 'playing')
+                    return false;
+
+                if (firstPosition === null)
+                    firstPosition = e.position;
+
+                return e.position > firstPosition && e.duration > 0;
+            },
+            { useFirstEvent: true });
+
+        await expectation.ready;
+        await expectation.done;
+
+        assert.ok(true);
+    });
+
     test('toggle pause', async () => {
         await client.addPlaylistItems(0, [tracks.t1]);
 
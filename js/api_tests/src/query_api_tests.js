@@ -1,5 +1,6 @@
 import { describe, test, assert } from 'vitest';
 import { client, tracks, outputConfigs, setupPlayer } from './test_env.js';
+import { applyJsonPatch } from './utils.js';
 
 describe('query api', () => {
     setupPlayer();
@@ -213,6 +214,37 @@ describe('query api', () => {
         assert.deepEqual(actual, expected);
     });
 
+    test('expect playlist items updates in diff mode', async () => {
+        await client.addPlaylistItems(0, [tracks.t1, tracks.t2]);
+
+        const columns = ['%title%'];
+        const options = {
+            playlistItems: true,
+            plref: 0,
+            plcolumns: columns,
+            diff: true,
+        };
+
+        // The first event is full state, the next ones are patches
+        const currentState = events => events.reduce(
+            (state, event) => Array.isArray(event) ? applyJsonPatch(state, event) : event, null);
+
+        const expectation = client.expectUpdate(
+            options,
+            () => currentState(expectation.allEvents).playlistItems.items.length === 3,
+            { includeEventData: true });
+
+        await expectation.ready;
+        await client.addPlaylistItems(0, [tracks.t3], { index: 0 });
+        await expectation.done;
+
+        const expected = await client.getPlaylistItems(0, columns);
+        const actual = currentState(expectation.allEvents).playlistItems;
+
+        assert.deepEqual(actual, expected);
+        assert.isTrue(Array.isArray(expectation.lastEvent));
+    });
+
     test('expect volume updates', async () => {
         const { volume } = await client.getPlayerState();
 
@@ -139,6 +139,14 @@ class TestPlayerClient extends PlayerClient
             condition,
             expectationOptions);
     }
+
+    expectPlaybackPosition(options, condition, expectationOptions)
+    {
+        return new EventExpectation(
+            cb => this.queryPlaybackPosition(options, cb),
+            condition,
+            expectationOptions);
+    }
 }
 
 export default TestPlayerClient;
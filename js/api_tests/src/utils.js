@@ -27,6 +27,49 @@ export function isObject(value)
     return typeof value === 'object' && !Array.isArray(value);
 }
 
+function parseJsonPointer(pointer)
+{
+    return pointer
+        .split('/')
+        .slice(1)
+        .map(t => t.replace(/~1/g, '/').replace(/~0/g, '~'));
+}
+
+// Applies JSON Patch (RFC 6902) operations produced by server: add, remove and replace
+export function applyJsonPatch(document, patch)
+{
+    const root = { value: JSON.parse(JSON.stringify(document)) };
+
+    for (let operation of patch)
+    {
+        const tokens = ['value', ...parseJsonPointer(operation.path)];
+        const key = tokens.pop();
+        const parent = tokens.reduce((obj, token) => obj[token], root);
+
+        if (operation.op === 'remove')
+        {
+            if (Array.isArray(parent))
+                parent.splice(Number(key), 1);
+            else
+                delete parent[key];
+        }
+        else if (operation.op === 'add' && Array.isArray(parent))
+        {
+            parent.splice(key === '-' ? parent.length : Number(key), 0, operation.value);
+        }
+        else if (operation.op === 'add' || operation.op === 'replace')
+        {
+            parent[key] = operation.value;
+        }
+        else
+        {
+            throw new Error(`Unsupported patch operation: ${operation.op}`);
+        }
+    }
+
+    return root.value;
+}
+
 export async function checkedExecFile(command, args, options)
 {
     const { error } = await execFile(command, args, options);
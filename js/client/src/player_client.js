@@ -317,4 +317,10 @@ export default class PlayerClient
         return this.createEventSource(
             'api/query/updates', callback, formatQueryOptions(options));
     }
+
+    queryPlaybackPosition(options, callback)
+    {
+        return this.createEventSource(
+            'api/player/position', callback, options);
+    }
 }